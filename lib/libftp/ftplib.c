@@ -363,6 +363,30 @@ static int readresp(char c, netbuf *nControl)
 	return 0;
 }
 
+/*
+ * net_lookup - resolve host (and service, if not NULL) into sin
+ *
+ * getaddrinfo() is reentrant, unlike gethostbyname() and getservbyname(),
+ * so several connections may be set up at the same time.
+ *
+ * return 1 if resolved, 0 if not
+ */
+static int net_lookup(const char *host, const char *service, struct sockaddr_in *sin)
+{
+	struct addrinfo hints, *res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, service, &hints, &res) != 0)
+		return 0;
+	sin->sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+	if (service != NULL)
+		sin->sin_port = ((struct sockaddr_in *)res->ai_addr)->sin_port;
+	freeaddrinfo(res);
+	return 1;
+}
+
 /*
  * FtpInit for stupid operating systems that require it (Windows NT)
  */
@@ -399,8 +423,6 @@ GLOBALDEF int FtpConnect(const char *host, netbuf **nControl)
 {
 	int sControl;
 	struct sockaddr_in sin;
-	struct hostent *phe;
-	struct servent *pse;
 	int on=1;
 	netbuf *ctrl;
 	char *lhost;
@@ -410,41 +432,12 @@ GLOBALDEF int FtpConnect(const char *host, netbuf **nControl)
 	sin.sin_family = AF_INET;
 	lhost = strdup(host);
 	pnum = strchr(lhost,':');
-	if (pnum == NULL)
-	{
-#if defined(VMS)
-		sin.sin_port = htons(21);
-#else
-		if ((pse = getservbyname("ftp","tcp")) == NULL)
-		{
-			perror("getservbyname");
-			return 0;
-		}
-		sin.sin_port = pse->s_port;
-#endif
-	}
-	else
-	{
+	if (pnum != NULL)
 		*pnum++ = '\0';
-		if (isdigit(*pnum))
-			sin.sin_port = htons(atoi(pnum));
-		else
-		{
-			pse = getservbyname(pnum,"tcp");
-			if(pse == NULL) {
-				perror("getservbyname");
-				return 0;
-			}
-			sin.sin_port = pse->s_port;
-		}
-	}
-	if ((signed)(sin.sin_addr.s_addr = inet_addr(lhost)) == -1)
+	if (!net_lookup(lhost, pnum ? pnum : "ftp", &sin))
 	{
-		if ((phe = gethostbyname(lhost)) == NULL)
-		{
-			return 0;
-		}
-		memcpy((char *)&sin.sin_addr, phe->h_addr, phe->h_length);
+		free(lhost);
+		return 0;
 	}
 	free(lhost);
 	sControl = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -1350,8 +1343,6 @@ GLOBALREF int HttpConnect(const char *host, unsigned short port, netbuf **nContr
 {
 	int sControl;
 	struct sockaddr_in sin;
-	struct hostent *phe;
-	struct servent *pse;
 	netbuf *ctrl;
 	char *lhost;
 	char *pnum;
@@ -1360,41 +1351,14 @@ GLOBALREF int HttpConnect(const char *host, unsigned short port, netbuf **nContr
 	sin.sin_family = AF_INET;
 	lhost = strdup(host);
 	pnum = strchr(lhost,':');
-	if (pnum == NULL)
-	{
-#if defined(VMS)
-		sin.sin_port = htons(80);
-#else
-		/* we pass a port variable instead (for use with proxies)
-		 *
-		if ((pse = getservbyname("http","tcp")) == NULL)
-		{
-			perror("getservbyname");
-			return 0;
-		}
-		sin.sin_port = pse->s_port;
-		*/
-		sin.sin_port = htons(port);
-#endif
-	}
-	else
-	{
+	/* we pass a port variable instead (for use with proxies) */
+	sin.sin_port = htons(port);
+	if (pnum != NULL)
 		*pnum++ = '\0';
-		if (isdigit(*pnum))
-			sin.sin_port = htons(atoi(pnum));
-		else
-		{
-			pse = getservbyname(pnum,"tcp");
-			sin.sin_port = pse->s_port;
-		}
-	}
-	if ((signed)(sin.sin_addr.s_addr = inet_addr(lhost)) == -1)
+	if (!net_lookup(lhost, pnum, &sin))
 	{
-		if ((phe = gethostbyname(lhost)) == NULL)
-		{
-			return 0;
-		}
-		memcpy((char *)&sin.sin_addr, phe->h_addr, phe->h_length);
+		free(lhost);
+		return 0;
 	}
 	free(lhost);
 	sControl = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -58,6 +58,7 @@
 #include "remove.h"
 #include "handle.h"
 #include "packages_transaction.h"
+#include "readahead.h"
 
 static int add_faketarget(pmtrans_t *trans, const char *name)
 {
@@ -417,13 +418,7 @@ int _pacman_add_commit(pmtrans_t *trans, pmlist_t **data)
 			_pacman_log(PM_LOG_FLOW1, _("extracting files"));
 
 			/* Extract the package */
-			if ((archive = archive_read_new ()) == NULL)
-				RET_ERR(PM_ERR_LIBARCHIVE_ERROR, -1);
-
-			archive_read_support_compression_all (archive);
-			archive_read_support_format_all (archive);
-
-			if (archive_read_open_file (archive, info->data, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK) {
+			if ((archive = _pacman_archive_open (info->data)) == NULL) {
 				RET_ERR(PM_ERR_PKG_OPEN, -1);
 			}
 
@@ -0,0 +1,232 @@
+/*
+ *  be_changes.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The change log of the local db (local.changes, next to the local
+ * directory) gets the directory name of every entry added, modified or
+ * removed, one per line, once the change is on the disk.  Its length is
+ * the generation of the db: a handle remembers how far it read it when it
+ * loaded the package cache, and only has to reload the entries listed
+ * after that.
+ *
+ * The log is started over once it grows too big, so a different file
+ * means everything has to be reloaded.  So does a change of the local
+ * directory the log does not explain, which is what older versions leave
+ * behind.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "handle.h"
+#include "db.h"
+#include "be_packed.h"
+#include "be_index.h"
+#include "be_changes.h"
+
+/* start a new log past this size */
+#define CHANGES_MAX (256*1024)
+
+/* record that some entries of the local db changed, in a single write */
+void _pacman_dbchanges_logall(pmdb_t *db, pmlist_t *dirnames)
+{
+	char path[PATH_MAX], tmp[PATH_MAX], *data;
+	struct stat buf;
+	size_t len = 0;
+	pmlist_t *i;
+	int fd;
+
+	if(dirnames == NULL) {
+		return;
+	}
+	for(i = dirnames; i; i = i->next) {
+		len += strlen(i->data)+1;
+	}
+	if((data = _pacman_malloc(len+1)) == NULL) {
+		return;
+	}
+	for(len = 0, i = dirnames; i; i = i->next) {
+		len += sprintf(data+len, "%s\n", (char *)i->data);
+	}
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_CHANGES, db->path);
+	if(stat(path, &buf) == 0 && buf.st_size >= CHANGES_MAX) {
+		snprintf(tmp, PATH_MAX, "%s.tmp", path);
+		if((fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644)) != -1) {
+			close(fd);
+			if(rename(tmp, path) == -1) {
+				unlink(tmp);
+			}
+		}
+	}
+	if((fd = open(path, O_WRONLY|O_CREAT|O_APPEND, 0644)) == -1) {
+		/* the handles watching the db will reload it from scratch */
+		_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
+		free(data);
+		return;
+	}
+	if(write(fd, data, len) != (ssize_t)len) {
+		_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
+	}
+	close(fd);
+	free(data);
+}
+
+void _pacman_dbchanges_log(pmdb_t *db, const char *dirname)
+{
+	pmlist_t *dirnames = _pacman_list_add(NULL, (void *)dirname);
+
+	_pacman_dbchanges_logall(db, dirnames);
+	FREELISTPTR(dirnames);
+}
+
+/* remember the current generation, before the package cache gets loaded */
+int _pacman_dbchanges_stamp(pmdb_t *db)
+{
+	pmdbchanges_t *changes = db->changes;
+	char path[PATH_MAX];
+	struct stat buf;
+
+	if(changes == NULL && (changes = _pacman_zalloc(sizeof(pmdbchanges_t))) == NULL) {
+		return(-1);
+	}
+	db->changes = changes;
+	memset(changes, 0, sizeof(pmdbchanges_t));
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_CHANGES, db->path);
+	if(stat(path, &buf) == 0) {
+		changes->dev = buf.st_dev;
+		changes->ino = buf.st_ino;
+		changes->off = buf.st_size;
+	}
+	if(stat(db->path, &buf) == 0) {
+		changes->mtime = buf.st_mtim;
+	}
+	return(0);
+}
+
+/* the mapped pack and the name index may predate the changes */
+static void changes_reset(pmdb_t *db)
+{
+	if(db->pack) {
+		FREEPACKDB(db->pack);
+		if(handle->packeddb) {
+			_pacman_packdb_open(db);
+		}
+	}
+	FREEDBINDEX(db->index);
+}
+
+/* the directory names logged since the last stamp or poll
+ * Returns 0 if the db did not change, 1 if only the entries in *dirnames
+ * did, or -1 if the whole package cache has to be reloaded.
+ */
+int _pacman_dbchanges_poll(pmdb_t *db, pmlist_t **dirnames)
+{
+	pmdbchanges_t *changes = db->changes;
+	char path[PATH_MAX], *data, *ptr, *end, *nl;
+	struct stat dirbuf, buf;
+	size_t len, done = 0;
+	ssize_t n;
+	int fd, samedir;
+
+	*dirnames = NULL;
+	if(changes == NULL || stat(db->path, &dirbuf) == -1) {
+		changes_reset(db);
+		return(-1);
+	}
+	samedir = (dirbuf.st_mtim.tv_sec == changes->mtime.tv_sec &&
+		dirbuf.st_mtim.tv_nsec == changes->mtime.tv_nsec);
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_CHANGES, db->path);
+	if(stat(path, &buf) == -1) {
+		buf.st_dev = 0;
+		buf.st_ino = 0;
+		buf.st_size = 0;
+	}
+	if(buf.st_dev != changes->dev || buf.st_ino != changes->ino || buf.st_size < changes->off) {
+		changes_reset(db);
+		return(-1);
+	}
+	if(buf.st_size == changes->off) {
+		if(samedir) {
+			return(0);
+		}
+		changes_reset(db);
+		return(-1);
+	}
+
+	/* read from the end of the previous line, to make sure the log is the
+	 * one we read before */
+	len = buf.st_size-changes->off+1;
+	if(changes->off == 0) {
+		len--;
+	}
+	if((fd = open(path, O_RDONLY)) == -1 || (data = _pacman_malloc(len)) == NULL) {
+		if(fd != -1) {
+			close(fd);
+		}
+		changes_reset(db);
+		return(-1);
+	}
+	while(done < len && (n = pread(fd, data+done, len-done, buf.st_size-len+done)) > 0) {
+		done += n;
+	}
+	close(fd);
+	ptr = data;
+	end = data+done;
+	if(done < len || (changes->off > 0 && *ptr++ != '\n')) {
+		free(data);
+		changes_reset(db);
+		return(-1);
+	}
+
+	/* a line being written is left for the next poll */
+	while(ptr < end && (nl = memchr(ptr, '\n', end-ptr)) != NULL) {
+		*nl = '\0';
+		if(*ptr && !_pacman_list_is_strin(ptr, *dirnames)) {
+			*dirnames = _pacman_list_add(*dirnames, strdup(ptr));
+		}
+		changes->off += nl+1-ptr;
+		ptr = nl+1;
+	}
+	free(data);
+	if(*dirnames == NULL) {
+		return(0);
+	}
+	changes->mtime = dirbuf.st_mtim;
+	changes_reset(db);
+	return(1);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,47 @@
+/*
+ *  be_changes.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_CHANGES_H
+#define _PACMAN_BE_CHANGES_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "list.h"
+#include "db.h"
+
+#define PM_EXT_CHANGES ".changes"
+
+/* how much of the change log of the local db the package cache has seen */
+typedef struct __pmdbchanges_t {
+	dev_t dev;
+	ino_t ino;             /* 0 if there was no log */
+	off_t off;             /* the generation: the length of the log read */
+	struct timespec mtime; /* of the local directory */
+} pmdbchanges_t;
+
+void _pacman_dbchanges_logall(pmdb_t *db, pmlist_t *dirnames);
+void _pacman_dbchanges_log(pmdb_t *db, const char *dirname);
+int _pacman_dbchanges_stamp(pmdb_t *db);
+int _pacman_dbchanges_poll(pmdb_t *db, pmlist_t **dirnames);
+
+#endif /* _PACMAN_BE_CHANGES_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,263 @@
+/*
+ *  be_delta.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* Sync database deltas
+ *
+ * A delta brings the copy of a sync db from one version of the repository
+ * to the current one, so that a small change to a big repository does not
+ * cost the whole archive.  It is named <treename>-<from>.fdd after the mtime
+ * of the .fdb it applies to (the .lastupdate of the local copy), and is a
+ * compressed tar archive like the .fdb: a .DELTA record first
+ *
+ *   %FROM%    the mtime of the .fdb the delta applies to
+ *   %TO%      the mtime of the .fdb it gives
+ *   %REMOVE%  the entries (name-version) which are gone
+ *
+ * then the entries which were added or changed, laid out as in the .fdb.
+ * Applying it patches the pack of the db (see be_packed.c): the entries of
+ * the old one which are not removed nor shipped again are kept, the ones of
+ * the delta are added, and the old .fdb is removed, as the pack is the only
+ * up to date copy then.  The package cache is patched the same way, by the
+ * caller.  A delta whose FROM and TO are the same tells the copy is up to
+ * date.  When there is no usable pack, or the server has no delta for our
+ * version, the whole .fdb is downloaded as before.  scripts/gendelta
+ * generates them on the server side.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "list.h"
+#include "db.h"
+#include "handle.h"
+#include "server.h"
+#include "pacman.h"
+#include "be_delta.h"
+#include "be_packed.h"
+#include "readahead.h"
+
+typedef struct __pmdelta_t {
+	char from[16];
+	char to[16];
+	pmlist_t *skip;    /* entries of the old copy not to be kept */
+	pmlist_t *members; /* pmpackmember_t */
+} pmdelta_t;
+
+static void delta_freemember(void *data)
+{
+	pmpackmember_t *member = data;
+
+	if(member) {
+		free(member->path);
+		free(member->data);
+		free(member);
+	}
+}
+
+/* the entry (the leading directory) an archive member belongs to */
+static void delta_entryname(const char *pathname, char *name, size_t size)
+{
+	const char *slash;
+
+	if(!strncmp(pathname, "./", 2)) {
+		pathname += 2;
+	}
+	if((slash = strchr(pathname, '/')) == NULL || (size_t)(slash-pathname) >= size) {
+		STRNCPY(name, pathname, size);
+	} else {
+		memcpy(name, pathname, slash-pathname);
+		name[slash-pathname] = '\0';
+	}
+}
+
+static int delta_parse(pmdelta_t *delta, char *data)
+{
+	char *line, *ptr = NULL, *section = NULL;
+
+	for(line = strtok_r(data, "\n", &ptr); line; line = strtok_r(NULL, "\n", &ptr)) {
+		_pacman_strtrim(line);
+		if(line[0] == '\0') {
+			continue;
+		} else if(line[0] == '%') {
+			section = line;
+		} else if(section == NULL) {
+			return(-1);
+		} else if(!strcmp(section, "%FROM%")) {
+			STRNCPY(delta->from, line, sizeof(delta->from));
+		} else if(!strcmp(section, "%TO%")) {
+			STRNCPY(delta->to, line, sizeof(delta->to));
+		} else if(!strcmp(section, "%REMOVE%")) {
+			char *name = strdup(line);
+			if(name == NULL) {
+				return(-1);
+			}
+			delta->skip = _pacman_list_add(delta->skip, name);
+		}
+	}
+	return((delta->from[0] && delta->to[0]) ? 0 : -1);
+}
+
+/* reads the whole delta in memory, it is small */
+static int delta_read(pmdelta_t *delta, const char *path)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char *buf = NULL, name[PATH_MAX];
+	size_t len, size = 0;
+	int r, ret = -1;
+
+	if((a = _pacman_archive_open(path)) == NULL) {
+		return(-1);
+	}
+	while((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+		const char *pathname = archive_entry_pathname(ae);
+		pmpackmember_t *member;
+
+		len = 0;
+		if(_pacman_archive_read_entry(a, ae, &buf, &len, &size) == -1) {
+			goto cleanup;
+		}
+		if(!strcmp(pathname, PM_DELTA_RECORD)) {
+			char *record = strndup(buf ? buf : "", len);
+			int parsed = record ? delta_parse(delta, record) : -1;
+			free(record);
+			if(parsed == -1) {
+				goto cleanup;
+			}
+			continue;
+		}
+		if((member = _pacman_zalloc(sizeof(pmpackmember_t))) == NULL) {
+			goto cleanup;
+		}
+		delta->members = _pacman_list_add(delta->members, member);
+		if((member->path = strdup(pathname)) == NULL ||
+			(len && (member->data = _pacman_malloc(len)) == NULL)) {
+			goto cleanup;
+		}
+		memcpy(member->data, buf, len);
+		member->len = len;
+		delta_entryname(pathname, name, sizeof(name));
+		/* the members of an entry come one after the other */
+		if(delta->skip == NULL || strcmp(delta->skip->last->data, name)) {
+			char *entry = strdup(name);
+			if(entry == NULL) {
+				goto cleanup;
+			}
+			delta->skip = _pacman_list_add(delta->skip, entry);
+		}
+	}
+	if(r == ARCHIVE_EOF && delta->from[0]) {
+		ret = 0;
+	}
+
+cleanup:
+	free(buf);
+	archive_read_finish(a);
+	return(ret);
+}
+
+/* Applies the delta at path to the pack of db, which has to be at version
+ * from.  Returns 0 if the pack got patched (*changed is set to the entries,
+ * name-version, which were removed, added or changed), 1 if it was up to date,
+ * -1 on error.  newmtime is set to the version it is at afterwards.
+ */
+int _pacman_db_applydelta(pmdb_t *db, const char *path, const char *from, char *newmtime, pmlist_t **changed)
+{
+	pmdelta_t delta;
+	int ret = -1;
+
+	*changed = NULL;
+	memset(&delta, 0, sizeof(delta));
+	if(_pacman_packdb_convert(db) == -1) {
+		/* only the pack can be patched */
+		return(-1);
+	}
+	if(delta_read(&delta, path) == -1) {
+		_pacman_log(PM_LOG_WARNING, _("invalid database delta %s"), path);
+		goto cleanup;
+	}
+	if(strcmp(delta.from, from)) {
+		_pacman_log(PM_LOG_DEBUG, _("delta %s is for %s, not %s"), path, delta.from, from);
+		goto cleanup;
+	}
+	if(!strcmp(delta.to, from)) {
+		ret = 1;
+		goto cleanup;
+	}
+	if(_pacman_packdb_patch(db, delta.skip, delta.members) == -1) {
+		goto cleanup;
+	}
+	_pacman_log(PM_LOG_FLOW1, _("applied delta %s-%s to %s: %u entries removed or changed, %u members added"),
+		delta.from, delta.to, db->treename, _pacman_list_count(delta.skip), _pacman_list_count(delta.members));
+	*changed = delta.skip;
+	delta.skip = NULL;
+	ret = 0;
+
+cleanup:
+	if(ret != -1) {
+		strcpy(newmtime, delta.to);
+	}
+	FREELIST(delta.skip);
+	_FREELIST(delta.members, delta_freemember);
+	return(ret);
+}
+
+/* Tries to bring the pack of db from lastupdate to the current version of
+ * the repository using a delta, downloaded to dbpath.
+ * Returns 0 if it worked (*changed lists the entries it touched), 1 if the
+ * pack is up to date (newmtime is set then), -1 if the whole .fdb has to be
+ * downloaded.
+ */
+int _pacman_db_fetchdelta(pmdb_t *db, const char *dbpath, const char *lastupdate, char *newmtime, pmlist_t **changed)
+{
+	char fn[PATH_MAX], path[PATH_MAX];
+	pmlist_t *files = NULL;
+	int ret = -1, error;
+
+	*changed = NULL;
+	snprintf(fn, PATH_MAX, "%s-%s" PM_EXT_DELTA, db->treename, lastupdate);
+	files = _pacman_list_add(files, strdup(fn));
+	/* a missing delta is no error, the whole .fdb gets downloaded then */
+	if(_pacman_downloadfiles_r(db->servers, dbpath, files, NULL, NULL, 0, &error) == 0) {
+		snprintf(path, PATH_MAX, "%s/%s", dbpath, fn);
+		ret = _pacman_db_applydelta(db, path, lastupdate, newmtime, changed);
+		unlink(path);
+	}
+	FREELIST(files);
+	if(ret == -1) {
+		_pacman_log(PM_LOG_FLOW1, _("no usable delta for %s, downloading the whole database"), db->treename);
+	}
+	return(ret);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,35 @@
+/*
+ *  be_delta.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_DELTA_H
+#define _PACMAN_BE_DELTA_H
+
+#include "db.h"
+
+#define PM_EXT_DELTA ".fdd"
+/* the first member of a delta */
+#define PM_DELTA_RECORD ".DELTA"
+
+int _pacman_db_applydelta(pmdb_t *db, const char *path, const char *from, char *newmtime, pmlist_t **changed);
+int _pacman_db_fetchdelta(pmdb_t *db, const char *dbpath, const char *lastupdate, char *newmtime, pmlist_t **changed);
+
+#endif /* _PACMAN_BE_DELTA_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -24,15 +24,20 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <ctype.h>
 #include <errno.h>
 #include <string.h>
 #ifdef __sun__
 #include <strings.h>
 #endif
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <libintl.h>
 #include <locale.h>
+#include <pthread.h>
 #ifdef CYGWIN
 #include <limits.h> /* PATH_MAX */
 #endif
@@ -43,6 +48,14 @@
 #include "pacman.h"
 #include "error.h"
 #include "handle.h"
+#include "deps.h"
+#include "parallel.h"
+#include "be_packed.h"
+#include "be_index.h"
+#include "be_journal.h"
+#include "be_changes.h"
+#include "be_filesdb.h"
+#include "readahead.h"
 
 static inline int islocal(pmdb_t *db)
 {
@@ -52,47 +65,10 @@ static inline int islocal(pmdb_t *db)
 		return strcmp(db->treename, "local") == 0;
 }
 
-pmlist_t *_pacman_db_test(pmdb_t *db)
+int _pacman_db_open(pmdb_t *db)
 {
-	struct dirent *ent;
 	char path[PATH_MAX];
-	struct stat buf;
-	pmlist_t *ret = NULL;
-
-	/* testing sync dbs is not supported */
-	if (!islocal(db))
-		return ret;
-
-	while ((ent = readdir(db->handle)) != NULL) {
-		snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-		stat(path, &buf);
-		if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..") || !S_ISDIR(buf.st_mode)) {
-			continue;
-		}
-		snprintf(path, PATH_MAX, "%s/%s/desc", db->path, ent->d_name);
-		if(stat(path, &buf))
-		{
-			snprintf(path, LOG_STR_LEN, _("%s: description file is missing"), ent->d_name);
-			ret = _pacman_list_add(ret, strdup(path));
-		}
-		snprintf(path, PATH_MAX, "%s/%s/depends", db->path, ent->d_name);
-		if(stat(path, &buf))
-		{
-			snprintf(path, LOG_STR_LEN, _("%s: dependency information is missing"), ent->d_name);
-			ret = _pacman_list_add(ret, strdup(path));
-		}
-		snprintf(path, PATH_MAX, "%s/%s/files", db->path, ent->d_name);
-		if(stat(path, &buf))
-		{
-			snprintf(path, LOG_STR_LEN, _("%s: file list is missing"), ent->d_name);
-			ret = _pacman_list_add(ret, strdup(path));
-		}
-	}
-	return(ret);
-}
 
-int _pacman_db_open(pmdb_t *db)
-{
 	if(db == NULL) {
 		RET_ERR(PM_ERR_DB_NULL, -1);
 	}
@@ -102,22 +78,29 @@ int _pacman_db_open(pmdb_t *db)
 		if(db->handle == NULL) {
 			RET_ERR(PM_ERR_DB_OPEN, -1);
 		}
+		if(_pacman_journal_recover(db) == -1) {
+			/* pm_errno is set by _pacman_journal_recover() */
+			closedir(db->handle);
+			db->handle = NULL;
+			return(-1);
+		}
+		snprintf(path, PATH_MAX, "%s" PM_EXT_META, db->path);
+		db->combined = (access(path, F_OK) == 0);
+		if(handle->packeddb) {
+			_pacman_packdb_open(db);
+		}
 	} else {
 		char dbpath[PATH_MAX];
 		snprintf(dbpath, PATH_MAX, "%s" PM_EXT_DB, db->path);
 		struct stat buf;
-		if(stat(dbpath, &buf) != 0) {
+		if(_pacman_packdb_opensync(db) != NULL) {
+			/* no need to decompress the archive, if there is one still */
+			db->handle = NULL;
+		} else if(stat(dbpath, &buf) != 0) {
 			// db is not there, we'll open it later
 			db->handle = NULL;
 			return 0;
-		}
-		if((db->handle = archive_read_new()) == NULL) {
-			RET_ERR(PM_ERR_DB_OPEN, -1);
-		}
-		archive_read_support_compression_all(db->handle);
-		archive_read_support_format_all(db->handle);
-		if(archive_read_open_filename(db->handle, dbpath, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK) {
-			archive_read_finish(db->handle);
+		} else if((db->handle = _pacman_archive_open(dbpath)) == NULL) {
 			RET_ERR(PM_ERR_DB_OPEN, -1);
 		}
 	}
@@ -141,6 +124,10 @@ void _pacman_db_close(pmdb_t *db)
 			archive_read_finish(db->handle);
 		db->handle = NULL;
 	}
+	FREEPACKDB(db->pack);
+	FREEDBINDEX(db->index);
+	FREEJOURNAL(db->journal);
+	FREEFILESDB(db->files);
 }
 
 void _pacman_db_rewind(pmdb_t *db)
@@ -151,27 +138,68 @@ void _pacman_db_rewind(pmdb_t *db)
 
 	if (islocal(db)) {
 		rewinddir(db->handle);
+		if(db->pack) {
+			db->pack->pos = 0;
+		}
+	} else if(_pacman_packdb_convert(db) == 0) {
+		/* the archive is not needed anymore */
+		if(db->handle) {
+			archive_read_finish(db->handle);
+			db->handle = NULL;
+		}
+		db->pack->pos = 0;
 	} else {
 		char dbpath[PATH_MAX];
 		snprintf(dbpath, PATH_MAX, "%s" PM_EXT_DB, db->path);
 		if (db->handle)
 			archive_read_finish(db->handle);
-		db->handle = archive_read_new();
-		archive_read_support_compression_all(db->handle);
-		archive_read_support_format_all(db->handle);
-		if (archive_read_open_filename(db->handle, dbpath, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK) {
-			archive_read_finish(db->handle);
-			db->handle = NULL;
-		}
+		db->handle = _pacman_archive_open(dbpath);
+	}
+}
+
+/* look up a package of the packed local db, by name only */
+static const pmpackentry_t *_pacman_db_packed_find(pmdb_t *db, pmpkg_t *info)
+{
+	const pmpackentry_t *entry = _pacman_packdb_find(db->pack, info->name);
+
+	if(entry == NULL || strcmp(_pacman_packdb_string(db->pack, entry->version), info->version)) {
+		return(NULL);
+	}
+	return(entry);
+}
+
+static pmpkg_t *_pacman_db_scan_packed(pmdb_t *db, const char *target, unsigned int inforeq)
+{
+	const pmpackentry_t *entry;
+	pmpkg_t *pkg;
+
+	if(target != NULL) {
+		entry = _pacman_packdb_find(db->pack, target);
+	} else {
+		entry = _pacman_packdb_next(db->pack);
+	}
+	if(entry == NULL) {
+		return(NULL);
+	}
+
+	pkg = _pacman_pkg_new(_pacman_packdb_string(db->pack, entry->name),
+		_pacman_packdb_string(db->pack, entry->version));
+	if(pkg == NULL) {
+		return(NULL);
+	}
+	if(inforeq != INFRQ_NONE && _pacman_db_read(db, inforeq, pkg) == -1) {
+		FREEPKG(pkg);
 	}
+
+	return(pkg);
 }
 
 pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 {
 	struct dirent *ent = NULL;
-	struct stat sbuf;
-	char path[PATH_MAX];
 	char name[PKG_FULLNAME_LEN];
+	char indexed[PKG_FULLNAME_LEN];
+	const char *entname = NULL;
 	char *ptr = NULL;
 	int found = 0;
 	pmpkg_t *pkg;
@@ -184,19 +212,18 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 		RET_ERR(PM_ERR_DB_NULL, NULL);
 	}
 
+	if(_pacman_packdb_usable(db)) {
+		return(_pacman_db_scan_packed(db, target, inforeq));
+	}
+
 	if(target != NULL) {
 		/* search for a specific package (by name only) */
-		if (islocal(db)) {
+		if (islocal(db) && (found = _pacman_dbindex_find(db, target, indexed, sizeof(indexed))) != -1) {
+			entname = indexed;
+		} else if (islocal(db)) {
+			found = 0;
 			rewinddir(db->handle);
-			while(!found && (ent = readdir(db->handle)) != NULL) {
-				if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-					continue;
-				}
-				/* stat the entry, make sure it's a directory */
-				snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-				if(stat(path, &sbuf) || !S_ISDIR(sbuf.st_mode)) {
-					continue;
-				}
+			while(!found && (ent = _pacman_readdir_subdir(db->handle)) != NULL) {
 				STRNCPY(name, ent->d_name, PKG_FULLNAME_LEN);
 				/* truncate the string at the second-to-last hyphen, */
 				/* which will give us the package name */
@@ -208,13 +235,17 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 				}
 				if(!strcmp(name, target)) {
 					found = 1;
+					entname = ent->d_name;
 				}
 			}
 		} else {
 			// seek to start
-			_pacman_db_rewind(db->handle);
+			_pacman_db_rewind(db);
+			if(_pacman_packdb_usable(db)) {
+				return(_pacman_db_scan_packed(db, target, inforeq));
+			}
 
-			while (!found && archive_read_next_header(db->handle, &entry) == ARCHIVE_OK) {
+			while (!found && db->handle && archive_read_next_header(db->handle, &entry) == ARCHIVE_OK) {
 				// make sure it's a directory
 				const char *pathname = archive_entry_pathname(entry);
 				if (pathname[strlen(pathname)-1] != '/')
@@ -241,19 +272,12 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 		int isdir = 0;
 		while(!isdir) {
 			if (islocal(db)) {
-				ent = readdir(db->handle);
+				ent = _pacman_readdir_subdir(db->handle);
 				if(ent == NULL) {
 					return(NULL);
 				}
-				if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-					isdir = 0;
-					continue;
-				}
-				/* stat the entry, make sure it's a directory */
-				snprintf(path, PATH_MAX, "%s/%s", db->path, ent->d_name);
-				if(!stat(path, &sbuf) && S_ISDIR(sbuf.st_mode)) {
-					isdir = 1;
-				}
+				isdir = 1;
+				entname = ent->d_name;
 			} else {
 				if (!db->handle)
 					_pacman_db_rewind(db);
@@ -274,7 +298,7 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 	}
 	char *dname;
 	if (islocal(db)) {
-		dname = strdup(ent->d_name);
+		dname = strdup(entname);
 	} else {
 		dname = strdup(archive_entry_pathname(entry));
 		dname[strlen(dname)-1] = '\0'; // drop trailing slash
@@ -285,232 +309,404 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq)
 		return(NULL);
 	}
 	FREE(dname);
-	if(_pacman_db_read(db, inforeq, pkg) == -1) {
+	/* a local entry we just found needs no further check if nothing is requested */
+	if((!islocal(db) || inforeq != INFRQ_NONE) && _pacman_db_read(db, inforeq, pkg) == -1) {
 		FREEPKG(pkg);
 	}
 
 	return(pkg);
 }
 
-static char *_pacman_db_read_fgets(pmdb_t *db, char *line, size_t size, FILE *fp)
+/* A section (desc, depends or files) of a database entry, read at once.
+ * data is either a view (into the packed db, the journal or a combined
+ * record) or alloc.
+ */
+typedef struct __pmdbrecord_t {
+	const char *data;
+	size_t len;
+	char *alloc;
+} pmdbrecord_t;
+
+#define FREERECORD(r) do { FREE((r)->alloc); (r)->data = NULL; (r)->len = 0; } while(0)
+
+/* reads a whole file, relative to dfd, using a single read */
+static int _pacman_db_slurp(int dfd, const char *path, pmdbrecord_t *rec)
 {
-	if (islocal(db))
-		return fgets(line, size, fp);
-	else
-		return _pacman_archive_fgets(line, size, db->handle);
+	struct stat buf;
+	ssize_t n;
+	int fd;
+
+	if((fd = openat(dfd, path, O_RDONLY)) == -1) {
+		return(-1);
+	}
+	if(fstat(fd, &buf) == -1 || (rec->alloc = _pacman_malloc(buf.st_size+1)) == NULL) {
+		close(fd);
+		return(-1);
+	}
+	if((n = read(fd, rec->alloc, buf.st_size)) != buf.st_size) {
+		if(n != -1) {
+			errno = EIO;
+		}
+		FREE(rec->alloc);
+		close(fd);
+		return(-1);
+	}
+	close(fd);
+	rec->data = rec->alloc;
+	rec->len = buf.st_size;
+	return(0);
 }
 
-static int _pacman_db_read_desc(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
+/* reads a file of a db entry, from the packed db if we can
+ * path is <db->path>/<entry>/<file>.
+ */
+static int _pacman_db_getrecord(pmdb_t *db, pmpkg_t *info, int section, const char *path, pmdbrecord_t *rec)
 {
-	FILE *fp = NULL;
-	char path[PATH_MAX];
-	char line[512];
-	int sline = sizeof(line)-1;
-	pmlist_t *i;
+	rec->data = rec->alloc = NULL;
+	rec->len = 0;
+	if(_pacman_journal_lookup(db, path, &rec->data, &rec->len)) {
+		/* written by the running transaction */
+		return(rec->data ? 0 : -1);
+	}
+	if(_pacman_packdb_usable(db)) {
+		const pmpackentry_t *entry = _pacman_db_packed_find(db, info);
+		if(entry == NULL || (rec->data = _pacman_packdb_section(db->pack, entry, section, &rec->len)) == NULL) {
+			errno = ENOENT;
+			return(-1);
+		}
+		return(0);
+	}
+	if(!islocal(db)) {
+		return(_pacman_db_slurp(AT_FDCWD, path, rec));
+	}
+	return(_pacman_db_slurp(dirfd(db->handle), path+strlen(db->path)+1, rec));
+}
 
-	if(inforeq & INFRQ_DESC) {
-		if (islocal(db)) {
-			snprintf(path, PATH_MAX, "%s/%s-%s/desc", db->path, info->name, info->version);
-			fp = fopen(path, "r");
-			if(fp == NULL) {
-				_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
-				goto error;
-			}
+/* reads the current entry of a sync db archive */
+static int _pacman_db_getarchiverecord(struct archive *a, struct archive_entry *entry, pmdbrecord_t *rec)
+{
+	size_t size = 0;
+
+	rec->alloc = NULL;
+	rec->len = 0;
+	if(_pacman_archive_read_entry(a, entry, &rec->alloc, &rec->len, &size) == -1) {
+		FREE(rec->alloc);
+		return(-1);
+	}
+	rec->data = rec->alloc;
+	return(0);
+}
+
+/* parses the header of a combined record
+ * Returns the length of the header, or -1 if data is not a combined record.
+ */
+int _pacman_db_meta_split(const char *data, size_t len, size_t *desclen, size_t *deplen)
+{
+	const char *nl = memchr(data, '\n', len);
+	unsigned long len1, len2;
+	size_t hdrlen;
+
+	if(nl == NULL || strncmp(data, PM_DB_META_MAGIC " ", strlen(PM_DB_META_MAGIC)+1) ||
+		sscanf(data+strlen(PM_DB_META_MAGIC), " %lu %lu", &len1, &len2) != 2) {
+		return(-1);
+	}
+	hdrlen = nl-data+1;
+	if(len1 > len-hdrlen || len2 > len-hdrlen-len1) {
+		return(-1);
+	}
+	*desclen = len1;
+	*deplen = len2;
+	return(hdrlen);
+}
+
+/* Record parser
+ *
+ * Records are "%KEYWORD%" lines, each followed by its value (a line, or a
+ * list of lines ending with an empty one).  Lines are split in place with
+ * memchr() and handed out as trimmed views into the record; the keywords are
+ * looked up in a table telling where their value goes in pmpkg_t.
+ *
+ * The paths of a CFILES list are sorted, each line giving the number of
+ * bytes the path shares with the previous one, a space and the rest of it.
+ */
+
+enum {
+	DB_VALUE_LIST,   /* pmlist_t * of strings */
+	DB_VALUE_ILIST,  /* pmlist_t * of strings from the handle's pool */
+	DB_VALUE_STRING, /* char[] */
+	DB_VALUE_ULONG,  /* unsigned long */
+	DB_VALUE_UCHAR,  /* unsigned char */
+	DB_VALUE_FLAG,   /* unsigned char set to 1, no value */
+	DB_VALUE_FILES,  /* pmfilelist_t *, one path per line */
+	DB_VALUE_CFILES  /* pmfilelist_t *, front-coded paths */
+};
+
+typedef struct __pmdbkeyword_t {
+	const char *key;
+	size_t keylen;
+	unsigned char type;
+	unsigned char records; /* INFRQ_* of the records the keyword is known in */
+	size_t offset;
+	size_t size;
+} pmdbkeyword_t;
+
+#define DB_KEYWORD(key, type, records, field) \
+	{ key, sizeof(key)-1, type, records, offsetof(pmpkg_t, field), sizeof(((pmpkg_t *)0)->field) }
+
+static const pmdbkeyword_t _pacman_db_keywords[] = {
+	DB_KEYWORD("%DESC%",        DB_VALUE_LIST,   INFRQ_DESC,                 desc_localized),
+	DB_KEYWORD("%GROUPS%",      DB_VALUE_ILIST,  INFRQ_DESC,                 groups),
+	DB_KEYWORD("%URL%",         DB_VALUE_STRING, INFRQ_DESC,                 url),
+	DB_KEYWORD("%LICENSE%",     DB_VALUE_ILIST,  INFRQ_DESC,                 license),
+	DB_KEYWORD("%ARCH%",        DB_VALUE_STRING, INFRQ_DESC,                 arch),
+	DB_KEYWORD("%BUILDDATE%",   DB_VALUE_STRING, INFRQ_DESC,                 builddate),
+	DB_KEYWORD("%BUILDTYPE%",   DB_VALUE_STRING, INFRQ_DESC,                 buildtype),
+	DB_KEYWORD("%INSTALLDATE%", DB_VALUE_STRING, INFRQ_DESC,                 installdate),
+	DB_KEYWORD("%PACKAGER%",    DB_VALUE_STRING, INFRQ_DESC,                 packager),
+	DB_KEYWORD("%REASON%",      DB_VALUE_UCHAR,  INFRQ_DESC,                 reason),
+	/* CSIZE and SIZE share the size field: CSIZE is only used in sync
+	 * databases, and SIZE only in local databases */
+	DB_KEYWORD("%SIZE%",        DB_VALUE_ULONG,  INFRQ_DESC,                 size),
+	DB_KEYWORD("%CSIZE%",       DB_VALUE_ULONG,  INFRQ_DESC,                 size),
+	/* USIZE, SHA1SUM and MD5SUM only appear in sync repositories */
+	DB_KEYWORD("%USIZE%",       DB_VALUE_ULONG,  INFRQ_DESC,                 usize),
+	DB_KEYWORD("%SHA1SUM%",     DB_VALUE_STRING, INFRQ_DESC,                 sha1sum),
+	DB_KEYWORD("%MD5SUM%",      DB_VALUE_STRING, INFRQ_DESC,                 md5sum),
+	DB_KEYWORD("%DEPENDS%",     DB_VALUE_ILIST,  INFRQ_DEPENDS,              depends),
+	DB_KEYWORD("%REQUIREDBY%",  DB_VALUE_LIST,   INFRQ_DEPENDS,              requiredby),
+	DB_KEYWORD("%CONFLICTS%",   DB_VALUE_ILIST,  INFRQ_DEPENDS,              conflicts),
+	DB_KEYWORD("%PROVIDES%",    DB_VALUE_ILIST,  INFRQ_DEPENDS,              provides),
+	/* REPLACES, FORCE and STICK only appear in sync repositories; they have
+	 * been moved from desc to depends, the desc ones are only here for
+	 * backwards-compatibility with pacman sync repos */
+	DB_KEYWORD("%REPLACES%",    DB_VALUE_ILIST,  INFRQ_DESC | INFRQ_DEPENDS, replaces),
+	DB_KEYWORD("%FORCE%",       DB_VALUE_FLAG,   INFRQ_DESC | INFRQ_DEPENDS, force),
+	DB_KEYWORD("%STICK%",       DB_VALUE_FLAG,   INFRQ_DESC | INFRQ_DEPENDS, stick),
+	/* CFILES is the front-coded form of FILES, written with CompactFiles */
+	DB_KEYWORD("%FILES%",       DB_VALUE_FILES,  INFRQ_FILES,                filelist),
+	DB_KEYWORD("%CFILES%",      DB_VALUE_CFILES, INFRQ_FILES,                filelist),
+	DB_KEYWORD("%BACKUP%",      DB_VALUE_LIST,   INFRQ_FILES,                backup),
+	{ NULL, 0, 0, 0, 0, 0 }
+};
+
+/* the next line of a record, trimmed */
+static int _pacman_db_nextline(const char **ptr, const char *end, const char **line, size_t *len)
+{
+	const char *start = *ptr, *stop;
+
+	if(start >= end) {
+		return(0);
+	}
+	if((stop = memchr(start, '\n', end-start)) == NULL) {
+		stop = end;
+	}
+	*ptr = stop < end ? stop+1 : end;
+	while(start < stop && isspace((unsigned char)*start)) {
+		start++;
+	}
+	while(stop > start && isspace((unsigned char)stop[-1])) {
+		stop--;
+	}
+	*line = start;
+	*len = stop-start;
+	return(1);
+}
+
+static const pmdbkeyword_t *_pacman_db_keyword(const char *line, size_t len, unsigned int record)
+{
+	const pmdbkeyword_t *kw;
+
+	if(len < 3 || line[0] != '%' || line[len-1] != '%') {
+		return(NULL);
+	}
+	for(kw = _pacman_db_keywords; kw->key; kw++) {
+		if(kw->keylen == len && (kw->records & record) && kw->key[1] == line[1] &&
+			!memcmp(kw->key, line, len)) {
+			return(kw);
 		}
-		while(!islocal(db) || !feof(fp)) {
-			if(_pacman_db_read_fgets(db, line, 256, fp) == NULL) {
-				break;
-			}
-			_pacman_strtrim(line);
-			if(!strcmp(line, "%DESC%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->desc_localized = _pacman_list_add(info->desc_localized, strdup(line));
-				}
-				STRNCPY(info->desc, (char*)info->desc_localized->data, sizeof(info->desc));
-				for (i = info->desc_localized; i; i = i->next) {
-					if (!strncmp(i->data, handle->language, strlen(handle->language)) &&
-							*((char*)i->data+strlen(handle->language)) == ' ') {
-						STRNCPY(info->desc, (char*)i->data+strlen(handle->language)+1, sizeof(info->desc));
+	}
+	return(NULL);
+}
+
+/* decodes a CFILES line, path holding the previous path (of length *len) */
+static int _pacman_db_cfilesline(char *path, size_t *len, const char *line, size_t linelen)
+{
+	const char *ptr = line, *end = line+linelen;
+	size_t shared = 0;
+
+	if(ptr == end || !isdigit((unsigned char)*ptr)) {
+		return(-1);
+	}
+	while(ptr < end && isdigit((unsigned char)*ptr)) {
+		shared = shared*10+(*ptr++-'0');
+		if(shared > *len) {
+			return(-1);
+		}
+	}
+	if(ptr < end && *ptr++ != ' ') {
+		return(-1);
+	}
+	if(shared+(end-ptr) >= PATH_MAX) {
+		return(-1);
+	}
+	memcpy(path+shared, ptr, end-ptr);
+	*len = shared+(end-ptr);
+	path[*len] = '\0';
+	return(0);
+}
+
+/* parses a desc (record == INFRQ_DESC), depends or files record */
+static int _pacman_db_parse(pmpkg_t *info, unsigned int record, const char *data, size_t len)
+{
+	const char *ptr = data, *end = data+len, *line;
+	size_t linelen;
+	pmfilebuilder_t files;
+	int havefiles = 0;
+
+	_pacman_filebuilder_init(&files);
+	while(_pacman_db_nextline(&ptr, end, &line, &linelen)) {
+		const pmdbkeyword_t *kw = _pacman_db_keyword(line, linelen, record);
+		char *field, tmp[32];
+
+		if(kw == NULL) {
+			continue;
+		}
+		field = (char *)info+kw->offset;
+		switch(kw->type) {
+			case DB_VALUE_ILIST:
+				if(handle->strpool) {
+					info->interned = 1;
+					while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+						const char *str = _pacman_strpool_intern(handle->strpool, line, linelen);
+						if(str) {
+							*(pmlist_t **)field = _pacman_list_add(*(pmlist_t **)field, (char *)str);
+						}
 					}
+					break;
 				}
-				_pacman_strtrim(info->desc);
-			} else if(!strcmp(line, "%GROUPS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->groups = _pacman_list_add(info->groups, strdup(line));
-				}
-			} else if(!strcmp(line, "%URL%")) {
-				if(_pacman_db_read_fgets(db, info->url, sizeof(info->url), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->url);
-			} else if(!strcmp(line, "%LICENSE%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->license = _pacman_list_add(info->license, strdup(line));
-				}
-			} else if(!strcmp(line, "%ARCH%")) {
-				if(_pacman_db_read_fgets(db, info->arch, sizeof(info->arch), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->arch);
-			} else if(!strcmp(line, "%BUILDDATE%")) {
-				if(_pacman_db_read_fgets(db, info->builddate, sizeof(info->builddate), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->builddate);
-			} else if(!strcmp(line, "%BUILDTYPE%")) {
-				if(_pacman_db_read_fgets(db, info->buildtype, sizeof(info->buildtype), fp) == NULL) {
-					goto error;
-				}
-				_pacman_strtrim(info->buildtype);
-			} else if(!strcmp(line, "%INSTALLDATE%")) {
-				if(_pacman_db_read_fgets(db, info->installdate, sizeof(info->installdate), fp) == NULL) {
-					goto error;
+				/* fall through */
+			case DB_VALUE_LIST:
+				while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+					*(pmlist_t **)field = _pacman_list_add(*(pmlist_t **)field, strndup(line, linelen));
 				}
-				_pacman_strtrim(info->installdate);
-			} else if(!strcmp(line, "%PACKAGER%")) {
-				if(_pacman_db_read_fgets(db, info->packager, sizeof(info->packager), fp) == NULL) {
-					goto error;
+			break;
+			case DB_VALUE_FILES:
+				while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+					const char *pipe = memchr(line, '|', linelen);
+					if(pipe) {
+						/* just ignore the content after the pipe for now */
+						linelen = pipe-line;
+					}
+					_pacman_filebuilder_add(&files, line, linelen);
 				}
-				_pacman_strtrim(info->packager);
-			} else if(!strcmp(line, "%REASON%")) {
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
+				havefiles = 1;
+			break;
+			case DB_VALUE_CFILES: {
+				char path[PATH_MAX];
+				size_t pathlen = 0;
+				while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+					if(_pacman_db_cfilesline(path, &pathlen, line, linelen) == 0) {
+						_pacman_filebuilder_add(&files, path, pathlen);
+					}
 				}
-				_pacman_strtrim(tmp);
-				info->reason = atol(tmp);
-			} else if(!strcmp(line, "%SIZE%") || !strcmp(line, "%CSIZE%")) {
-				/* NOTE: the CSIZE and SIZE fields both share the "size" field
-				 *       in the pkginfo_t struct.  This can be done b/c CSIZE
-				 *       is currently only used in sync databases, and SIZE is
-				 *       only used in local databases.
-				 */
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
+				havefiles = 1;
+			}
+			break;
+			case DB_VALUE_STRING:
+				if(!_pacman_db_nextline(&ptr, end, &line, &linelen)) {
+					_pacman_filebuilder_free(&files);
+					return(-1);
 				}
-				_pacman_strtrim(tmp);
-				info->size = atol(tmp);
-			} else if(!strcmp(line, "%USIZE%")) {
-				/* USIZE (uncompressed size) tag only appears in sync repositories,
-				 * not the local one. */
-				char tmp[32];
-				if(_pacman_db_read_fgets(db, tmp, sizeof(tmp), fp) == NULL) {
-					goto error;
+				if(linelen >= kw->size) {
+					linelen = kw->size-1;
 				}
-				_pacman_strtrim(tmp);
-				info->usize = atol(tmp);
-			} else if(!strcmp(line, "%SHA1SUM%")) {
-				/* SHA1SUM tag only appears in sync repositories,
-				 * not the local one. */
-				if(_pacman_db_read_fgets(db, info->sha1sum, sizeof(info->sha1sum), fp) == NULL) {
-					goto error;
+				memcpy(field, line, linelen);
+				field[linelen] = '\0';
+			break;
+			case DB_VALUE_ULONG:
+			case DB_VALUE_UCHAR:
+				if(!_pacman_db_nextline(&ptr, end, &line, &linelen)) {
+					_pacman_filebuilder_free(&files);
+					return(-1);
 				}
-			} else if(!strcmp(line, "%MD5SUM%")) {
-				/* MD5SUM tag only appears in sync repositories,
-				 * not the local one. */
-				if(_pacman_db_read_fgets(db, info->md5sum, sizeof(info->md5sum), fp) == NULL) {
-					goto error;
+				if(linelen >= sizeof(tmp)) {
+					linelen = sizeof(tmp)-1;
 				}
-			/* XXX: these are only here as backwards-compatibility for pacman
-			 * sync repos.... in pacman-g2, they have been moved to DEPENDS.
-			 * Remove this when we move to pacman-g2 repos.
-			 */
-			} else if(!strcmp(line, "%REPLACES%")) {
-				/* the REPLACES tag is special -- it only appears in sync repositories,
-				 * not the local one. */
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->replaces = _pacman_list_add(info->replaces, strdup(line));
+				memcpy(tmp, line, linelen);
+				tmp[linelen] = '\0';
+				if(kw->type == DB_VALUE_ULONG) {
+					*(unsigned long *)field = atol(tmp);
+				} else {
+					*(unsigned char *)field = atol(tmp);
 				}
-			} else if(!strcmp(line, "%FORCE%")) {
-				/* FORCE tag only appears in sync repositories,
-				 * not the local one. */
-				info->force = 1;
-			} else if(!strcmp(line, "%STICK%")) {
-				/* STICK tag only appears in sync repositories,
-				 * not the local one. */
-				info->stick = 1;
-			}
+			break;
+			case DB_VALUE_FLAG:
+				*(unsigned char *)field = 1;
+			break;
 		}
-		if (fp)
-			fclose(fp);
-		fp = NULL;
+	}
+	if(havefiles) {
+		FREEFILELIST(info->filelist);
+		FREELIST(info->files);
+		info->filelist = _pacman_filebuilder_finish(&files);
 	}
 
-	return(0);
+	if((record & INFRQ_DESC) && info->desc_localized) {
+		pmlist_t *i;
+		size_t langlen = strlen(handle->language);
 
-error:
-	if(fp) {
-		fclose(fp);
+		STRNCPY(info->desc, (char *)info->desc_localized->data, sizeof(info->desc));
+		for(i = info->desc_localized; i; i = i->next) {
+			if(!strncmp(i->data, handle->language, langlen) && *((char *)i->data+langlen) == ' ') {
+				STRNCPY(info->desc, (char *)i->data+langlen+1, sizeof(info->desc));
+			}
+		}
+		_pacman_strtrim(info->desc);
 	}
-	return(-1);
+	return(0);
 }
 
-static int _pacman_db_read_depends(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
+/* the paths of a files record, in either of its forms */
+pmfilelist_t *_pacman_db_parse_filelist(const char *data, size_t len)
+{
+	pmpkg_t info;
+	pmfilelist_t *ret;
+
+	memset(&info, 0, sizeof(info));
+	_pacman_db_parse(&info, INFRQ_FILES, data, len);
+	ret = info.filelist;
+	FREELIST(info.backup);
+	return(ret);
+}
+
+/* reads the combined record of a local entry, if it has one */
+static int _pacman_db_read_meta(pmdb_t *db, pmpkg_t *info, pmdbrecord_t *meta, pmdbrecord_t *desc, pmdbrecord_t *depends)
 {
-	FILE *fp = NULL;
 	char path[PATH_MAX];
-	char line[512];
-	int sline = sizeof(line)-1;
+	size_t desclen, deplen;
+	int hdrlen;
 
-	if(inforeq & INFRQ_DEPENDS) {
-		if (islocal(db)) {
-			snprintf(path, PATH_MAX, "%s/%s-%s/depends", db->path, info->name, info->version);
-			fp = fopen(path, "r");
-			if(fp == NULL) {
-				_pacman_log(PM_LOG_WARNING, "%s (%s)", path, strerror(errno));
-				goto error;
-			}
-		}
-		while(!islocal(db) || !feof(fp)) {
-			if(_pacman_db_read_fgets(db, line, 256, fp) == NULL) {
-				break;
-			}
-			_pacman_strtrim(line);
-			if(!strcmp(line, "%DEPENDS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->depends = _pacman_list_add(info->depends, strdup(line));
-				}
-			} else if(!strcmp(line, "%REQUIREDBY%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->requiredby = _pacman_list_add(info->requiredby, strdup(line));
-				}
-			} else if(!strcmp(line, "%CONFLICTS%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->conflicts = _pacman_list_add(info->conflicts, strdup(line));
-				}
-			} else if(!strcmp(line, "%PROVIDES%")) {
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->provides = _pacman_list_add(info->provides, strdup(line));
-				}
-			} else if(!strcmp(line, "%REPLACES%")) {
-				/* the REPLACES tag is special -- it only appears in sync repositories,
-				 * not the local one. */
-				while(_pacman_db_read_fgets(db, line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->replaces = _pacman_list_add(info->replaces, strdup(line));
-				}
-			} else if(!strcmp(line, "%FORCE%")) {
-				/* FORCE tag only appears in sync repositories,
-				 * not the local one. */
-				info->force = 1;
-			} else if(!strcmp(line, "%STICK%")) {
-				/* STICK tag only appears in sync repositories,
-				 * not the local one. */
-				info->stick = 1;
-			}
+	snprintf(path, PATH_MAX, "%s/%s-%s/" PM_DB_META, db->path, info->name, info->version);
+	meta->data = meta->alloc = NULL;
+	if(_pacman_journal_lookup(db, path, &meta->data, &meta->len)) {
+		if(meta->data == NULL) {
+			return(-1);
 		}
-		if (fp)
-			fclose(fp);
-		fp = NULL;
+	} else if(_pacman_db_slurp(dirfd(db->handle), path+strlen(db->path)+1, meta) == -1) {
+		return(-1);
 	}
-
-	return(0);
-
-error:
-	if(fp) {
-		fclose(fp);
+	if((hdrlen = _pacman_db_meta_split(meta->data, meta->len, &desclen, &deplen)) == -1) {
+		_pacman_log(PM_LOG_WARNING, _("%s-%s: invalid " PM_DB_META " file"), info->name, info->version);
+		FREERECORD(meta);
+		return(-1);
 	}
-	return(-1);
+	desc->data = meta->data+hdrlen;
+	desc->len = desclen;
+	desc->alloc = NULL;
+	depends->data = meta->data+hdrlen+desclen;
+	depends->len = deplen;
+	depends->alloc = NULL;
+	return(0);
 }
 
 static int suffixcmp(const char *str, const char *suffix)
@@ -524,12 +720,9 @@ static int suffixcmp(const char *str, const char *suffix)
 
 int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 {
-	FILE *fp = NULL;
 	struct stat buf;
 	char path[PATH_MAX];
-	char line[512];
-	int sline = sizeof(line)-1;
-	char *ptr;
+	pmdbrecord_t rec;
 
 	if(db == NULL) {
 		RET_ERR(PM_ERR_DB_NULL, -1);
@@ -540,34 +733,73 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 		return(-1);
 	}
 
-	snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
-	if(islocal(db) && stat(path, &buf)) {
+	snprintf(path, PATH_MAX, "%s-%s", info->name, info->version);
+	if(_pacman_packdb_usable(db)) {
+		if(_pacman_db_packed_find(db, info) == NULL) {
+			return(-1);
+		}
+	} else if(islocal(db) && fstatat(dirfd(db->handle), path, &buf, 0)) {
 		/* directory doesn't exist or can't be opened */
 		return(-1);
 	}
 
-	if (islocal(db)) {
-		if (_pacman_db_read_desc(db, inforeq, info) == -1)
-			return -1;
+	if (islocal(db) || _pacman_packdb_usable(db)) {
+		pmdbrecord_t meta, desc, depends;
+		int ret = 0;
 
-		if (_pacman_db_read_depends(db, inforeq, info) == -1)
-			return -1;
+		desc.data = depends.data = meta.alloc = NULL;
+		/* one read for both, if the entry has a combined record */
+		if(!_pacman_packdb_usable(db) && (handle->combineddb || db->combined) &&
+			(inforeq & (INFRQ_DESC | INFRQ_DEPENDS))) {
+			_pacman_db_read_meta(db, info, &meta, &desc, &depends);
+		}
+		if(inforeq & INFRQ_DESC) {
+			snprintf(path, PATH_MAX, "%s/%s-%s/desc", db->path, info->name, info->version);
+			if(desc.data == NULL && _pacman_db_getrecord(db, info, PM_PACKDB_DESC, path, &desc) == -1) {
+				_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
+				ret = -1;
+			} else {
+				ret = _pacman_db_parse(info, INFRQ_DESC, desc.data, desc.len);
+				FREERECORD(&desc);
+			}
+		}
+		if(ret == 0 && (inforeq & INFRQ_DEPENDS)) {
+			snprintf(path, PATH_MAX, "%s/%s-%s/depends", db->path, info->name, info->version);
+			if(depends.data == NULL && _pacman_db_getrecord(db, info, PM_PACKDB_DEPENDS, path, &depends) == -1) {
+				_pacman_log(PM_LOG_WARNING, "%s (%s)", path, strerror(errno));
+				ret = -1;
+			} else {
+				ret = _pacman_db_parse(info, INFRQ_DEPENDS, depends.data, depends.len);
+				FREERECORD(&depends);
+			}
+		}
+		FREERECORD(&meta);
+		if(ret == -1) {
+			return(-1);
+		}
 	} else {
 		int descdone = 0, depsdone = 0;
 		while (!descdone || !depsdone) {
 			struct archive_entry *entry = NULL;
+			unsigned int record = 0;
 			if (archive_read_next_header(db->handle, &entry) != ARCHIVE_OK)
 				return -1;
 			const char *pathname = archive_entry_pathname(entry);
 			if (!suffixcmp(pathname, "/desc")) {
-				if (_pacman_db_read_desc(db, inforeq, info) == -1)
-					return -1;
+				record = INFRQ_DESC;
 				descdone = 1;
+			} else if (!suffixcmp(pathname, "/depends")) {
+				record = INFRQ_DEPENDS;
+				depsdone = 1;
 			}
-			if (!suffixcmp(pathname, "/depends")) {
-				if (_pacman_db_read_depends(db, inforeq, info) == -1)
+			if (record & inforeq) {
+				if (_pacman_db_getarchiverecord(db->handle, entry, &rec) == -1)
 					return -1;
-				depsdone = 1;
+				if (_pacman_db_parse(info, record, rec.data, rec.len) == -1) {
+					FREERECORD(&rec);
+					return -1;
+				}
+				FREERECORD(&rec);
 			}
 		}
 	}
@@ -575,171 +807,716 @@ int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info)
 	/* FILES */
 	if(inforeq & INFRQ_FILES) {
 		snprintf(path, PATH_MAX, "%s/%s-%s/files", db->path, info->name, info->version);
-		fp = fopen(path, "r");
-		if(fp == NULL) {
+		if(_pacman_db_getrecord(db, info, PM_PACKDB_FILES, path, &rec) == -1) {
 			_pacman_log(PM_LOG_WARNING, "%s (%s)", path, strerror(errno));
-			goto error;
-		}
-		while(fgets(line, 256, fp)) {
-			_pacman_strtrim(line);
-			if(!strcmp(line, "%FILES%")) {
-				while(fgets(line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					if((ptr = strchr(line, '|'))) {
-						/* just ignore the content after the pipe for now */
-						*ptr = '\0';
-					}
-					info->files = _pacman_list_add(info->files, strdup(line));
-				}
-			} else if(!strcmp(line, "%BACKUP%")) {
-				while(fgets(line, sline, fp) && strlen(_pacman_strtrim(line))) {
-					info->backup = _pacman_list_add(info->backup, strdup(line));
-				}
-			}
+			return(-1);
 		}
-		fclose(fp);
-		fp = NULL;
+		_pacman_db_parse(info, INFRQ_FILES, rec.data, rec.len);
+		FREERECORD(&rec);
 	}
 
 	/* INSTALL */
 	if(inforeq & INFRQ_SCRIPLET) {
-		snprintf(path, PATH_MAX, "%s/%s-%s/install", db->path, info->name, info->version);
-		if(!stat(path, &buf)) {
-			info->scriptlet = 1;
-		}
-	}
+		if(islocal(db) && _pacman_packdb_usable(db)) {
+			const pmpackentry_t *entry = _pacman_db_packed_find(db, info);
+			if(entry && (entry->present & (1 << PM_PACKDB_INSTALL))) {
+				info->scriptlet = 1;
+			}
+		} else if(islocal(db)) {
+			snprintf(path, PATH_MAX, "%s-%s/install", info->name, info->version);
+			if(!fstatat(dirfd(db->handle), path, &buf, 0)) {
+				info->scriptlet = 1;
+			}
+		} else {
+			snprintf(path, PATH_MAX, "%s/%s-%s/install", db->path, info->name, info->version);
+			if(!stat(path, &buf)) {
+				info->scriptlet = 1;
+			}
+		}
+	}
 
 	/* internal */
 	info->infolevel |= inforeq;
 
 	return(0);
+}
+
+/* Database checker
+ *
+ * The entries are checked on the worker pool first: their records have to
+ * be there and to parse, and the files they list have to be on the disk.
+ * Then the packages are checked against each other: no name may be
+ * installed twice, and DEPENDS and REQUIREDBY have to agree.
+ */
+
+typedef struct __pmdbprovide_t {
+	const char *name;
+	pmpkg_t *pkg;
+} pmdbprovide_t;
+
+typedef struct __pmdbtest_t {
+	pmdb_t *db;
+	unsigned int count;
+	char **dirnames;         /* the entries, in directory order */
+	pmpkg_t **pkgs;          /* NULL if the entry name is invalid */
+	pmlist_t **problems;     /* found with each entry */
+	pmpkg_t **byname;        /* the packages, sorted by name */
+	unsigned int npkgs;
+	pmdbprovide_t *provides; /* the names they provide, sorted */
+	unsigned int nprovides;
+	pthread_mutex_t lock;    /* for the progress */
+	unsigned int done;
+	int failed;              /* a problem could not be recorded */
+} pmdbtest_t;
+
+/* the entry a package comes from, as an index in the arrays above */
+#define TEST_IDX(pkg) ((unsigned long)(pkg)->data)
+
+static void test_problem(pmdbtest_t *test, pmlist_t **problems, const char *fmt, ...)
+{
+	char str[LOG_STR_LEN], *problem;
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(str, LOG_STR_LEN, fmt, args);
+	va_end(args);
+	if((problem = strdup(str)) == NULL) {
+		/* the check would look cleaner than it is */
+		pthread_mutex_lock(&test->lock);
+		test->failed = 1;
+		pthread_mutex_unlock(&test->lock);
+		return;
+	}
+	*problems = _pacman_list_add(*problems, problem);
+}
+
+/* reads a file of an entry from the directory layout */
+static int test_slurp(pmdbtest_t *test, const char *dirname, const char *file,
+	const char *missing, pmdbrecord_t *rec, pmlist_t **problems)
+{
+	char path[PATH_MAX];
+
+	rec->data = rec->alloc = NULL;
+	rec->len = 0;
+	snprintf(path, PATH_MAX, "%s/%s", dirname, file);
+	if(_pacman_db_slurp(dirfd(test->db->handle), path, rec) == -1) {
+		if(errno == ENOENT) {
+			test_problem(test, problems, missing, dirname);
+		} else {
+			test_problem(test, problems, _("%s: could not read %s (%s)"), dirname, file, strerror(errno));
+		}
+		return(-1);
+	}
+	return(0);
+}
+
+/* checks that a record only has the keywords it can have, with their value,
+ * then parses it */
+static void test_record(pmdbtest_t *test, pmpkg_t *info, const char *dirname, unsigned int record, const char *file,
+	const pmdbrecord_t *rec, pmlist_t **problems)
+{
+	const char *ptr = rec->data, *end = rec->data+rec->len, *line;
+	size_t linelen;
+
+	while(_pacman_db_nextline(&ptr, end, &line, &linelen)) {
+		const pmdbkeyword_t *kw;
+		const char *expected = NULL;
+
+		if(linelen == 0) {
+			continue;
+		}
+		if(record == INFRQ_DESC && linelen == 6 && !memcmp(line, "%NAME%", 6)) {
+			expected = info->name;
+		} else if(record == INFRQ_DESC && linelen == 9 && !memcmp(line, "%VERSION%", 9)) {
+			expected = info->version;
+		}
+		if(expected) {
+			const char *key = line;
+			size_t keylen = linelen;
+			if(!_pacman_db_nextline(&ptr, end, &line, &linelen) ||
+				linelen != strlen(expected) || memcmp(line, expected, linelen)) {
+				test_problem(test, problems, _("%s: %.*s in %s does not match the entry"),
+					dirname, (int)keylen, key, file);
+			}
+			continue;
+		}
+		if((kw = _pacman_db_keyword(line, linelen, record)) == NULL) {
+			test_problem(test, problems, _("%s: unexpected line in %s: %.*s"), dirname, file, (int)linelen, line);
+			continue;
+		}
+		if(kw->type == DB_VALUE_CFILES) {
+			char path[PATH_MAX], prev[PATH_MAX] = "";
+			size_t pathlen = 0;
+			while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+				if(_pacman_db_cfilesline(path, &pathlen, line, linelen) == -1) {
+					test_problem(test, problems, _("%s: invalid line in %s: %.*s"), dirname, file, (int)linelen, line);
+				} else if(strcmp(prev, path) > 0) {
+					test_problem(test, problems, _("%s: %s is out of order in %s"), dirname, path, file);
+				}
+				strcpy(prev, path);
+			}
+		} else if(kw->type == DB_VALUE_LIST || kw->type == DB_VALUE_ILIST || kw->type == DB_VALUE_FILES) {
+			while(_pacman_db_nextline(&ptr, end, &line, &linelen) && linelen) {
+				/* skip the values */
+			}
+		} else if(kw->type != DB_VALUE_FLAG) {
+			if(!_pacman_db_nextline(&ptr, end, &line, &linelen) || linelen == 0) {
+				test_problem(test, problems, _("%s: %s has no value in %s"), dirname, kw->key, file);
+			}
+		}
+	}
+	_pacman_db_parse(info, record, rec->data, rec->len);
+}
+
+static void test_entry(void *data, unsigned int idx)
+{
+	pmdbtest_t *test = data;
+	const char *dirname = test->dirnames[idx];
+	pmlist_t **problems = &test->problems[idx];
+	char name[PKG_NAME_LEN], version[PKG_VERSION_LEN], path[PATH_MAX];
+	pmdbrecord_t meta, desc, depends, files;
+	pmfileiter_t iter;
+	const char *file;
+	struct stat buf;
+	pmpkg_t *info;
+
+	if(_pacman_pkg_splitname((char *)dirname, name, version, 0) == -1 ||
+		(info = _pacman_pkg_new(name, version)) == NULL) {
+		test_problem(test, problems, _("%s: invalid entry name"), dirname);
+		goto progress;
+	}
+	info->data = (void *)(unsigned long)idx;
+	test->pkgs[idx] = info;
+
+	/* a combined record holds both desc and depends */
+	snprintf(path, PATH_MAX, "%s/" PM_DB_META, dirname);
+	desc.data = depends.data = meta.alloc = NULL;
+	if(!fstatat(dirfd(test->db->handle), path, &buf, 0) &&
+		_pacman_db_read_meta(test->db, info, &meta, &desc, &depends) == -1) {
+		test_problem(test, problems, _("%s: invalid " PM_DB_META " file"), dirname);
+	}
+	if(desc.data || test_slurp(test, dirname, "desc", _("%s: description file is missing"), &desc, problems) == 0) {
+		test_record(test, info, dirname, INFRQ_DESC, "desc", &desc, problems);
+		FREERECORD(&desc);
+	}
+	if(depends.data || test_slurp(test, dirname, "depends", _("%s: dependency information is missing"), &depends, problems) == 0) {
+		test_record(test, info, dirname, INFRQ_DEPENDS, "depends", &depends, problems);
+		FREERECORD(&depends);
+	}
+	FREERECORD(&meta);
+	if(test_slurp(test, dirname, "files", _("%s: file list is missing"), &files, problems) == 0) {
+		test_record(test, info, dirname, INFRQ_FILES, "files", &files, problems);
+		FREERECORD(&files);
+	}
+
+	_pacman_filelist_iter(info->filelist, &iter);
+	while((file = _pacman_filelist_next(&iter))) {
+		if(_pacman_list_is_strin(file, handle->noextract)) {
+			continue;
+		}
+		snprintf(path, PATH_MAX, "%s%s", handle->root, file);
+		if(lstat(path, &buf) == -1 && errno == ENOENT) {
+			test_problem(test, problems, _("%s: %s is missing from the filesystem"), dirname, file);
+		}
+	}
+
+progress:
+	pthread_mutex_lock(&test->lock);
+	test->done++;
+	if(handle->testcb) {
+		handle->testcb(dirname, test->done*100/test->count, test->count, test->done);
+	}
+	pthread_mutex_unlock(&test->lock);
+}
+
+/* by name, then in directory order */
+static int test_pkgcmp(const void *p1, const void *p2)
+{
+	pmpkg_t *pkg1 = *(pmpkg_t *const *)p1, *pkg2 = *(pmpkg_t *const *)p2;
+	int ret = strcmp(pkg1->name, pkg2->name);
+
+	if(ret == 0) {
+		ret = (TEST_IDX(pkg1) > TEST_IDX(pkg2)) - (TEST_IDX(pkg1) < TEST_IDX(pkg2));
+	}
+	return(ret);
+}
+
+static int test_providecmp(const void *p1, const void *p2)
+{
+	return(strcmp(((const pmdbprovide_t *)p1)->name, ((const pmdbprovide_t *)p2)->name));
+}
+
+/* the first package called name */
+static pmpkg_t *test_find(pmdbtest_t *test, const char *name)
+{
+	unsigned int lo = 0, hi = test->npkgs;
+
+	while(lo < hi) {
+		unsigned int mid = lo+(hi-lo)/2;
+		if(strcmp(test->byname[mid]->name, name) < 0) {
+			lo = mid+1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(lo < test->npkgs && !strcmp(test->byname[lo]->name, name) ? test->byname[lo] : NULL);
+}
+
+/* the first package providing name, if any */
+static unsigned int test_provider(pmdbtest_t *test, const char *name)
+{
+	unsigned int lo = 0, hi = test->nprovides;
+
+	while(lo < hi) {
+		unsigned int mid = lo+(hi-lo)/2;
+		if(strcmp(test->provides[mid].name, name) < 0) {
+			lo = mid+1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(lo);
+}
+
+/* does pkg depend on info (or on something info provides)? */
+static int test_depends(pmpkg_t *pkg, pmpkg_t *info)
+{
+	pmlist_t *i;
+
+	for(i = pkg->depends; i; i = i->next) {
+		pmdepend_t depend;
+		if(_pacman_splitdep(i->data, &depend)) {
+			continue;
+		}
+		if(!strcmp(depend.name, info->name) || _pacman_list_is_strin(depend.name, info->provides)) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+static void test_deps(void *data, unsigned int k)
+{
+	pmdbtest_t *test = data;
+	pmpkg_t *info = test->byname[k], *pkg;
+	const char *dirname = test->dirnames[TEST_IDX(info)];
+	pmlist_t **problems = &test->problems[TEST_IDX(info)], *i;
+
+	for(i = info->requiredby; i; i = i->next) {
+		if((pkg = test_find(test, i->data)) == NULL) {
+			test_problem(test, problems, _("%s: required by %s, which is not installed"), dirname, (char *)i->data);
+		} else if(!test_depends(pkg, info)) {
+			test_problem(test, problems, _("%s: required by %s, which does not depend on it"), dirname, (char *)i->data);
+		}
+	}
+	for(i = info->depends; i; i = i->next) {
+		pmdepend_t depend;
+		unsigned int j;
+		int found = 0, listed = 0;
+
+		if(_pacman_splitdep(i->data, &depend)) {
+			continue;
+		}
+		/* the package itself, or one providing it, like _pacman_add_commit() */
+		if((pkg = test_find(test, depend.name)) != NULL) {
+			found = 1;
+			listed = _pacman_list_is_strin(info->name, pkg->requiredby);
+		}
+		for(j = test_provider(test, depend.name); !listed && j < test->nprovides &&
+			!strcmp(test->provides[j].name, depend.name); j++) {
+			found = 1;
+			listed = _pacman_list_is_strin(info->name, test->provides[j].pkg->requiredby);
+		}
+		if(!found) {
+			test_problem(test, problems, _("%s: depends on %s, which is not installed"), dirname, depend.name);
+		} else if(!listed) {
+			test_problem(test, problems, _("%s: depends on %s, which does not have it in its REQUIREDBY"), dirname, depend.name);
+		}
+	}
+}
+
+pmlist_t *_pacman_db_test(pmdb_t *db)
+{
+	pmdbtest_t test;
+	struct dirent *ent;
+	pmlist_t *ret = NULL;
+	unsigned int alloc = 0, i, threads;
+
+	/* testing sync dbs is not supported */
+	if (!islocal(db))
+		return ret;
+
+	memset(&test, 0, sizeof(test));
+	test.db = db;
+	pthread_mutex_init(&test.lock, NULL);
+	rewinddir(db->handle);
+	while((ent = _pacman_readdir_subdir(db->handle)) != NULL) {
+		if(test.count == alloc) {
+			char **dirnames;
+			alloc = alloc ? alloc*2 : 256;
+			if((dirnames = realloc(test.dirnames, alloc*sizeof(char *))) == NULL) {
+				goto error;
+			}
+			test.dirnames = dirnames;
+		}
+		if((test.dirnames[test.count] = strdup(ent->d_name)) == NULL) {
+			goto error;
+		}
+		test.count++;
+	}
+	if(test.count == 0) {
+		goto cleanup;
+	}
+	test.pkgs = _pacman_zalloc(test.count*sizeof(pmpkg_t *));
+	test.problems = _pacman_zalloc(test.count*sizeof(pmlist_t *));
+	test.byname = _pacman_malloc(test.count*sizeof(pmpkg_t *));
+	if(test.pkgs == NULL || test.problems == NULL || test.byname == NULL) {
+		goto error;
+	}
+
+	threads = _pacman_parallel_threads();
+	_pacman_log(PM_LOG_DEBUG, _("checking %u entries of '%s' on %u thread(s)"), test.count, db->treename, threads);
+	_pacman_parallel_for(threads, test.count, test_entry, &test);
+
+	alloc = 0;
+	for(i = 0; i < test.count; i++) {
+		pmpkg_t *info = test.pkgs[i];
+		pmlist_t *j;
+		if(info == NULL) {
+			continue;
+		}
+		test.byname[test.npkgs++] = info;
+		for(j = info->provides; j; j = j->next) {
+			if(test.nprovides == alloc) {
+				pmdbprovide_t *provides;
+				alloc = alloc ? alloc*2 : 256;
+				if((provides = realloc(test.provides, alloc*sizeof(pmdbprovide_t))) == NULL) {
+					goto error;
+				}
+				test.provides = provides;
+			}
+			test.provides[test.nprovides].name = j->data;
+			test.provides[test.nprovides++].pkg = info;
+		}
+	}
+	qsort(test.byname, test.npkgs, sizeof(pmpkg_t *), test_pkgcmp);
+	qsort(test.provides, test.nprovides, sizeof(pmdbprovide_t), test_providecmp);
+	for(i = 1; i < test.npkgs; i++) {
+		pmpkg_t *first = test.byname[i-1], *info = test.byname[i];
+		if(!strcmp(first->name, info->name)) {
+			test_problem(&test, &test.problems[TEST_IDX(info)], _("%s: %s is also installed as %s"),
+				test.dirnames[TEST_IDX(info)], info->name, test.dirnames[TEST_IDX(first)]);
+		}
+	}
+	_pacman_parallel_for(threads, test.npkgs, test_deps, &test);
+	if(test.failed) {
+		goto error;
+	}
+
+	for(i = 0; i < test.count; i++) {
+		pmlist_t *j;
+		for(j = test.problems[i]; j; j = j->next) {
+			ret = _pacman_list_add(ret, j->data);
+		}
+		FREELISTPTR(test.problems[i]);
+	}
+	goto cleanup;
 
 error:
-	if(fp) {
-		fclose(fp);
+	/* a partial check is no check */
+	pm_errno = PM_ERR_MEMORY;
+	FREELIST(ret);
+
+cleanup:
+	pthread_mutex_destroy(&test.lock);
+	for(i = 0; i < test.count; i++) {
+		if(test.pkgs) {
+			FREEPKG(test.pkgs[i]);
+		}
+		if(test.problems) {
+			FREELIST(test.problems[i]);
+		}
+		free(test.dirnames[i]);
 	}
-	return(-1);
+	free(test.dirnames);
+	free(test.pkgs);
+	free(test.problems);
+	free(test.byname);
+	free(test.provides);
+	return(ret);
+}
+
+static void _pacman_db_write_desc(pmdb_t *db, pmpkg_t *info, FILE *fp)
+{
+	pmlist_t *lp;
+
+	fprintf(fp, "%%NAME%%\n%s\n\n"
+		"%%VERSION%%\n%s\n\n", info->name, info->version);
+	if(info->desc[0]) {
+		fputs("%DESC%\n", fp);
+		for(lp = info->desc_localized; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(info->groups) {
+		fputs("%GROUPS%\n", fp);
+		for(lp = info->groups; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(islocal(db)) {
+		if(info->url[0]) {
+			fprintf(fp, "%%URL%%\n"
+				"%s\n\n", info->url);
+		}
+		if(info->license) {
+			fputs("%LICENSE%\n", fp);
+			for(lp = info->license; lp; lp = lp->next) {
+				fprintf(fp, "%s\n", (char *)lp->data);
+			}
+			fprintf(fp, "\n");
+		}
+		if(info->arch[0]) {
+			fprintf(fp, "%%ARCH%%\n"
+				"%s\n\n", info->arch);
+		}
+		if(info->builddate[0]) {
+			fprintf(fp, "%%BUILDDATE%%\n"
+				"%s\n\n", info->builddate);
+		}
+		if(info->buildtype[0]) {
+			fprintf(fp, "%%BUILDTYPE%%\n"
+				"%s\n\n", info->buildtype);
+		}
+		if(info->installdate[0]) {
+			fprintf(fp, "%%INSTALLDATE%%\n"
+				"%s\n\n", info->installdate);
+		}
+		if(info->packager[0]) {
+			fprintf(fp, "%%PACKAGER%%\n"
+				"%s\n\n", info->packager);
+		}
+		if(info->size) {
+			fprintf(fp, "%%SIZE%%\n"
+				"%ld\n\n", info->size);
+		}
+		if(info->reason) {
+			fprintf(fp, "%%REASON%%\n"
+				"%d\n\n", info->reason);
+		}
+	} else {
+		if(info->size) {
+			fprintf(fp, "%%CSIZE%%\n"
+				"%ld\n\n", info->size);
+		}
+		if(info->usize) {
+			fprintf(fp, "%%USIZE%%\n"
+				"%ld\n\n", info->usize);
+		}
+		if(info->sha1sum) {
+			fprintf(fp, "%%SHA1SUM%%\n"
+				"%s\n\n", info->sha1sum);
+		} else if(info->md5sum) {
+			fprintf(fp, "%%MD5SUM%%\n"
+				"%s\n\n", info->md5sum);
+		}
+	}
+}
+
+static void _pacman_db_write_depends(pmdb_t *db, pmpkg_t *info, FILE *fp)
+{
+	pmlist_t *lp;
+
+	if(info->depends) {
+		fputs("%DEPENDS%\n", fp);
+		for(lp = info->depends; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(islocal(db) && info->requiredby) {
+		fputs("%REQUIREDBY%\n", fp);
+		for(lp = info->requiredby; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(info->conflicts) {
+		fputs("%CONFLICTS%\n", fp);
+		for(lp = info->conflicts; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(info->provides) {
+		fputs("%PROVIDES%\n", fp);
+		for(lp = info->provides; lp; lp = lp->next) {
+			fprintf(fp, "%s\n", (char *)lp->data);
+		}
+		fprintf(fp, "\n");
+	}
+	if(!islocal(db)) {
+		if(info->replaces) {
+			fputs("%REPLACES%\n", fp);
+			for(lp = info->replaces; lp; lp = lp->next) {
+				fprintf(fp, "%s\n", (char *)lp->data);
+			}
+			fprintf(fp, "\n");
+		}
+		if(info->force) {
+			fprintf(fp, "%%FORCE%%\n"
+				"\n");
+		}
+		if(info->stick) {
+			fprintf(fp, "%%STICK%%\n"
+				"\n");
+		}
+	}
+}
+
+/* writes the combined record of a local entry */
+static int _pacman_db_write_meta(pmdb_t *db, pmpkg_t *info)
+{
+	char path[PATH_MAX], *desc = NULL, *depends = NULL;
+	size_t desclen = 0, deplen = 0;
+	FILE *fp;
+	int fd, ret = 0;
+
+	if((fp = open_memstream(&desc, &desclen)) == NULL) {
+		return(-1);
+	}
+	_pacman_db_write_desc(db, info, fp);
+	fclose(fp);
+	if((fp = open_memstream(&depends, &deplen)) == NULL) {
+		free(desc);
+		return(-1);
+	}
+	_pacman_db_write_depends(db, info, fp);
+	fclose(fp);
+
+	/* readers only look for combined records once this exists */
+	if(!db->combined) {
+		snprintf(path, PATH_MAX, "%s" PM_EXT_META, db->path);
+		if((fd = open(path, O_WRONLY|O_CREAT, 0644)) == -1) {
+			_pacman_log(PM_LOG_ERROR, _("db_write: could not create %s (%s)"), path, strerror(errno));
+			free(desc);
+			free(depends);
+			return(-1);
+		}
+		close(fd);
+		db->combined = 1;
+	}
+
+	snprintf(path, PATH_MAX, "%s/%s-%s/" PM_DB_META, db->path, info->name, info->version);
+	if((fp = _pacman_journal_fopen(db, path)) == NULL) {
+		_pacman_log(PM_LOG_ERROR, _("db_write: could not open file %s/" PM_DB_META), db->treename);
+		ret = -1;
+	} else {
+		fprintf(fp, "%s %lu %lu\n", PM_DB_META_MAGIC, (unsigned long)desclen, (unsigned long)deplen);
+		fwrite(desc, 1, desclen, fp);
+		fwrite(depends, 1, deplen, fp);
+		if(_pacman_journal_fclose(db, fp) != 0) {
+			ret = -1;
+		}
+	}
+	free(desc);
+	free(depends);
+	return(ret);
 }
 
 int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 {
 	FILE *fp = NULL;
 	char path[PATH_MAX];
+	struct stat buf;
 	mode_t oldmask;
 	pmlist_t *lp = NULL;
 	int retval = 0;
 	int local = 0;
+	int combined = 0;
 
 	if(db == NULL || info == NULL) {
 		return(-1);
 	}
 
+	if(islocal(db)) {
+		local = 1;
+		_pacman_packdb_invalidate(db, info->name, info->version);
+		_pacman_dbindex_load(db);
+	}
+
 	snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
 	oldmask = umask(0000);
-	mkdir(path, 0755);
+	if(mkdir(path, 0755) == 0 && local) {
+		snprintf(path, PATH_MAX, "%s-%s", info->name, info->version);
+		_pacman_dbindex_add(db, path);
+	}
 	/* make sure we have a sane umask */
 	umask(0022);
 
-	if(islocal(db)) {
-		local = 1;
+	/* with CombinedDB, entries are converted to the combined record as they are
+	 * rewritten, and converted back without it */
+	if(local && (inforeq & (INFRQ_DESC | INFRQ_DEPENDS))) {
+		snprintf(path, PATH_MAX, "%s-%s/" PM_DB_META, info->name, info->version);
+		if(handle->combineddb || (db->combined && !fstatat(dirfd(db->handle), path, &buf, 0))) {
+			/* both files come from the same record, so we need both */
+			unsigned int missing = (INFRQ_DESC | INFRQ_DEPENDS) & ~(inforeq | info->infolevel);
+			if(missing == 0 || _pacman_db_read(db, missing, info) == 0) {
+				inforeq |= INFRQ_DESC | INFRQ_DEPENDS;
+				combined = 1;
+			}
+		}
+	}
+	if(combined && handle->combineddb) {
+		if(_pacman_db_write_meta(db, info) == -1) {
+			retval = -1;
+			goto cleanup;
+		}
+		snprintf(path, PATH_MAX, "%s/%s-%s/desc", db->path, info->name, info->version);
+		_pacman_journal_unlink(db, path);
+		snprintf(path, PATH_MAX, "%s/%s-%s/depends", db->path, info->name, info->version);
+		_pacman_journal_unlink(db, path);
+		inforeq &= ~(INFRQ_DESC | INFRQ_DEPENDS);
 	}
 
 	/* DESC */
 	if(inforeq & INFRQ_DESC) {
 		snprintf(path, PATH_MAX, "%s/%s-%s/desc", db->path, info->name, info->version);
-		if((fp = fopen(path, "w")) == NULL) {
+		if((fp = _pacman_journal_fopen(db, path)) == NULL) {
 			_pacman_log(PM_LOG_ERROR, _("db_write: could not open file %s/desc"), db->treename);
 			retval = 1;
 			goto cleanup;
 		}
-		fprintf(fp, "%%NAME%%\n%s\n\n"
-			"%%VERSION%%\n%s\n\n", info->name, info->version);
-		if(info->desc[0]) {
-			fputs("%DESC%\n", fp);
-			for(lp = info->desc_localized; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(info->groups) {
-			fputs("%GROUPS%\n", fp);
-			for(lp = info->groups; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(local) {
-			if(info->url[0]) {
-				fprintf(fp, "%%URL%%\n"
-					"%s\n\n", info->url);
-			}
-			if(info->license) {
-				fputs("%LICENSE%\n", fp);
-				for(lp = info->license; lp; lp = lp->next) {
-					fprintf(fp, "%s\n", (char *)lp->data);
-				}
-				fprintf(fp, "\n");
-			}
-			if(info->arch[0]) {
-				fprintf(fp, "%%ARCH%%\n"
-					"%s\n\n", info->arch);
-			}
-			if(info->builddate[0]) {
-				fprintf(fp, "%%BUILDDATE%%\n"
-					"%s\n\n", info->builddate);
-			}
-			if(info->buildtype[0]) {
-				fprintf(fp, "%%BUILDTYPE%%\n"
-					"%s\n\n", info->buildtype);
-			}
-			if(info->installdate[0]) {
-				fprintf(fp, "%%INSTALLDATE%%\n"
-					"%s\n\n", info->installdate);
-			}
-			if(info->packager[0]) {
-				fprintf(fp, "%%PACKAGER%%\n"
-					"%s\n\n", info->packager);
-			}
-			if(info->size) {
-				fprintf(fp, "%%SIZE%%\n"
-					"%ld\n\n", info->size);
-			}
-			if(info->reason) {
-				fprintf(fp, "%%REASON%%\n"
-					"%d\n\n", info->reason);
-			}
-		} else {
-			if(info->size) {
-				fprintf(fp, "%%CSIZE%%\n"
-					"%ld\n\n", info->size);
-			}
-			if(info->usize) {
-				fprintf(fp, "%%USIZE%%\n"
-					"%ld\n\n", info->usize);
-			}
-			if(info->sha1sum) {
-				fprintf(fp, "%%SHA1SUM%%\n"
-					"%s\n\n", info->sha1sum);
-			} else if(info->md5sum) {
-				fprintf(fp, "%%MD5SUM%%\n"
-					"%s\n\n", info->md5sum);
-			}
-		}
-		fclose(fp);
+		_pacman_db_write_desc(db, info, fp);
+		_pacman_journal_fclose(db, fp);
 		fp = NULL;
 	}
 
 	/* FILES */
 	if(local && (inforeq & INFRQ_FILES)) {
 		snprintf(path, PATH_MAX, "%s/%s-%s/files", db->path, info->name, info->version);
-		if((fp = fopen(path, "w")) == NULL) {
+		if((fp = _pacman_journal_fopen(db, path)) == NULL) {
 			_pacman_log(PM_LOG_ERROR, _("db_write: could not open file %s/files"), db->treename);
 			retval = -1;
 			goto cleanup;
 		}
-		if(info->files) {
-			fprintf(fp, "%%FILES%%\n");
-			for(lp = info->files; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
+		if(info->filelist) {
+			pmfileiter_t iter;
+			const char *file;
+
+			_pacman_filelist_iter(info->filelist, &iter);
+			if(handle->compactfiles) {
+				fprintf(fp, "%%CFILES%%\n");
+				while((file = _pacman_filelist_next(&iter))) {
+					fprintf(fp, "%u %s\n", (unsigned int)iter.shared, file+iter.shared);
+				}
+			} else {
+				fprintf(fp, "%%FILES%%\n");
+				while((file = _pacman_filelist_next(&iter))) {
+					fprintf(fp, "%s\n", file);
+				}
 			}
 			fprintf(fp, "\n");
 		}
@@ -750,67 +1527,28 @@ int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq)
 			}
 			fprintf(fp, "\n");
 		}
-		fclose(fp);
+		_pacman_journal_fclose(db, fp);
 		fp = NULL;
 	}
 
 	/* DEPENDS */
 	if(inforeq & INFRQ_DEPENDS) {
 		snprintf(path, PATH_MAX, "%s/%s-%s/depends", db->path, info->name, info->version);
-		if((fp = fopen(path, "w")) == NULL) {
+		if((fp = _pacman_journal_fopen(db, path)) == NULL) {
 			_pacman_log(PM_LOG_ERROR, _("db_write: could not open file %s/depends"), db->treename);
 			retval = -1;
 			goto cleanup;
 		}
-		if(info->depends) {
-			fputs("%DEPENDS%\n", fp);
-			for(lp = info->depends; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(local && info->requiredby) {
-			fputs("%REQUIREDBY%\n", fp);
-			for(lp = info->requiredby; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(info->conflicts) {
-			fputs("%CONFLICTS%\n", fp);
-			for(lp = info->conflicts; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(info->provides) {
-			fputs("%PROVIDES%\n", fp);
-			for(lp = info->provides; lp; lp = lp->next) {
-				fprintf(fp, "%s\n", (char *)lp->data);
-			}
-			fprintf(fp, "\n");
-		}
-		if(!local) {
-			if(info->replaces) {
-				fputs("%REPLACES%\n", fp);
-				for(lp = info->replaces; lp; lp = lp->next) {
-					fprintf(fp, "%s\n", (char *)lp->data);
-				}
-				fprintf(fp, "\n");
-			}
-			if(info->force) {
-				fprintf(fp, "%%FORCE%%\n"
-					"\n");
-			}
-			if(info->stick) {
-				fprintf(fp, "%%STICK%%\n"
-					"\n");
-			}
-		}
-		fclose(fp);
+		_pacman_db_write_depends(db, info, fp);
+		_pacman_journal_fclose(db, fp);
 		fp = NULL;
 	}
 
+	if(combined && !handle->combineddb) {
+		snprintf(path, PATH_MAX, "%s/%s-%s/" PM_DB_META, db->path, info->name, info->version);
+		_pacman_journal_unlink(db, path);
+	}
+
 	/* INSTALL */
 	/* nothing needed here (script is automatically extracted) */
 
@@ -818,7 +1556,12 @@ cleanup:
 	umask(oldmask);
 
 	if(fp) {
-		fclose(fp);
+		_pacman_journal_fclose(db, fp);
+	}
+	/* journaled writes are logged once they are applied */
+	if(local && (db->journal == NULL || db->journal->fd == -1)) {
+		snprintf(path, PATH_MAX, "%s-%s", info->name, info->version);
+		_pacman_dbchanges_log(db, path);
 	}
 
 	return(retval);
@@ -827,14 +1570,33 @@ cleanup:
 int _pacman_db_remove(pmdb_t *db, pmpkg_t *info)
 {
 	char path[PATH_MAX];
+	int ret;
 
 	if(db == NULL || info == NULL) {
 		RET_ERR(PM_ERR_DB_NULL, -1);
 	}
 
-	snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
-	if(_pacman_rmrf(path) == -1) {
-		return(-1);
+	if(islocal(db)) {
+		_pacman_packdb_invalidate(db, info->name, info->version);
+		_pacman_dbindex_load(db);
+	}
+
+	if(!islocal(db)) {
+		snprintf(path, PATH_MAX, "%s/%s-%s", db->path, info->name, info->version);
+		_pacman_rmrf(path);
+		return(0);
+	}
+	/* with a running transaction, it is removed when the journal is applied */
+	snprintf(path, PATH_MAX, "%s-%s", info->name, info->version);
+	if((ret = _pacman_journal_remove(db, path)) == -1) {
+		RET_ERR(PM_ERR_DB_REMOVE, -1);
+	}
+	if(ret == 0) {
+		_pacman_dbindex_remove(db, path);
+		/* journaled removals are logged once they are applied */
+		if(db->journal == NULL || db->journal->fd == -1) {
+			_pacman_dbchanges_log(db, path);
+		}
 	}
 
 	return(0);
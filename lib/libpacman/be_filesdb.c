@@ -0,0 +1,486 @@
+/*
+ *  be_filesdb.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The files database of a repository tells which of its packages ships a
+ * given file, without downloading any of them.  The server publishes it as
+ * <treename>.files.fdb, an archive laid out like the .fdb, but holding a
+ * single "files" member per package (in the FILES or CFILES form of the
+ * local database).  With FilesDB, pacman_db_update() fetches it next to the
+ * .fdb, and converts it to <treename>.files: the paths of every package,
+ * directories left out, sorted and mapped read-only, so that the owners of
+ * a path are found with a binary search.  Consecutive paths share the
+ * string of their directory, which is most of their length.
+ *
+ * The index is stamped with the mtime of the archive on the server, which
+ * is what the next update compares with; the archive itself is not kept.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+#include <archive.h>
+#include <archive_entry.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "package.h"
+#include "filelist.h"
+#include "db.h"
+#include "server.h"
+#include "handle.h"
+#include "pacman.h"
+#include "be_filesdb.h"
+#include "readahead.h"
+
+/* a path of the index being built, its offsets relative to the blobs */
+typedef struct __pmfilessrc_t {
+	const char *path;
+	uint32_t off;
+	uint32_t pkg;
+} pmfilessrc_t;
+
+typedef struct __pmfilesbuf_t {
+	char *data;
+	size_t len;
+	size_t size;
+} pmfilesbuf_t;
+
+static int filesdb_srccmp(const void *p1, const void *p2)
+{
+	const pmfilessrc_t *s1 = p1, *s2 = p2;
+	int ret = strcmp(s1->path, s2->path);
+
+	if(ret == 0) {
+		ret = (s1->pkg > s2->pkg) - (s1->pkg < s2->pkg);
+	}
+	return(ret);
+}
+
+static int filesdb_addblob(pmfilesbuf_t *buf, const void *data, size_t len, uint32_t *off)
+{
+	if(buf->len+len > buf->size) {
+		size_t size = buf->size ? buf->size*2 : 1024*1024;
+		char *ptr;
+		while(size < buf->len+len) {
+			size *= 2;
+		}
+		if((ptr = realloc(buf->data, size)) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		buf->data = ptr;
+		buf->size = size;
+	}
+	memcpy(buf->data+buf->len, data, len);
+	*off = buf->len;
+	buf->len += len;
+	return(0);
+}
+
+/* every offset of the entries and of the packages points inside the
+ * files database, and so does every package index; its last byte is a NUL,
+ * so the strings end inside it too */
+static int filesdb_valid(const pmfilesdb_t *files)
+{
+	const pmfileshdr_t *hdr = (const pmfileshdr_t *)files->map;
+	const pmfilesentry_t *entries = (const pmfilesentry_t *)(files->map+sizeof(pmfileshdr_t));
+	const pmfilespkg_t *pkgs = (const pmfilespkg_t *)(entries+hdr->count);
+	size_t tables = (size_t)hdr->count*sizeof(pmfilesentry_t)+(size_t)hdr->npkgs*sizeof(pmfilespkg_t);
+	unsigned int n;
+
+	if(memcmp(hdr->magic, PM_FILESDB_MAGIC, sizeof(hdr->magic)) ||
+		sizeof(pmfileshdr_t)+tables >= files->size || files->map[files->size-1] != '\0') {
+		return(0);
+	}
+	for(n = 0; n < hdr->count; n++) {
+		if(entries[n].dir >= files->size || entries[n].base >= files->size ||
+			entries[n].pkg >= hdr->npkgs) {
+			return(0);
+		}
+	}
+	for(n = 0; n < hdr->npkgs; n++) {
+		if(pkgs[n].name >= files->size || pkgs[n].version >= files->size) {
+			return(0);
+		}
+	}
+	return(1);
+}
+
+static int filesdb_map(const char *path, pmfilesdb_t *files)
+{
+	struct stat buf;
+	const pmfileshdr_t *hdr;
+	int fd;
+
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(-1);
+	}
+	if(fstat(fd, &buf) == -1 || (size_t)buf.st_size < sizeof(pmfileshdr_t)+1) {
+		close(fd);
+		return(-1);
+	}
+	files->map = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(files->map == MAP_FAILED) {
+		files->map = NULL;
+		return(-1);
+	}
+	files->size = buf.st_size;
+
+	hdr = (const pmfileshdr_t *)files->map;
+	if(!filesdb_valid(files)) {
+		_pacman_log(PM_LOG_WARNING, _("%s is not a valid files database, ignoring"), path);
+		munmap(files->map, files->size);
+		files->map = NULL;
+		return(-1);
+	}
+	files->hdr = hdr;
+	files->entries = (const pmfilesentry_t *)(files->map+sizeof(pmfileshdr_t));
+	files->pkgs = (const pmfilespkg_t *)(files->entries+hdr->count);
+	return(0);
+}
+
+/* maps the files database of a sync db, if it has one */
+pmfilesdb_t *_pacman_filesdb_open(pmdb_t *db)
+{
+	pmfilesdb_t *files;
+	char path[PATH_MAX];
+
+	if(db->files) {
+		return(db->files);
+	}
+	if((files = _pacman_zalloc(sizeof(pmfilesdb_t))) == NULL) {
+		return(NULL);
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_FILESDB, db->path);
+	if(filesdb_map(path, files) == -1) {
+		free(files);
+		return(NULL);
+	}
+	db->files = files;
+	return(files);
+}
+
+void _pacman_filesdb_free(pmfilesdb_t *files)
+{
+	if(files) {
+		if(files->map) {
+			munmap(files->map, files->size);
+		}
+		free(files);
+	}
+}
+
+/* .files.fdb archive -> index */
+static int filesdb_convert(pmdb_t *db, const char *archive, const char *lastupdate)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	pmfilesbuf_t blobs = { NULL, 0, 0 }, strings = { NULL, 0, 0 };
+	pmfilessrc_t *srcs = NULL;
+	pmfilespkg_t *pkgs = NULL;
+	unsigned int count = 0, max = 0, npkgs = 0, maxpkgs = 0, n;
+	struct archive *a;
+	struct archive_entry *ae;
+	char *data = NULL;
+	size_t datasize = 0, base, baseoff = 0;
+	const char *prevdir = NULL;
+	size_t prevdirlen = 0;
+	uint32_t prevdiroff = 0;
+	pmfileshdr_t hdr;
+	FILE *fp = NULL;
+	int fd = -1, r, ret = -1;
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_FILESDB, db->path);
+	snprintf(tmp, PATH_MAX, "%s.XXXXXX", path);
+	if((a = _pacman_archive_open(archive)) == NULL) {
+		return(-1);
+	}
+
+	while((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+		const char *pathname = archive_entry_pathname(ae);
+		const char *slash = strrchr(pathname, '/');
+		char dirname[PATH_MAX], name[PKG_NAME_LEN], version[PKG_VERSION_LEN];
+		pmfilelist_t *filelist;
+		pmfileiter_t iter;
+		const char *str;
+		size_t len = 0;
+
+		if(slash == NULL || slash == pathname || slash-pathname >= PATH_MAX || strcmp(slash+1, "files")) {
+			continue;
+		}
+		memcpy(dirname, pathname, slash-pathname);
+		dirname[slash-pathname] = '\0';
+		if(_pacman_pkg_splitname(dirname, name, version, 0) == -1) {
+			_pacman_log(PM_LOG_ERROR, _("invalid name for dabatase entry '%s'"), dirname);
+			continue;
+		}
+		if(_pacman_archive_read_entry(a, ae, &data, &len, &datasize) == -1) {
+			goto cleanup;
+		}
+		if(npkgs == maxpkgs) {
+			pmfilespkg_t *ptr;
+			maxpkgs = maxpkgs ? maxpkgs*2 : 1024;
+			if((ptr = realloc(pkgs, maxpkgs*sizeof(pmfilespkg_t))) == NULL) {
+				goto cleanup;
+			}
+			pkgs = ptr;
+		}
+		if(filesdb_addblob(&strings, name, strlen(name)+1, &pkgs[npkgs].name) == -1 ||
+			filesdb_addblob(&strings, version, strlen(version)+1, &pkgs[npkgs].version) == -1) {
+			goto cleanup;
+		}
+		filelist = _pacman_db_parse_filelist(data, len);
+		_pacman_filelist_iter(filelist, &iter);
+		while((str = _pacman_filelist_next(&iter))) {
+			size_t pathlen = strlen(str);
+
+			if(pathlen == 0 || str[pathlen-1] == '/') {
+				continue;
+			}
+			if(count == max) {
+				pmfilessrc_t *ptr;
+				max = max ? max*2 : 65536;
+				if((ptr = realloc(srcs, max*sizeof(pmfilessrc_t))) == NULL) {
+					FREEFILELIST(filelist);
+					goto cleanup;
+				}
+				srcs = ptr;
+			}
+			if(filesdb_addblob(&blobs, str, pathlen+1, &srcs[count].off) == -1) {
+				FREEFILELIST(filelist);
+				goto cleanup;
+			}
+			srcs[count++].pkg = npkgs;
+		}
+		FREEFILELIST(filelist);
+		npkgs++;
+	}
+	if(r != ARCHIVE_EOF) {
+		goto cleanup;
+	}
+
+	/* the blobs do not move anymore */
+	for(n = 0; n < count; n++) {
+		srcs[n].path = blobs.data+srcs[n].off;
+	}
+	if(count) {
+		qsort(srcs, count, sizeof(pmfilessrc_t), filesdb_srccmp);
+	}
+	/* the paths go to the strings now, split at their last slash */
+	for(n = 0; n < count; n++) {
+		const char *slash = strrchr(srcs[n].path, '/');
+		size_t dirlen = slash ? (size_t)(slash-srcs[n].path)+1 : 0;
+
+		if(prevdir == NULL || dirlen != prevdirlen || strncmp(prevdir, srcs[n].path, dirlen)) {
+			char dir[PATH_MAX];
+
+			memcpy(dir, srcs[n].path, dirlen);
+			dir[dirlen] = '\0';
+			if(filesdb_addblob(&strings, dir, dirlen+1, &prevdiroff) == -1) {
+				goto cleanup;
+			}
+			prevdir = srcs[n].path;
+			prevdirlen = dirlen;
+		}
+		/* the path is not needed anymore, its offset is reused for the
+		 * directory */
+		srcs[n].off = prevdiroff;
+	}
+	base = sizeof(hdr)+(size_t)count*sizeof(pmfilesentry_t)+(size_t)npkgs*sizeof(pmfilespkg_t);
+
+	if((fd = mkstemp(tmp)) == -1) {
+		goto cleanup;
+	}
+	if(fchmod(fd, 0644) == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		goto cleanup;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PM_FILESDB_MAGIC, sizeof(hdr.magic));
+	hdr.count = count;
+	hdr.npkgs = npkgs;
+	STRNCPY(hdr.lastupdate, lastupdate, sizeof(hdr.lastupdate));
+	if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		goto cleanup;
+	}
+	/* the bases follow the strings written so far */
+	for(n = 0; n < count; n++) {
+		pmfilesentry_t entry;
+		const char *slash = strrchr(srcs[n].path, '/');
+		size_t baselen = strlen(slash ? slash+1 : srcs[n].path)+1;
+
+		entry.dir = base+srcs[n].off;
+		entry.base = base+strings.len+baseoff;
+		entry.pkg = srcs[n].pkg;
+		if(base+strings.len+baseoff+baselen > UINT32_MAX) {
+			goto cleanup;
+		}
+		baseoff += baselen;
+		if(fwrite(&entry, sizeof(entry), 1, fp) != 1) {
+			goto cleanup;
+		}
+	}
+	for(n = 0; n < npkgs; n++) {
+		pmfilespkg_t pkg = pkgs[n];
+
+		pkg.name += base;
+		pkg.version += base;
+		if(fwrite(&pkg, sizeof(pkg), 1, fp) != 1) {
+			goto cleanup;
+		}
+	}
+	if(strings.len && fwrite(strings.data, 1, strings.len, fp) != strings.len) {
+		goto cleanup;
+	}
+	for(n = 0; n < count; n++) {
+		const char *slash = strrchr(srcs[n].path, '/');
+		const char *str = slash ? slash+1 : srcs[n].path;
+
+		if(fwrite(str, 1, strlen(str)+1, fp) != strlen(str)+1) {
+			goto cleanup;
+		}
+	}
+	if(fflush(fp) != 0 || fsync(fileno(fp)) == -1) {
+		goto cleanup;
+	}
+	fclose(fp);
+	fp = NULL;
+	/* the old mapping stays valid, but it would not be looked at again */
+	FREEFILESDB(db->files);
+	if(rename(tmp, path) == -1) {
+		goto cleanup;
+	}
+	_pacman_log(PM_LOG_DEBUG, _("wrote files database %s (%d paths in %d packages)"), path, count, npkgs);
+	ret = 0;
+
+cleanup:
+	if(ret == -1) {
+		_pacman_log(PM_LOG_WARNING, _("could not write files database %s (%s)"), path, strerror(errno));
+		if(fp) {
+			fclose(fp);
+		}
+		if(fd != -1) {
+			unlink(tmp);
+		}
+	}
+	archive_read_finish(a);
+	free(data);
+	free(srcs);
+	free(pkgs);
+	free(blobs.data);
+	free(strings.data);
+	return(ret);
+}
+
+/* fetches the files database of a sync db, the caller holds the lock
+ * Returns 0 if it got updated, 1 if it was up to date, -1 on error.
+ */
+int _pacman_filesdb_update(pmdb_t *db, int force)
+{
+	char path[PATH_MAX], archive[PATH_MAX];
+	char lastupdate[16] = "", newmtime[16] = "";
+	pmfilesdb_t *files;
+	pmlist_t *list;
+	int ret;
+
+	if(!force && (files = _pacman_filesdb_open(db)) != NULL) {
+		STRNCPY(lastupdate, files->hdr->lastupdate, sizeof(lastupdate));
+	}
+	snprintf(path, PATH_MAX, "%s%s", handle->root, handle->dbpath);
+	snprintf(archive, PATH_MAX, "%s" PM_EXT_FILESDB PM_EXT_DB, db->path);
+	list = _pacman_list_add(NULL, strdup(archive+strlen(path)+1));
+	ret = _pacman_downloadfiles_forreal(db->servers, path, list, lastupdate, newmtime, 0);
+	FREELIST(list);
+	if(ret == 0) {
+		ret = filesdb_convert(db, archive, newmtime);
+		unlink(archive);
+	}
+	return(ret);
+}
+
+/* compares a path with an entry, as if the entry was a single string */
+static int filesdb_cmp(const pmfilesdb_t *files, const pmfilesentry_t *entry, const char *path)
+{
+	const char *dir = files->map+entry->dir;
+	size_t len = strlen(dir);
+	int ret = strncmp(dir, path, len);
+
+	return(ret ? ret : strcmp(files->map+entry->base, path+len));
+}
+
+/* the packages of the sync db shipping a file, as "name version" strings
+ * They come from the index alone, so that looking an owner up does not load
+ * the package cache of the db.
+ */
+pmlist_t *_pacman_filesdb_owners(pmdb_t *db, const char *path)
+{
+	pmfilesdb_t *files;
+	unsigned int lo = 0, hi, i;
+	pmlist_t *ret = NULL;
+
+	if((files = _pacman_filesdb_open(db)) == NULL) {
+		RET_ERR(PM_ERR_DB_OPEN, NULL);
+	}
+	/* the paths of the db are relative to the root */
+	while(*path == '/') {
+		path++;
+	}
+
+	/* the first entry not less than the path */
+	hi = files->hdr->count;
+	while(lo < hi) {
+		unsigned int mid = lo+(hi-lo)/2;
+		if(filesdb_cmp(files, &files->entries[mid], path) < 0) {
+			lo = mid+1;
+		} else {
+			hi = mid;
+		}
+	}
+	for(i = lo; i < files->hdr->count && filesdb_cmp(files, &files->entries[i], path) == 0; i++) {
+		const pmfilespkg_t *owner;
+		char name[PKG_FULLNAME_LEN];
+
+		if(files->entries[i].pkg >= files->hdr->npkgs) {
+			continue;
+		}
+		owner = &files->pkgs[files->entries[i].pkg];
+		snprintf(name, PKG_FULLNAME_LEN, "%s %s", files->map+owner->name, files->map+owner->version);
+		if(!_pacman_list_is_strin(name, ret)) {
+			ret = _pacman_list_add(ret, strdup(name));
+		}
+	}
+	if(ret == NULL) {
+		RET_ERR(PM_ERR_NO_OWNER, NULL);
+	}
+	return(ret);
+}
+
+/* vim: set ts=2 sw=2 noet: */
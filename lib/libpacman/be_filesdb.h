@@ -0,0 +1,72 @@
+/*
+ *  be_filesdb.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_FILESDB_H
+#define _PACMAN_BE_FILESDB_H
+
+#include <stdint.h>
+
+#include "list.h"
+#include "db.h"
+
+/* <treename>.files.fdb on the server, <treename>.files once indexed */
+#define PM_EXT_FILESDB ".files"
+#define PM_FILESDB_MAGIC "PMFILE01"
+
+/* On-disk layout: header, entry table (sorted by path), package table and
+ * the strings they point to.  Every offset is relative to the start of the
+ * file, so the whole thing can be used straight from the mapping.
+ */
+typedef struct __pmfileshdr_t {
+	char magic[8];
+	uint32_t count; /* number of paths */
+	uint32_t npkgs;
+	char lastupdate[16]; /* mtime of the archive on the server */
+} pmfileshdr_t;
+
+typedef struct __pmfilesentry_t {
+	uint32_t dir;  /* "usr/bin/", shared by the entries next to each other */
+	uint32_t base; /* "foo" */
+	uint32_t pkg;  /* index in the package table */
+} pmfilesentry_t;
+
+typedef struct __pmfilespkg_t {
+	uint32_t name;
+	uint32_t version;
+} pmfilespkg_t;
+
+typedef struct __pmfilesdb_t {
+	char *map;
+	size_t size;
+	const pmfileshdr_t *hdr;
+	const pmfilesentry_t *entries;
+	const pmfilespkg_t *pkgs;
+} pmfilesdb_t;
+
+#define FREEFILESDB(p) do { if(p) { _pacman_filesdb_free(p); p = NULL; } } while(0)
+
+pmfilesdb_t *_pacman_filesdb_open(pmdb_t *db);
+void _pacman_filesdb_free(pmfilesdb_t *files);
+int _pacman_filesdb_update(pmdb_t *db, int force);
+pmlist_t *_pacman_filesdb_owners(pmdb_t *db, const char *path);
+
+#endif /* _PACMAN_BE_FILESDB_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,365 @@
+/*
+ *  be_index.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The name index of the local db is a small log next to the local
+ * directory (local.index), made of the following records:
+ *
+ *   +<dirname>     the entry was added
+ *   -<dirname>     the entry was removed
+ *   =<sec> <nsec>  the mtime of the directory after the records above
+ *
+ * _pacman_db_write() and _pacman_db_remove() append to it, so keeping it
+ * up to date is a single write.  The index is only trusted if its last
+ * stamp matches the directory, otherwise it is rebuilt from a readdir().
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "package.h"
+#include "db.h"
+#include "be_index.h"
+
+/* rewrite the index once it has this many superfluous records */
+#define INDEX_SLACK 64
+
+static int index_cmp(const char *name1, const char *dirname1, const pmdbindex_entry_t *entry)
+{
+	int ret = strcmp(name1, entry->name);
+
+	return(ret ? ret : strcmp(dirname1, entry->dirname));
+}
+
+/* position of the first entry not lower than name/dirname */
+static unsigned int index_lookup(pmdbindex_t *index, const char *name, const char *dirname)
+{
+	unsigned int lo = 0, hi = index->count;
+
+	while(lo < hi) {
+		unsigned int mid = lo+(hi-lo)/2;
+		int cmp;
+		if(dirname) {
+			cmp = index_cmp(name, dirname, &index->entries[mid]);
+		} else {
+			cmp = strcmp(name, index->entries[mid].name);
+		}
+		if(cmp > 0) {
+			lo = mid+1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(lo);
+}
+
+/* Returns 0 if dirname is in the index, 1 if it is not the name of an
+ * entry, -1 if it could not be added (the index is incomplete then). */
+static int index_insert(pmdbindex_t *index, const char *dirname)
+{
+	char name[PKG_NAME_LEN], *dupname, *dupdir;
+	unsigned int pos;
+
+	if(_pacman_pkg_splitname((char *)dirname, name, NULL, 0) == -1) {
+		return(1);
+	}
+	pos = index_lookup(index, name, dirname);
+	if(pos < index->count && !index_cmp(name, dirname, &index->entries[pos])) {
+		return(0);
+	}
+	if(index->count == index->alloc) {
+		unsigned int alloc = index->alloc ? index->alloc*2 : 256;
+		pmdbindex_entry_t *entries = realloc(index->entries, alloc*sizeof(pmdbindex_entry_t));
+		if(entries == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		index->entries = entries;
+		index->alloc = alloc;
+	}
+	dupname = strdup(name);
+	dupdir = strdup(dirname);
+	if(dupname == NULL || dupdir == NULL) {
+		free(dupname);
+		free(dupdir);
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+	memmove(&index->entries[pos+1], &index->entries[pos], (index->count-pos)*sizeof(pmdbindex_entry_t));
+	index->entries[pos].name = dupname;
+	index->entries[pos].dirname = dupdir;
+	index->count++;
+	return(0);
+}
+
+static void index_delete(pmdbindex_t *index, const char *dirname)
+{
+	char name[PKG_NAME_LEN];
+	unsigned int pos;
+
+	if(_pacman_pkg_splitname((char *)dirname, name, NULL, 0) == -1) {
+		return;
+	}
+	pos = index_lookup(index, name, dirname);
+	if(pos >= index->count || index_cmp(name, dirname, &index->entries[pos])) {
+		return;
+	}
+	free(index->entries[pos].name);
+	free(index->entries[pos].dirname);
+	index->count--;
+	memmove(&index->entries[pos], &index->entries[pos+1], (index->count-pos)*sizeof(pmdbindex_entry_t));
+}
+
+static void index_clear(pmdbindex_t *index)
+{
+	unsigned int i;
+
+	for(i = 0; i < index->count; i++) {
+		free(index->entries[i].name);
+		free(index->entries[i].dirname);
+	}
+	index->count = 0;
+	index->records = 0;
+}
+
+static int index_stamp(pmdb_t *db, char *stamp, size_t size)
+{
+	struct stat buf;
+
+	if(stat(db->path, &buf) == -1) {
+		return(-1);
+	}
+	snprintf(stamp, size, "=%ld %ld\n", (long)buf.st_mtim.tv_sec, (long)buf.st_mtim.tv_nsec);
+	return(0);
+}
+
+/* replay the index file; returns 0 if it is usable */
+static int index_parse(pmdb_t *db, pmdbindex_t *index)
+{
+	char path[PATH_MAX], line[PATH_MAX], stamp[64] = "", last[64] = "";
+	FILE *fp;
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_INDEX, db->path);
+	if((fp = fopen(path, "r")) == NULL) {
+		return(-1);
+	}
+	while(fgets(line, sizeof(line), fp)) {
+		size_t len = strlen(line);
+		if(len == 0 || line[len-1] != '\n') {
+			/* torn write */
+			last[0] = '\0';
+			break;
+		}
+		index->records++;
+		if(line[0] == '=') {
+			STRNCPY(last, line, sizeof(last));
+			continue;
+		}
+		last[0] = '\0';
+		line[len-1] = '\0';
+		if(line[0] == '+') {
+			if(index_insert(index, line+1) == -1) {
+				/* missing an entry, it can not be trusted */
+				fclose(fp);
+				return(-1);
+			}
+		} else if(line[0] == '-') {
+			index_delete(index, line+1);
+		} else {
+			break;
+		}
+	}
+	fclose(fp);
+
+	if(index_stamp(db, stamp, sizeof(stamp)) == -1 || strcmp(stamp, last)) {
+		return(-1);
+	}
+	return(0);
+}
+
+/* write the whole index from scratch */
+static int index_save(pmdb_t *db, pmdbindex_t *index)
+{
+	char path[PATH_MAX], tmp[PATH_MAX], stamp[64];
+	unsigned int i;
+	FILE *fp;
+
+	if(index_stamp(db, stamp, sizeof(stamp)) == -1) {
+		return(-1);
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_INDEX, db->path);
+	snprintf(tmp, PATH_MAX, "%s.tmp", path);
+	if((fp = fopen(tmp, "w")) == NULL) {
+		index->readonly = 1;
+		return(-1);
+	}
+	for(i = 0; i < index->count; i++) {
+		fprintf(fp, "+%s\n", index->entries[i].dirname);
+	}
+	fputs(stamp, fp);
+	if(fclose(fp) != 0 || rename(tmp, path) == -1) {
+		unlink(tmp);
+		index->readonly = 1;
+		return(-1);
+	}
+	index->records = index->count+1;
+	return(0);
+}
+
+static int index_rebuild(pmdb_t *db, pmdbindex_t *index)
+{
+	struct dirent *ent;
+	DIR *dir;
+
+	_pacman_log(PM_LOG_DEBUG, _("rebuilding the name index of '%s'"), db->treename);
+	index_clear(index);
+	if((dir = opendir(db->path)) == NULL) {
+		return(-1);
+	}
+	while((ent = _pacman_readdir_subdir(dir)) != NULL) {
+		if(index_insert(index, ent->d_name) == -1) {
+			/* never save a partial index, it would be trusted */
+			closedir(dir);
+			index_clear(index);
+			return(-1);
+		}
+	}
+	closedir(dir);
+	index_save(db, index);
+	return(0);
+}
+
+/* append a record and the new stamp to the index file */
+static void index_append(pmdb_t *db, pmdbindex_t *index, char op, const char *dirname)
+{
+	char path[PATH_MAX], rec[PATH_MAX+64], stamp[64];
+	int fd, len;
+
+	if(index->readonly) {
+		return;
+	}
+	if(index->records > 2*index->count+INDEX_SLACK) {
+		index_save(db, index);
+		return;
+	}
+	if(index_stamp(db, stamp, sizeof(stamp)) == -1) {
+		return;
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_INDEX, db->path);
+	len = snprintf(rec, sizeof(rec), "%c%s\n%s", op, dirname, stamp);
+	if((fd = open(path, O_WRONLY|O_APPEND)) == -1) {
+		index_save(db, index);
+		return;
+	}
+	if(write(fd, rec, len) != len) {
+		/* the stamp will not match, so the index gets rebuilt next time */
+		_pacman_log(PM_LOG_DEBUG, "%s (%s)", path, strerror(errno));
+	}
+	close(fd);
+	index->records += 2;
+}
+
+int _pacman_dbindex_load(pmdb_t *db)
+{
+	pmdbindex_t *index;
+
+	if(db->index) {
+		return(0);
+	}
+	if((index = _pacman_zalloc(sizeof(pmdbindex_t))) == NULL) {
+		return(-1);
+	}
+	if(index_parse(db, index) == -1 && index_rebuild(db, index) == -1) {
+		_pacman_dbindex_free(index);
+		return(-1);
+	}
+	db->index = index;
+	return(0);
+}
+
+void _pacman_dbindex_free(pmdbindex_t *index)
+{
+	if(index == NULL) {
+		return;
+	}
+	index_clear(index);
+	free(index->entries);
+	free(index);
+}
+
+/* look up the directory of package 'name'
+ * Returns 1 if found, 0 if not, -1 if the index is not available.
+ */
+int _pacman_dbindex_find(pmdb_t *db, const char *name, char *dirname, size_t size)
+{
+	unsigned int pos;
+
+	if(_pacman_dbindex_load(db) == -1) {
+		return(-1);
+	}
+	pos = index_lookup(db->index, name, NULL);
+	if(pos >= db->index->count || strcmp(db->index->entries[pos].name, name)) {
+		return(0);
+	}
+	STRNCPY(dirname, db->index->entries[pos].dirname, size);
+	return(1);
+}
+
+/* called after the directory of an entry has been created */
+void _pacman_dbindex_add(pmdb_t *db, const char *dirname)
+{
+	if(db->index == NULL) {
+		/* a rebuild picks up the new entry */
+		_pacman_dbindex_load(db);
+		return;
+	}
+	if(index_insert(db->index, dirname) == -1) {
+		/* without the record, the stamp will not match the directory
+		 * anymore, so the next load rebuilds it */
+		FREEDBINDEX(db->index);
+		return;
+	}
+	index_append(db, db->index, '+', dirname);
+}
+
+/* called after the directory of an entry has been removed */
+void _pacman_dbindex_remove(pmdb_t *db, const char *dirname)
+{
+	if(db->index == NULL) {
+		_pacman_dbindex_load(db);
+		return;
+	}
+	index_delete(db->index, dirname);
+	index_append(db, db->index, '-', dirname);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,52 @@
+/*
+ *  be_index.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_INDEX_H
+#define _PACMAN_BE_INDEX_H
+
+#include "db.h"
+
+#define PM_EXT_INDEX ".index"
+
+/* Name -> directory index of the local db */
+typedef struct __pmdbindex_entry_t {
+	char *name;
+	char *dirname;
+} pmdbindex_entry_t;
+
+typedef struct __pmdbindex_t {
+	pmdbindex_entry_t *entries; /* sorted by name */
+	unsigned int count;
+	unsigned int alloc;
+	unsigned int records; /* number of records in the index file */
+	int readonly;         /* could not be written, only kept in memory */
+} pmdbindex_t;
+
+#define FREEDBINDEX(p) do { if(p) { _pacman_dbindex_free(p); p = NULL; } } while(0)
+
+int _pacman_dbindex_load(pmdb_t *db);
+void _pacman_dbindex_free(pmdbindex_t *index);
+int _pacman_dbindex_find(pmdb_t *db, const char *name, char *dirname, size_t size);
+void _pacman_dbindex_add(pmdb_t *db, const char *dirname);
+void _pacman_dbindex_remove(pmdb_t *db, const char *dirname);
+
+#endif /* _PACMAN_BE_INDEX_H */
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,659 @@
+/*
+ *  be_journal.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* Write-ahead journal of the local db.
+ *
+ * While a transaction is committed, the files _pacman_db_write() produces
+ * and the entries _pacman_db_remove() drops are not changed in place: they
+ * are appended to the journal (local.journal, next to the local directory)
+ * and kept in memory, where _pacman_db_read() finds them.  A file rewritten
+ * several times (like the depends file of a package many others require) is
+ * only kept once.  Once the transaction is done, a commit record is appended,
+ * the journal is synced, the changes are applied in place, the filesystem is
+ * synced and the journal is removed.  So the entries others see are either
+ * the ones from before the transaction or the ones from after it, and the
+ * whole transaction costs two syncs.
+ *
+ * Records are a "<op> <length> <checksum> <path>\n" header followed by
+ * <length> bytes of data; op is W (write a file), D (delete a file), R
+ * (remove an entry) or C (commit).
+ * If we crash after the commit record has been synced, the next one opening
+ * the db replays the journal.  Without the commit record nothing was written
+ * in place yet, and the journal is dropped.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "package.h"
+#include "db.h"
+#include "pacman.h"
+#include "handle.h"
+#include "be_packed.h"
+#include "be_changes.h"
+#include "be_journal.h"
+
+static uint32_t journal_checksum(const char *path, const char *data, size_t len)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for(i = 0; path[i]; i++) {
+		hash = (hash ^ (unsigned char)path[i]) * 16777619U;
+	}
+	for(i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char)data[i]) * 16777619U;
+	}
+	return(hash);
+}
+
+static void journal_file_free(void *data)
+{
+	pmjournal_file_t *file = data;
+
+	if(file == NULL) {
+		return;
+	}
+	free(file->path);
+	free(file->data);
+	free(file);
+}
+
+static int journal_file_cmp(const void *file1, const void *file2)
+{
+	return(file1 != file2);
+}
+
+static pmjournal_file_t *journal_pending(pmjournal_t *journal, const char *path)
+{
+	pmlist_t *i;
+
+	for(i = journal->pending; i; i = i->next) {
+		pmjournal_file_t *file = i->data;
+		if(!file->entry && !strcmp(file->path, path)) {
+			return(file);
+		}
+	}
+	return(NULL);
+}
+
+/* whether the entry a file of the db belongs to is to be removed */
+static int journal_removed(pmjournal_t *journal, const char *path)
+{
+	const char *slash = strchr(path, '/');
+	size_t len = slash ? (size_t)(slash-path) : strlen(path);
+	pmlist_t *i;
+
+	for(i = journal->pending; i; i = i->next) {
+		pmjournal_file_t *file = i->data;
+		if(file->entry && strlen(file->path) == len && !strncmp(file->path, path, len)) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/* record the latest content of a file, taking over data */
+static int journal_set(pmjournal_t *journal, const char *path, char *data, size_t len)
+{
+	pmjournal_file_t *file;
+
+	if((file = journal_pending(journal, path)) == NULL) {
+		if((file = _pacman_zalloc(sizeof(pmjournal_file_t))) == NULL) {
+			free(data);
+			return(-1);
+		}
+		if((file->path = strdup(path)) == NULL) {
+			free(file);
+			free(data);
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		journal->pending = _pacman_list_add(journal->pending, file);
+	}
+	free(file->data);
+	file->data = data;
+	file->len = len;
+	return(0);
+}
+
+static int journal_log(pmjournal_t *journal, char op, const char *path, const char *data, size_t len)
+{
+	char header[PATH_MAX+64];
+	struct iovec iov[2];
+	ssize_t total;
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = snprintf(header, sizeof(header), "%c %lu %08x %s\n", op,
+		(unsigned long)len, journal_checksum(path, data, len), path);
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+	total = iov[0].iov_len+len;
+	if(writev(journal->fd, iov, 2) != total) {
+		_pacman_log(PM_LOG_ERROR, _("could not write the journal (%s)"), strerror(errno));
+		return(-1);
+	}
+	return(0);
+}
+
+/* add the entry a path of the db belongs to, if it is not there yet */
+static pmlist_t *journal_entry(pmlist_t *entries, const char *path)
+{
+	char entry[PATH_MAX], *ptr;
+
+	STRNCPY(entry, path, PATH_MAX);
+	if((ptr = strchr(entry, '/'))) {
+		*ptr = '\0';
+	}
+	if(!_pacman_list_is_strin(entry, entries)) {
+		entries = _pacman_list_add(entries, strdup(entry));
+	}
+	return(entries);
+}
+
+/* write the content of a file in place (or remove it if data is NULL) */
+static int journal_apply(pmdb_t *db, const char *path, const char *data, size_t len)
+{
+	char dir[PATH_MAX], *ptr;
+	size_t done = 0;
+	int fd;
+
+	if(data == NULL) {
+		if(unlinkat(dirfd(db->handle), path, 0) == -1 && errno != ENOENT) {
+			_pacman_log(PM_LOG_ERROR, _("db_write: could not remove file %s/%s"), db->treename, path);
+			return(-1);
+		}
+		return(0);
+	}
+	STRNCPY(dir, path, PATH_MAX);
+	if((ptr = strchr(dir, '/'))) {
+		*ptr = '\0';
+		mkdirat(dirfd(db->handle), dir, 0755);
+	}
+	if((fd = openat(dirfd(db->handle), path, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1) {
+		_pacman_log(PM_LOG_ERROR, _("db_write: could not open file %s/%s"), db->treename, path);
+		return(-1);
+	}
+	while(done < len) {
+		ssize_t n = write(fd, data+done, len-done);
+		if(n <= 0) {
+			_pacman_log(PM_LOG_ERROR, _("db_write: could not write file %s/%s"), db->treename, path);
+			close(fd);
+			return(-1);
+		}
+		done += n;
+	}
+	close(fd);
+	return(0);
+}
+
+static int journal_sync(pmdb_t *db)
+{
+#ifdef __linux__
+	if(syncfs(dirfd(db->handle)) == -1) {
+		_pacman_log(PM_LOG_ERROR, _("could not sync the database '%s' (%s)"), db->treename, strerror(errno));
+		return(-1);
+	}
+#else
+	sync();
+#endif
+	return(0);
+}
+
+void _pacman_journal_free(pmjournal_t *journal)
+{
+	if(journal == NULL) {
+		return;
+	}
+	if(journal->fd != -1) {
+		close(journal->fd);
+	}
+	_FREELIST(journal->pending, journal_file_free);
+	free(journal);
+}
+
+/* start logging the writes of the local db */
+int _pacman_journal_begin(pmdb_t *db)
+{
+	pmjournal_t *journal;
+	char path[PATH_MAX];
+
+	if(db == NULL) {
+		return(0);
+	}
+	if(db->journal == NULL) {
+		if((journal = _pacman_zalloc(sizeof(pmjournal_t))) == NULL) {
+			return(-1);
+		}
+		journal->fd = -1;
+		db->journal = journal;
+	}
+	journal = db->journal;
+	if(journal->depth++ > 0) {
+		return(0);
+	}
+
+	/* a previous group could not be applied, do not overwrite it */
+	if(_pacman_journal_replay(db) == -1) {
+		journal->depth = 0;
+		RET_ERR(PM_ERR_DB_WRITE, -1);
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_JOURNAL, db->path);
+	if((journal->fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0644)) == -1) {
+		_pacman_log(PM_LOG_ERROR, _("could not open the journal %s (%s)"), path, strerror(errno));
+		journal->depth = 0;
+		RET_ERR(PM_ERR_DB_WRITE, -1);
+	}
+	return(0);
+}
+
+/* group commit: make the journal durable, then apply it
+ * If the journal can not be synced, nothing is applied and the journal is
+ * kept: the next one opening the db replays it if its commit record made it
+ * to the disk.
+ */
+int _pacman_journal_commit(pmdb_t *db)
+{
+	pmjournal_t *journal;
+	char path[PATH_MAX];
+	pmlist_t *i, *entries = NULL;
+	int ret = 0, count = 0;
+
+	if(db == NULL || (journal = db->journal) == NULL || journal->depth == 0) {
+		return(0);
+	}
+	if(--journal->depth > 0 || journal->fd == -1) {
+		return(0);
+	}
+
+	if(journal_log(journal, 'C', ".", "", 0) == -1 || fsync(journal->fd) == -1) {
+		_pacman_log(PM_LOG_ERROR, _("could not sync the journal of '%s' (%s), the database is left as it was"),
+			db->treename, strerror(errno));
+		close(journal->fd);
+		journal->fd = -1;
+		_FREELIST(journal->pending, journal_file_free);
+		RET_ERR(PM_ERR_DB_WRITE, -1);
+	}
+	close(journal->fd);
+	journal->fd = -1;
+
+	for(i = journal->pending; i; i = i->next) {
+		pmjournal_file_t *file = i->data;
+		if(file->entry) {
+			char entry[PATH_MAX];
+			snprintf(entry, PATH_MAX, "%s/%s", db->path, file->path);
+			if(_pacman_rmrf(entry)) {
+				_pacman_log(PM_LOG_ERROR, _("db_remove: could not remove entry %s/%s"), db->treename, file->path);
+				ret = -1;
+			}
+		} else if(journal_apply(db, file->path, file->data, file->len) == -1) {
+			ret = -1;
+		}
+		entries = journal_entry(entries, file->path);
+		count++;
+	}
+	_FREELIST(journal->pending, journal_file_free);
+	if(journal_sync(db) == -1) {
+		ret = -1;
+	}
+	_pacman_dbchanges_logall(db, entries);
+	FREELIST(entries);
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_JOURNAL, db->path);
+	if(ret == 0) {
+		unlink(path);
+	}
+	_pacman_log(PM_LOG_DEBUG, _("journal: applied %d change(s) to '%s'"), count, db->treename);
+	if(ret == -1) {
+		/* the journal is kept, to be replayed */
+		RET_ERR(PM_ERR_DB_WRITE, -1);
+	}
+	return(0);
+}
+
+/* the next record of the journal, NULL if it is torn */
+static char *journal_record(char *ptr, char *end, char *op, char *file, unsigned long *len)
+{
+	unsigned int sum;
+	char *nl = memchr(ptr, '\n', end-ptr);
+
+	if(nl == NULL || sscanf(ptr, "%c %lu %x %4095s", op, len, &sum, file) != 4 ||
+		*len > (size_t)(end-nl-1) || journal_checksum(file, nl+1, *len) != sum) {
+		return(NULL);
+	}
+	return(nl+1);
+}
+
+/* read the journal of the db
+ * Returns the length of its committed part (0 if it has none), or -1 if
+ * there is no journal.
+ */
+static ssize_t journal_read(const char *path, char **data)
+{
+	char *ptr, *end, *next, op, file[PATH_MAX];
+	unsigned long len;
+	struct stat buf;
+	size_t done = 0, committed = 0;
+	ssize_t n;
+	int fd;
+
+	*data = NULL;
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(-1);
+	}
+	if(fstat(fd, &buf) == -1 || (*data = _pacman_malloc(buf.st_size+1)) == NULL) {
+		/* keep it for a next try */
+		close(fd);
+		return(-1);
+	}
+	while(done < (size_t)buf.st_size && (n = read(fd, *data+done, buf.st_size-done)) > 0) {
+		done += n;
+	}
+	close(fd);
+	(*data)[done] = '\0';
+
+	for(ptr = *data, end = *data+done; ptr < end; ptr = next+len) {
+		if((next = journal_record(ptr, end, &op, file, &len)) == NULL) {
+			break;
+		}
+		if(op == 'C') {
+			committed = next+len-*data;
+		}
+	}
+	return(committed);
+}
+
+/* apply the committed part of the journal
+ * Returns the number of records applied, or -1 if they could not be synced.
+ */
+static int journal_replay(pmdb_t *db, char *data, size_t size)
+{
+	char *ptr, *end = data+size;
+	pmlist_t *entries = NULL;
+	unsigned long len;
+	int count = 0;
+
+	_pacman_log(PM_LOG_WARNING, _("replaying the journal of '%s'"), db->treename);
+	for(ptr = data; ptr < end; ptr += len) {
+		char op, file[PATH_MAX], name[PKG_NAME_LEN], version[PKG_VERSION_LEN], *slash;
+
+		if((ptr = journal_record(ptr, end, &op, file, &len)) == NULL) {
+			break;
+		}
+		if(op == 'C') {
+			continue;
+		}
+		STRNCPY(name, file, PKG_NAME_LEN);
+		if((slash = strchr(name, '/'))) {
+			*slash = '\0';
+		}
+		if(_pacman_pkg_splitname(name, name, version, 0) == 0) {
+			_pacman_packdb_invalidate(db, name, version);
+		}
+		if(op == 'W') {
+			journal_apply(db, file, ptr, len);
+		} else if(op == 'D') {
+			journal_apply(db, file, NULL, 0);
+		} else if(op == 'R') {
+			char entry[PATH_MAX];
+			snprintf(entry, PATH_MAX, "%s/%s", db->path, file);
+			_pacman_rmrf(entry);
+		}
+		entries = journal_entry(entries, file);
+		count++;
+	}
+
+	if(journal_sync(db) == -1) {
+		count = -1;
+	}
+	_pacman_dbchanges_logall(db, entries);
+	FREELIST(entries);
+	_pacman_log(PM_LOG_DEBUG, _("journal: replayed %d record(s) of '%s'"), count, db->treename);
+	return(count);
+}
+
+/* apply what a crashed transaction left in the journal, the caller holds
+ * the lock
+ * Returns the number of records applied, or -1 if the journal is kept as it
+ * could not be applied.
+ */
+int _pacman_journal_replay(pmdb_t *db)
+{
+	char path[PATH_MAX], *data;
+	ssize_t committed;
+	int count = 0;
+
+	if(db == NULL || db->handle == NULL) {
+		return(0);
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_JOURNAL, db->path);
+	if((committed = journal_read(path, &data)) == -1) {
+		return(0);
+	}
+	if(committed > 0) {
+		count = journal_replay(db, data, committed);
+	}
+	free(data);
+	if(count != -1) {
+		unlink(path);
+	}
+	return(count);
+}
+
+/* called when the local db is opened: entries must not be read while a
+ * committed journal is not applied
+ */
+int _pacman_journal_recover(pmdb_t *db)
+{
+	char path[PATH_MAX], lock[PATH_MAX], *data;
+	ssize_t committed;
+	int fd;
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_JOURNAL, db->path);
+	if(access(path, F_OK) == -1) {
+		return(0);
+	}
+	snprintf(lock, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
+	if((fd = _pacman_lckmk(lock)) == -1 && errno == EEXIST) {
+		/* a transaction is running (the journal is its own), or its lock was left
+		 * behind: it will be replayed by the next one */
+		return(0);
+	}
+	if(fd != -1 && access(db->path, W_OK) == 0) {
+		if(_pacman_journal_replay(db) > 0 && db->pack) {
+			/* the pack got invalidated, it is opened again */
+			FREEPACKDB(db->pack);
+		}
+		close(fd);
+		_pacman_lckrm(lock);
+		return(0);
+	}
+	if(fd != -1) {
+		close(fd);
+		_pacman_lckrm(lock);
+	}
+
+	committed = journal_read(path, &data);
+	free(data);
+	if(committed > 0) {
+		_pacman_log(PM_LOG_ERROR, _("the journal of '%s' has to be replayed, run pacman-g2 as root"), db->treename);
+		RET_ERR(PM_ERR_DB_OPEN, -1);
+	}
+	return(0);
+}
+
+/* the writes of an interrupted group are committed as they are */
+int _pacman_journal_flush(pmdb_t *db)
+{
+	if(db == NULL || db->journal == NULL || db->journal->depth == 0) {
+		return(0);
+	}
+	db->journal->depth = 1;
+	return(_pacman_journal_commit(db));
+}
+
+/* open a file of the db for writing
+ * With a running transaction, the content goes to memory and to the journal
+ * when the file is closed with _pacman_journal_fclose().
+ */
+FILE *_pacman_journal_fopen(pmdb_t *db, const char *path)
+{
+	pmjournal_t *journal = db->journal;
+
+	if(journal == NULL || journal->fd == -1 || journal->cur) {
+		return(fopen(path, "w"));
+	}
+	/* path is <db->path>/<entry>/<file> */
+	STRNCPY(journal->path, path+strlen(db->path)+1, PATH_MAX);
+	journal->cur = open_memstream(&journal->buf, &journal->len);
+	return(journal->cur);
+}
+
+int _pacman_journal_fclose(pmdb_t *db, FILE *fp)
+{
+	pmjournal_t *journal = db->journal;
+
+	if(journal == NULL || fp != journal->cur) {
+		return(fclose(fp));
+	}
+	journal->cur = NULL;
+	if(fclose(fp) != 0) {
+		FREE(journal->buf);
+		return(EOF);
+	}
+
+	if(journal_log(journal, 'W', journal->path, journal->buf, journal->len) == -1) {
+		FREE(journal->buf);
+		return(EOF);
+	}
+	if(journal_set(journal, journal->path, journal->buf, journal->len) == -1) {
+		journal->buf = NULL;
+		return(EOF);
+	}
+	journal->buf = NULL;
+	return(0);
+}
+
+/* remove a file of the db, at the end of the transaction if one is running */
+int _pacman_journal_unlink(pmdb_t *db, const char *path)
+{
+	pmjournal_t *journal = db->journal;
+	const char *file = path+strlen(db->path)+1;
+
+	if(journal == NULL || journal->fd == -1) {
+		return(unlink(path) == -1 && errno != ENOENT ? -1 : 0);
+	}
+	if(journal_log(journal, 'D', file, "", 0) == -1) {
+		return(-1);
+	}
+	return(journal_set(journal, file, NULL, 0));
+}
+
+/* the not yet applied content of a file of the db
+ * Returns 0 if the running transaction did not touch the file. Otherwise
+ * returns 1 and points *data to the content, or to NULL (with errno set) if
+ * the file is deleted.
+ */
+int _pacman_journal_lookup(pmdb_t *db, const char *path, const char **data, size_t *len)
+{
+	pmjournal_file_t *file;
+
+	if(db->journal == NULL || db->journal->pending == NULL) {
+		return(0);
+	}
+	path += strlen(db->path)+1;
+	if((file = journal_pending(db->journal, path)) == NULL) {
+		if(!journal_removed(db->journal, path)) {
+			return(0);
+		}
+		/* the entry goes away, and the new one does not have this file */
+		errno = ENOENT;
+		*data = NULL;
+		*len = 0;
+		return(1);
+	}
+	if(file->data == NULL) {
+		errno = ENOENT;
+	}
+	*data = file->data;
+	*len = file->len;
+	return(1);
+}
+
+/* remove the directory of an entry, at the end of the transaction if one
+ * is running
+ * Returns 0 on success, 1 if the entry could not be removed in place, -1 on
+ * error.
+ */
+int _pacman_journal_remove(pmdb_t *db, const char *dirname)
+{
+	pmjournal_t *journal = db->journal;
+	pmjournal_file_t *entry;
+	size_t len = strlen(dirname);
+	pmlist_t *i;
+
+	if(journal == NULL || journal->fd == -1) {
+		char path[PATH_MAX];
+		snprintf(path, PATH_MAX, "%s/%s", db->path, dirname);
+		return(_pacman_rmrf(path) ? 1 : 0);
+	}
+	if(journal_log(journal, 'R', dirname, "", 0) == -1) {
+		return(-1);
+	}
+	/* what was written to it so far goes with it, what comes next is
+	 * applied after the removal */
+	for(i = journal->pending; i; ) {
+		pmjournal_file_t *file = i->data;
+		pmlist_t *next = i->next;
+		if(!strncmp(file->path, dirname, len) && file->path[len] == '/') {
+			void *data;
+			journal->pending = _pacman_list_remove(journal->pending, file, journal_file_cmp, &data);
+			journal_file_free(data);
+		}
+		i = next;
+	}
+	if((entry = _pacman_zalloc(sizeof(pmjournal_file_t))) == NULL) {
+		return(-1);
+	}
+	if((entry->path = strdup(dirname)) == NULL) {
+		free(entry);
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+	entry->entry = 1;
+	journal->pending = _pacman_list_add(journal->pending, entry);
+	return(0);
+}
+
+/* vim: set ts=2 sw=2 noet: */
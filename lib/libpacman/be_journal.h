@@ -0,0 +1,67 @@
+/*
+ *  be_journal.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_JOURNAL_H
+#define _PACMAN_BE_JOURNAL_H
+
+#include <stdio.h>
+#include <limits.h>
+
+#include "list.h"
+#include "db.h"
+
+#define PM_EXT_JOURNAL ".journal"
+
+/* latest content of a file of the db, or an entry to remove, not yet applied */
+typedef struct __pmjournal_file_t {
+	char *path; /* relative to the db directory */
+	char *data; /* NULL if the file is to be removed */
+	size_t len;
+	unsigned short entry; /* path is a whole entry, to be removed */
+} pmjournal_file_t;
+
+typedef struct __pmjournal_t {
+	int fd;            /* the log, -1 if no transaction is running */
+	int depth;         /* nesting of _pacman_journal_begin() calls */
+	pmlist_t *pending; /* list of pmjournal_file_t */
+	/* the file being written */
+	FILE *cur;
+	char *buf;
+	size_t len;
+	char path[PATH_MAX];
+} pmjournal_t;
+
+#define FREEJOURNAL(p) do { if(p) { _pacman_journal_free(p); p = NULL; } } while(0)
+
+void _pacman_journal_free(pmjournal_t *journal);
+int _pacman_journal_begin(pmdb_t *db);
+int _pacman_journal_commit(pmdb_t *db);
+int _pacman_journal_replay(pmdb_t *db);
+int _pacman_journal_recover(pmdb_t *db);
+int _pacman_journal_flush(pmdb_t *db);
+FILE *_pacman_journal_fopen(pmdb_t *db, const char *path);
+int _pacman_journal_fclose(pmdb_t *db, FILE *fp);
+int _pacman_journal_unlink(pmdb_t *db, const char *path);
+int _pacman_journal_lookup(pmdb_t *db, const char *path, const char **data, size_t *len);
+int _pacman_journal_remove(pmdb_t *db, const char *dirname);
+
+#endif /* _PACMAN_BE_JOURNAL_H */
+
+/* vim: set ts=2 sw=2 noet: */
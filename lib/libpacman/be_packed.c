@@ -0,0 +1,1086 @@
+/*
+ *  be_packed.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The packed local database is a read-optimized copy of the directory
+ * layout: one file holding every desc, depends, files and install entry,
+ * indexed by package name and mapped read-only.  The directory layout
+ * stays the place where packages are written to (scriptlets are run from
+ * there, too); any write drops the pack, and it is regenerated at the end
+ * of the transaction from the old mapping plus the entries which changed.
+ *
+ * Sync databases get a pack in the same format, converted from the .fdb
+ * archive by pacman_db_update(), so that reading them does not need to
+ * decompress anything.  The archive stays the source of truth: the pack is
+ * stamped with its mtime, and ignored as soon as it does not match.  A sync
+ * db without a usable pack is converted the first time it is scanned, as
+ * long as the pack can be written: that costs a single pass over the
+ * archive, which the scan would have to do anyway, and every read after
+ * that goes straight to the entry it needs.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <libintl.h>
+#ifdef CYGWIN
+#include <limits.h> /* PATH_MAX */
+#endif
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "error.h"
+#include "package.h"
+#include "db.h"
+#include "handle.h"
+#include "pacman.h"
+#include "be_packed.h"
+#include "readahead.h"
+
+static const char *sections[PM_PACKDB_NSECT] = { "desc", "depends", "files", "install" };
+
+/* a package which goes into the pack being written */
+typedef struct __pmpacksrc_t {
+	char name[PKG_NAME_LEN];
+	char version[PKG_VERSION_LEN];
+	const pmpackentry_t *old; /* NULL if it has to be read from the directory */
+} pmpacksrc_t;
+
+static int packdb_srccmp(const void *p1, const void *p2)
+{
+	const pmpacksrc_t *s1 = p1, *s2 = p2;
+	int ret = strcmp(s1->name, s2->name);
+
+	return(ret ? ret : strcmp(s1->version, s2->version));
+}
+
+/* every offset of the entries points inside the pack, and its last byte is
+ * a NUL, so the strings end inside it too */
+static int packdb_valid(const pmpackdb_t *pack)
+{
+	const pmpackhdr_t *hdr = (const pmpackhdr_t *)pack->map;
+	const pmpackentry_t *entries = (const pmpackentry_t *)(pack->map+sizeof(pmpackhdr_t));
+	unsigned int n;
+	int s;
+
+	if(memcmp(hdr->magic, PM_PACKDB_MAGIC, sizeof(hdr->magic)) ||
+		sizeof(pmpackhdr_t)+(size_t)hdr->count*sizeof(pmpackentry_t) >= pack->size ||
+		pack->map[pack->size-1] != '\0') {
+		return(0);
+	}
+	for(n = 0; n < hdr->count; n++) {
+		if(entries[n].name >= pack->size || entries[n].version >= pack->size ||
+			entries[n].present >= (1 << PM_PACKDB_NSECT)) {
+			return(0);
+		}
+		for(s = 0; s < PM_PACKDB_NSECT; s++) {
+			if((entries[n].present & (1 << s)) &&
+				(entries[n].off[s] > pack->size || entries[n].len[s] > pack->size-entries[n].off[s])) {
+				return(0);
+			}
+		}
+	}
+	return(1);
+}
+
+static int packdb_map(const char *path, pmpackdb_t *pack)
+{
+	struct stat buf;
+	const pmpackhdr_t *hdr;
+	int fd;
+
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(-1);
+	}
+	if(fstat(fd, &buf) == -1 || (size_t)buf.st_size < sizeof(pmpackhdr_t)) {
+		close(fd);
+		return(-1);
+	}
+	pack->map = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(pack->map == MAP_FAILED) {
+		pack->map = NULL;
+		return(-1);
+	}
+	pack->size = buf.st_size;
+
+	hdr = (const pmpackhdr_t *)pack->map;
+	if(!packdb_valid(pack)) {
+		_pacman_log(PM_LOG_WARNING, _("%s is not a valid packed database, ignoring"), path);
+		munmap(pack->map, pack->size);
+		pack->map = NULL;
+		return(-1);
+	}
+	pack->entries = (const pmpackentry_t *)(pack->map+sizeof(pmpackhdr_t));
+	pack->count = hdr->count;
+	pack->pos = 0;
+	return(0);
+}
+
+static void packdb_unmap(pmpackdb_t *pack)
+{
+	if(pack->map) {
+		munmap(pack->map, pack->size);
+		pack->map = NULL;
+	}
+	pack->entries = NULL;
+	pack->count = 0;
+	pack->pos = 0;
+}
+
+/* the pack is valid as long as the directory (or the archive) it was
+ * generated from did not change; a sync pack patched by a delta has no
+ * archive anymore, and is stamped 0 */
+static int packdb_fresh(const char *source, pmpackdb_t *pack)
+{
+	const pmpackhdr_t *hdr = (const pmpackhdr_t *)pack->map;
+	struct stat buf;
+
+	if(stat(source, &buf) == -1) {
+		return(errno == ENOENT && hdr->mtime == 0 && hdr->mtimensec == 0);
+	}
+	return(hdr->mtime == (int64_t)buf.st_mtim.tv_sec && hdr->mtimensec == (int64_t)buf.st_mtim.tv_nsec);
+}
+
+static char *packdb_slurp(const char *path, size_t *len)
+{
+	struct stat buf;
+	char *data;
+	int fd;
+	ssize_t n = 0;
+	size_t done = 0;
+
+	if((fd = open(path, O_RDONLY)) == -1) {
+		return(NULL);
+	}
+	if(fstat(fd, &buf) == -1) {
+		close(fd);
+		return(NULL);
+	}
+	if((data = _pacman_malloc(buf.st_size+1)) == NULL) {
+		close(fd);
+		return(NULL);
+	}
+	while(done < (size_t)buf.st_size && (n = read(fd, data+done, buf.st_size-done)) > 0) {
+		done += n;
+	}
+	close(fd);
+	if(done != (size_t)buf.st_size) {
+		/* a short read would be packed as the whole file */
+		if(n == 0) {
+			errno = EIO;
+		}
+		free(data);
+		return(NULL);
+	}
+	*len = done;
+	return(data);
+}
+
+static int packdb_writeblob(FILE *fp, const void *data, size_t len, uint32_t *off)
+{
+	long pos = ftell(fp);
+
+	if(pos == -1 || (len && fwrite(data, 1, len, fp) != len)) {
+		return(-1);
+	}
+	*off = (uint32_t)pos;
+	return(0);
+}
+
+/* collect the packages of the directory layout in *srcs
+ * Returns -1 if it could not be read whole: a partial list must not be
+ * packed, the pack would look up to date. */
+static int packdb_readdir(pmdb_t *db, pmlist_t **srcs)
+{
+	pmlist_t *ret = NULL;
+	struct dirent *ent;
+	DIR *dir;
+
+	*srcs = NULL;
+	if((dir = opendir(db->path)) == NULL) {
+		return(-1);
+	}
+	while((ent = _pacman_readdir_subdir(dir)) != NULL) {
+		pmpacksrc_t *src;
+		if((src = _pacman_zalloc(sizeof(pmpacksrc_t))) == NULL) {
+			closedir(dir);
+			FREELIST(ret);
+			return(-1);
+		}
+		if(_pacman_pkg_splitname(ent->d_name, src->name, src->version, 0) == -1) {
+			_pacman_log(PM_LOG_ERROR, _("invalid name for dabatase entry '%s'"), ent->d_name);
+			free(src);
+			continue;
+		}
+		ret = _pacman_list_add_sorted(ret, src, packdb_srccmp);
+	}
+	closedir(dir);
+	*srcs = ret;
+	return(0);
+}
+
+/* the contents of the old pack, minus the entries touched since it was
+ * mapped, plus the current state of those entries, in *srcs
+ * Returns -1 on error, like packdb_readdir(). */
+static int packdb_merge(pmdb_t *db, pmpackdb_t *old, pmlist_t **srcs)
+{
+	pmlist_t *ret = NULL, *i;
+	struct stat buf;
+	char path[PATH_MAX];
+	unsigned int n;
+
+	*srcs = NULL;
+
+	for(n = 0; n < old->count; n++) {
+		const pmpackentry_t *entry = &old->entries[n];
+		pmpacksrc_t *src;
+
+		snprintf(path, PATH_MAX, "%s-%s", _pacman_packdb_string(old, entry->name),
+			_pacman_packdb_string(old, entry->version));
+		if(_pacman_list_is_strin(path, old->dirty)) {
+			continue;
+		}
+		if((src = _pacman_zalloc(sizeof(pmpacksrc_t))) == NULL) {
+			FREELIST(ret);
+			return(-1);
+		}
+		STRNCPY(src->name, _pacman_packdb_string(old, entry->name), PKG_NAME_LEN);
+		STRNCPY(src->version, _pacman_packdb_string(old, entry->version), PKG_VERSION_LEN);
+		src->old = entry;
+		ret = _pacman_list_add(ret, src);
+	}
+	for(i = old->dirty; i; i = i->next) {
+		pmpacksrc_t *src;
+
+		snprintf(path, PATH_MAX, "%s/%s", db->path, (char *)i->data);
+		if(stat(path, &buf) || !S_ISDIR(buf.st_mode)) {
+			/* removed */
+			continue;
+		}
+		if((src = _pacman_zalloc(sizeof(pmpacksrc_t))) == NULL) {
+			FREELIST(ret);
+			return(-1);
+		}
+		if(_pacman_pkg_splitname(i->data, src->name, src->version, 0) == -1) {
+			free(src);
+			continue;
+		}
+		/* the old entries are already sorted, only place the new ones */
+		ret = _pacman_list_add_sorted(ret, src, packdb_srccmp);
+	}
+	*srcs = ret;
+	return(0);
+}
+
+/* write the pack for the given list of sources, atomically */
+static int packdb_write(pmdb_t *db, pmlist_t *srcs, pmpackdb_t *old)
+{
+	char path[PATH_MAX], tmp[PATH_MAX], file[PATH_MAX];
+	pmpackhdr_t hdr;
+	pmpackentry_t *entries;
+	struct stat buf;
+	unsigned int count, n;
+	pmlist_t *i;
+	FILE *fp;
+	mode_t oldmask;
+
+	if(stat(db->path, &buf) == -1) {
+		return(-1);
+	}
+	count = _pacman_list_count(srcs);
+	if((entries = _pacman_zalloc((count ? count : 1)*sizeof(pmpackentry_t))) == NULL) {
+		return(-1);
+	}
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+	snprintf(tmp, PATH_MAX, "%s.tmp", path);
+	oldmask = umask(0022);
+	fp = fopen(tmp, "w");
+	umask(oldmask);
+	if(fp == NULL) {
+		_pacman_log(PM_LOG_DEBUG, "%s (%s)", tmp, strerror(errno));
+		free(entries);
+		return(-1);
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PM_PACKDB_MAGIC, sizeof(hdr.magic));
+	hdr.count = count;
+	hdr.mtime = buf.st_mtim.tv_sec;
+	hdr.mtimensec = buf.st_mtim.tv_nsec;
+	if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+		(count && fwrite(entries, sizeof(pmpackentry_t), count, fp) != count)) {
+		goto error;
+	}
+
+	for(i = srcs, n = 0; i; i = i->next, n++) {
+		pmpacksrc_t *src = i->data;
+		pmpackentry_t *entry = &entries[n];
+		int s;
+
+		if(packdb_writeblob(fp, src->name, strlen(src->name)+1, &entry->name) == -1 ||
+			packdb_writeblob(fp, src->version, strlen(src->version)+1, &entry->version) == -1) {
+			goto error;
+		}
+		for(s = 0; s < PM_PACKDB_NSECT; s++) {
+			if(src->old) {
+				if(!(src->old->present & (1 << s))) {
+					continue;
+				}
+				if(packdb_writeblob(fp, old->map+src->old->off[s], src->old->len[s], &entry->off[s]) == -1) {
+					goto error;
+				}
+				entry->len[s] = src->old->len[s];
+			} else {
+				size_t len, desclen, deplen;
+				char *data = NULL, *sect;
+				int hdrlen;
+
+				snprintf(file, PATH_MAX, "%s/%s-%s/" PM_DB_META, db->path, src->name, src->version);
+				if(s <= PM_PACKDB_DEPENDS && (data = packdb_slurp(file, &len)) == NULL && errno != ENOENT) {
+					goto error;
+				}
+				if(s <= PM_PACKDB_DEPENDS && data != NULL) {
+					/* a combined record */
+					if((hdrlen = _pacman_db_meta_split(data, len, &desclen, &deplen)) == -1) {
+						free(data);
+						continue;
+					}
+					sect = data+hdrlen+(s == PM_PACKDB_DEPENDS ? desclen : 0);
+					len = (s == PM_PACKDB_DEPENDS ? deplen : desclen);
+				} else {
+					snprintf(file, PATH_MAX, "%s/%s-%s/%s", db->path, src->name, src->version, sections[s]);
+					if((data = packdb_slurp(file, &len)) == NULL) {
+						if(errno != ENOENT) {
+							goto error;
+						}
+						continue;
+					}
+					sect = data;
+				}
+				if(packdb_writeblob(fp, sect, len, &entry->off[s]) == -1) {
+					free(data);
+					goto error;
+				}
+				free(data);
+				entry->len[s] = len;
+			}
+			entry->present |= (1 << s);
+		}
+	}
+
+	/* see packdb_valid() */
+	if(fputc('\0', fp) == EOF || fseek(fp, sizeof(hdr), SEEK_SET) == -1 ||
+		(count && fwrite(entries, sizeof(pmpackentry_t), count, fp) != count) ||
+		fflush(fp) != 0 || fsync(fileno(fp)) == -1) {
+		goto error;
+	}
+	fclose(fp);
+	free(entries);
+	if(rename(tmp, path) == -1) {
+		unlink(tmp);
+		return(-1);
+	}
+	_pacman_log(PM_LOG_DEBUG, _("wrote packed database %s (%d entries)"), path, count);
+	return(0);
+
+error:
+	_pacman_log(PM_LOG_WARNING, _("could not write packed database %s (%s)"), tmp, strerror(errno));
+	fclose(fp);
+	unlink(tmp);
+	free(entries);
+	return(-1);
+}
+
+static int packdb_remap(pmdb_t *db, pmpackdb_t *pack)
+{
+	char path[PATH_MAX];
+
+	packdb_unmap(pack);
+	snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+	if(packdb_map(path, pack) == -1) {
+		return(-1);
+	}
+	pack->stale = 0;
+	FREELIST(pack->dirty);
+	return(0);
+}
+
+/* does the directory layout have any package entry? */
+static int packdb_dirempty(pmdb_t *db)
+{
+	pmlist_t *srcs;
+	int ret = (packdb_readdir(db, &srcs) == 0 && srcs == NULL);
+
+	FREELIST(srcs);
+	return(ret);
+}
+
+pmpackdb_t *_pacman_packdb_open(pmdb_t *db)
+{
+	pmpackdb_t *pack = _pacman_zalloc(sizeof(pmpackdb_t));
+	char path[PATH_MAX];
+
+	if(pack == NULL) {
+		return(NULL);
+	}
+	db->pack = pack;
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+	if(packdb_map(path, pack) == 0) {
+		if(packdb_fresh(db->path, pack)) {
+			return(pack);
+		}
+		if(packdb_dirempty(db)) {
+			/* restore the directory layout from the pack */
+			if(_pacman_packdb_export(db) == 0) {
+				return(pack);
+			}
+		}
+		_pacman_log(PM_LOG_DEBUG, _("packed database %s is out of date"), path);
+		packdb_unmap(pack);
+	}
+
+	if(_pacman_packdb_import(db) == -1) {
+		/* fall back to the directory layout */
+		_pacman_log(PM_LOG_DEBUG, _("could not generate packed database %s, using %s"), path, db->path);
+		pack->stale = 1;
+	}
+	return(pack);
+}
+
+void _pacman_packdb_free(pmpackdb_t *pack)
+{
+	if(pack == NULL) {
+		return;
+	}
+	packdb_unmap(pack);
+	FREELIST(pack->dirty);
+	free(pack);
+}
+
+int _pacman_packdb_usable(pmdb_t *db)
+{
+	return(db->pack && db->pack->map && !db->pack->stale);
+}
+
+const char *_pacman_packdb_string(pmpackdb_t *pack, uint32_t off)
+{
+	return(pack->map+off);
+}
+
+const pmpackentry_t *_pacman_packdb_find(pmpackdb_t *pack, const char *name)
+{
+	unsigned int lo = 0, hi = pack->count;
+
+	while(lo < hi) {
+		unsigned int mid = lo+(hi-lo)/2;
+		int cmp = strcmp(name, _pacman_packdb_string(pack, pack->entries[mid].name));
+		if(cmp == 0) {
+			return(&pack->entries[mid]);
+		} else if(cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid+1;
+		}
+	}
+	return(NULL);
+}
+
+const pmpackentry_t *_pacman_packdb_next(pmpackdb_t *pack)
+{
+	if(pack->pos >= pack->count) {
+		return(NULL);
+	}
+	return(&pack->entries[pack->pos++]);
+}
+
+/* the content of a section of an entry, a view into the map */
+const char *_pacman_packdb_section(pmpackdb_t *pack, const pmpackentry_t *entry, int section, size_t *len)
+{
+	if(!(entry->present & (1 << section))) {
+		errno = ENOENT;
+		return(NULL);
+	}
+	*len = entry->len[section];
+	return(pack->map+entry->off[section]);
+}
+
+/* called before an entry of the directory layout gets modified */
+void _pacman_packdb_invalidate(pmdb_t *db, const char *name, const char *version)
+{
+	char path[PATH_MAX];
+
+	if(db->pack == NULL) {
+		/* even if we do not use it, an existing pack must not survive the change */
+		if((db->pack = _pacman_zalloc(sizeof(pmpackdb_t))) == NULL) {
+			return;
+		}
+	}
+	if(!db->pack->stale) {
+		snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+		unlink(path);
+		db->pack->stale = 1;
+	}
+	if(handle->packeddb) {
+		snprintf(path, PATH_MAX, "%s-%s", name, version);
+		if(!_pacman_list_is_strin(path, db->pack->dirty)) {
+			db->pack->dirty = _pacman_list_add(db->pack->dirty, strdup(path));
+		}
+	}
+}
+
+/* regenerate the pack after the directory layout has been modified */
+int _pacman_packdb_commit(pmdb_t *db)
+{
+	pmpackdb_t *pack;
+	pmlist_t *srcs;
+	int ret;
+
+	if(db == NULL || !handle->packeddb || db->pack == NULL || !db->pack->stale) {
+		return(0);
+	}
+	pack = db->pack;
+	if(pack->map == NULL) {
+		return(_pacman_packdb_import(db));
+	}
+
+	if(packdb_merge(db, pack, &srcs) == -1) {
+		return(-1);
+	}
+	ret = packdb_write(db, srcs, pack);
+	FREELIST(srcs);
+	if(ret == 0) {
+		ret = packdb_remap(db, pack);
+	}
+	return(ret);
+}
+
+/* directory layout -> pack */
+int _pacman_packdb_import(pmdb_t *db)
+{
+	pmlist_t *srcs;
+	int ret;
+
+	if(db->pack == NULL && (db->pack = _pacman_zalloc(sizeof(pmpackdb_t))) == NULL) {
+		return(-1);
+	}
+	if(packdb_readdir(db, &srcs) == -1) {
+		return(-1);
+	}
+	ret = packdb_write(db, srcs, NULL);
+	FREELIST(srcs);
+	if(ret == 0) {
+		ret = packdb_remap(db, db->pack);
+	}
+	return(ret);
+}
+
+/* pack -> directory layout */
+int _pacman_packdb_export(pmdb_t *db)
+{
+	pmpackdb_t *pack = db->pack;
+	char path[PATH_MAX];
+	pmlist_t *srcs = NULL;
+	unsigned int n;
+	int s, ret;
+
+	if(pack == NULL || pack->map == NULL) {
+		return(-1);
+	}
+
+	_pacman_log(PM_LOG_FLOW1, _("restoring %s from the packed database"), db->path);
+	for(n = 0; n < pack->count; n++) {
+		const pmpackentry_t *entry = &pack->entries[n];
+		pmpacksrc_t *src;
+
+		snprintf(path, PATH_MAX, "%s/%s-%s", db->path, _pacman_packdb_string(pack, entry->name),
+			_pacman_packdb_string(pack, entry->version));
+		if(mkdir(path, 0755) == -1 && errno != EEXIST) {
+			_pacman_log(PM_LOG_ERROR, _("could not create directory %s (%s)"), path, strerror(errno));
+			FREELIST(srcs);
+			return(-1);
+		}
+		for(s = 0; s < PM_PACKDB_NSECT; s++) {
+			char file[PATH_MAX];
+			FILE *fp;
+
+			if(!(entry->present & (1 << s))) {
+				continue;
+			}
+			snprintf(file, PATH_MAX, "%s/%s", path, sections[s]);
+			if((fp = fopen(file, "w")) == NULL ||
+				fwrite(pack->map+entry->off[s], 1, entry->len[s], fp) != entry->len[s]) {
+				_pacman_log(PM_LOG_ERROR, _("could not write %s (%s)"), file, strerror(errno));
+				if(fp) {
+					fclose(fp);
+				}
+				FREELIST(srcs);
+				return(-1);
+			}
+			fclose(fp);
+		}
+		if((src = _pacman_zalloc(sizeof(pmpacksrc_t))) == NULL) {
+			FREELIST(srcs);
+			return(-1);
+		}
+		STRNCPY(src->name, _pacman_packdb_string(pack, entry->name), PKG_NAME_LEN);
+		STRNCPY(src->version, _pacman_packdb_string(pack, entry->version), PKG_VERSION_LEN);
+		src->old = entry;
+		srcs = _pacman_list_add(srcs, src);
+	}
+
+	/* same content, but stamped with the new state of the directory */
+	ret = packdb_write(db, srcs, pack);
+	FREELIST(srcs);
+	if(ret == 0) {
+		ret = packdb_remap(db, pack);
+	}
+	return(ret);
+}
+
+/* an entry of a sync pack being converted, its offsets relative to the blobs */
+typedef struct __pmpacksync_t {
+	const char *name;
+	const char *version;
+	pmpackentry_t entry;
+} pmpacksync_t;
+
+typedef struct __pmpackbuf_t {
+	char *data;
+	size_t len;
+	size_t size;
+} pmpackbuf_t;
+
+static int packdb_synccmp(const void *p1, const void *p2)
+{
+	const pmpacksync_t *s1 = p1, *s2 = p2;
+	int ret = strcmp(s1->name, s2->name);
+
+	return(ret ? ret : strcmp(s1->version, s2->version));
+}
+
+static int packdb_reserve(pmpackbuf_t *buf, size_t len)
+{
+	if(buf->len+len > buf->size) {
+		size_t size = buf->size ? buf->size*2 : 1024*1024;
+		char *data;
+		while(size < buf->len+len) {
+			size *= 2;
+		}
+		if((data = realloc(buf->data, size)) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+	return(0);
+}
+
+static int packdb_addblob(pmpackbuf_t *buf, const void *data, size_t len, uint32_t *off)
+{
+	if(packdb_reserve(buf, len) == -1) {
+		return(-1);
+	}
+	memcpy(buf->data+buf->len, data, len);
+	*off = buf->len;
+	buf->len += len;
+	return(0);
+}
+
+/* appends the current member of the archive to the blobs */
+static int packdb_addmember(struct archive *a, struct archive_entry *ae, pmpackbuf_t *buf, uint32_t *off, uint32_t *len)
+{
+	size_t start = buf->len;
+
+	if(_pacman_archive_read_entry(a, ae, &buf->data, &buf->len, &buf->size) == -1) {
+		return(-1);
+	}
+	*off = start;
+	*len = buf->len-start;
+	return(0);
+}
+
+/* the entries and the blobs of a sync pack being written */
+typedef struct __pmpackset_t {
+	pmpacksync_t *entries;
+	unsigned int count;
+	unsigned int max;
+	pmpackbuf_t blobs;
+} pmpackset_t;
+
+/* appends the entry dirname to set, NULL with *invalid set if the name is
+ * not one of an entry */
+static pmpacksync_t *packdb_addentry(pmpackset_t *set, char *dirname, int *invalid)
+{
+	char name[PKG_NAME_LEN], version[PKG_VERSION_LEN];
+	pmpacksync_t *cur;
+
+	*invalid = 0;
+	if(_pacman_pkg_splitname(dirname, name, version, 0) == -1) {
+		_pacman_log(PM_LOG_ERROR, _("invalid name for dabatase entry '%s'"), dirname);
+		*invalid = 1;
+		return(NULL);
+	}
+	if(set->count == set->max) {
+		pmpacksync_t *ptr;
+		unsigned int max = set->max ? set->max*2 : 1024;
+		if((ptr = realloc(set->entries, max*sizeof(pmpacksync_t))) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, NULL);
+		}
+		set->entries = ptr;
+		set->max = max;
+	}
+	cur = &set->entries[set->count];
+	memset(cur, 0, sizeof(pmpacksync_t));
+	if(packdb_addblob(&set->blobs, name, strlen(name)+1, &cur->entry.name) == -1 ||
+		packdb_addblob(&set->blobs, version, strlen(version)+1, &cur->entry.version) == -1) {
+		return(NULL);
+	}
+	set->count++;
+	return(cur);
+}
+
+/* the section a member of a sync entry goes to, -1 if it is not packed */
+static int packdb_syncsection(const char *file)
+{
+	if(!strcmp(file, "desc")) {
+		return(PM_PACKDB_DESC);
+	} else if(!strcmp(file, "depends")) {
+		return(PM_PACKDB_DEPENDS);
+	}
+	return(-1);
+}
+
+/* writes the pack of a sync db from set, stamped with mtime */
+static int packdb_writesync(pmdb_t *db, pmpackset_t *set, int64_t mtime, int64_t mtimensec)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	pmpacksync_t *entries = set->entries;
+	unsigned int count = set->count, n;
+	pmpackhdr_t hdr;
+	size_t base;
+	FILE *fp = NULL;
+	int fd = -1, ret = -1;
+
+	snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+	/* scans convert without holding the lock, so the name has to be unique */
+	snprintf(tmp, PATH_MAX, "%s.XXXXXX", path);
+
+	/* the blobs do not move anymore */
+	for(n = 0; n < count; n++) {
+		entries[n].name = set->blobs.data+entries[n].entry.name;
+		entries[n].version = set->blobs.data+entries[n].entry.version;
+	}
+	if(count) {
+		qsort(entries, count, sizeof(pmpacksync_t), packdb_synccmp);
+	}
+	base = sizeof(hdr)+(size_t)count*sizeof(pmpackentry_t);
+	if(base+set->blobs.len > UINT32_MAX) {
+		goto cleanup;
+	}
+
+	if((fd = mkstemp(tmp)) == -1) {
+		goto cleanup;
+	}
+	if(fchmod(fd, 0644) == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		goto cleanup;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PM_PACKDB_MAGIC, sizeof(hdr.magic));
+	hdr.count = count;
+	hdr.mtime = mtime;
+	hdr.mtimensec = mtimensec;
+	if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		goto cleanup;
+	}
+	for(n = 0; n < count; n++) {
+		pmpackentry_t entry = entries[n].entry;
+		int s;
+
+		entry.name += base;
+		entry.version += base;
+		for(s = 0; s < PM_PACKDB_NSECT; s++) {
+			if(entry.present & (1 << s)) {
+				entry.off[s] += base;
+			}
+		}
+		if(fwrite(&entry, sizeof(entry), 1, fp) != 1) {
+			goto cleanup;
+		}
+	}
+	if((set->blobs.len && fwrite(set->blobs.data, 1, set->blobs.len, fp) != set->blobs.len) ||
+		fputc('\0', fp) == EOF || fflush(fp) != 0 || fsync(fileno(fp)) == -1) {
+		goto cleanup;
+	}
+	fclose(fp);
+	fp = NULL;
+	if(rename(tmp, path) == -1) {
+		goto cleanup;
+	}
+	_pacman_log(PM_LOG_DEBUG, _("wrote packed database %s (%d entries)"), path, count);
+	ret = 0;
+
+cleanup:
+	if(ret == -1) {
+		_pacman_log(PM_LOG_WARNING, _("could not write packed database %s (%s)"), tmp, strerror(errno));
+		if(fp) {
+			fclose(fp);
+		}
+		if(fd != -1) {
+			unlink(tmp);
+		}
+	}
+	return(ret);
+}
+
+/* .fdb archive -> pack, for a sync db */
+int _pacman_packdb_sync(pmdb_t *db)
+{
+	char fdb[PATH_MAX], dirname[PATH_MAX] = "";
+	pmpackset_t set;
+	pmpacksync_t *cur = NULL;
+	struct archive *a;
+	struct archive_entry *ae;
+	struct stat buf;
+	int r, ret = -1;
+
+	memset(&set, 0, sizeof(set));
+	snprintf(fdb, PATH_MAX, "%s" PM_EXT_DB, db->path);
+	if(stat(fdb, &buf) == -1 || (a = _pacman_archive_open(fdb)) == NULL) {
+		return(-1);
+	}
+
+	while((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+		const char *pathname = archive_entry_pathname(ae);
+		const char *slash = strrchr(pathname, '/');
+		size_t dirlen;
+		int s, invalid;
+
+		if(slash == NULL || (dirlen = slash-pathname) == 0 || dirlen >= PATH_MAX) {
+			continue;
+		}
+		if(strncmp(dirname, pathname, dirlen) || dirname[dirlen] != '\0') {
+			/* the first member of a new package */
+			memcpy(dirname, pathname, dirlen);
+			dirname[dirlen] = '\0';
+			if((cur = packdb_addentry(&set, dirname, &invalid)) == NULL && !invalid) {
+				goto cleanup;
+			}
+		}
+		if(cur == NULL || (s = packdb_syncsection(slash+1)) == -1) {
+			continue;
+		}
+		if(packdb_addmember(a, ae, &set.blobs, &cur->entry.off[s], &cur->entry.len[s]) == -1) {
+			goto cleanup;
+		}
+		cur->entry.present |= (1 << s);
+	}
+	if(r == ARCHIVE_EOF) {
+		ret = packdb_writesync(db, &set, buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec);
+	}
+
+cleanup:
+	archive_read_finish(a);
+	free(set.entries);
+	free(set.blobs.data);
+	return(ret);
+}
+
+static int packdb_strcmp(const void *p1, const void *p2)
+{
+	return(strcmp(*(char *const *)p1, *(char *const *)p2));
+}
+
+/* Patches the pack of a sync db with a delta: the entries of drop
+ * ("name-version") are left out, and the members (pmpackmember_t, laid out
+ * as in the archive) are added.  The archive the pack was converted from is
+ * removed, as it is out of date now: the pack is the copy of the repository
+ * until the next whole download.
+ */
+int _pacman_packdb_patch(pmdb_t *db, pmlist_t *drop, pmlist_t *members)
+{
+	char fdb[PATH_MAX], path[PATH_MAX], dirname[PATH_MAX] = "", **skip = NULL;
+	pmpackdb_t *pack = db->pack;
+	pmpackset_t set;
+	pmpacksync_t *cur = NULL;
+	unsigned int nskip = 0, n;
+	pmlist_t *i;
+	int ret = -1;
+
+	if(!_pacman_packdb_usable(db)) {
+		return(-1);
+	}
+	memset(&set, 0, sizeof(set));
+	if(drop) {
+		if((skip = _pacman_malloc(_pacman_list_count(drop)*sizeof(char *))) == NULL) {
+			return(-1);
+		}
+		for(i = drop; i; i = i->next) {
+			skip[nskip++] = i->data;
+		}
+		qsort(skip, nskip, sizeof(char *), packdb_strcmp);
+	}
+
+	/* what stays of the old pack */
+	for(n = 0; n < pack->count; n++) {
+		const pmpackentry_t *entry = &pack->entries[n];
+		char *key = dirname;
+		int s, invalid;
+
+		snprintf(dirname, PATH_MAX, "%s-%s", _pacman_packdb_string(pack, entry->name),
+			_pacman_packdb_string(pack, entry->version));
+		if(nskip && bsearch(&key, skip, nskip, sizeof(char *), packdb_strcmp)) {
+			continue;
+		}
+		if((cur = packdb_addentry(&set, dirname, &invalid)) == NULL) {
+			if(invalid) {
+				continue;
+			}
+			goto cleanup;
+		}
+		for(s = 0; s < PM_PACKDB_NSECT; s++) {
+			if(!(entry->present & (1 << s))) {
+				continue;
+			}
+			if(packdb_addblob(&set.blobs, pack->map+entry->off[s], entry->len[s], &cur->entry.off[s]) == -1) {
+				goto cleanup;
+			}
+			cur->entry.len[s] = entry->len[s];
+			cur->entry.present |= (1 << s);
+		}
+	}
+	/* what the delta brings */
+	dirname[0] = '\0';
+	cur = NULL;
+	for(i = members; i; i = i->next) {
+		pmpackmember_t *member = i->data;
+		const char *pathname = member->path;
+		const char *slash;
+		size_t dirlen;
+		int s, invalid;
+
+		if(!strncmp(pathname, "./", 2)) {
+			pathname += 2;
+		}
+		if((slash = strrchr(pathname, '/')) == NULL || (dirlen = slash-pathname) == 0 || dirlen >= PATH_MAX) {
+			continue;
+		}
+		if(strncmp(dirname, pathname, dirlen) || dirname[dirlen] != '\0') {
+			memcpy(dirname, pathname, dirlen);
+			dirname[dirlen] = '\0';
+			if((cur = packdb_addentry(&set, dirname, &invalid)) == NULL && !invalid) {
+				goto cleanup;
+			}
+		}
+		if(cur == NULL || (s = packdb_syncsection(slash+1)) == -1) {
+			continue;
+		}
+		if(packdb_addblob(&set.blobs, member->data, member->len, &cur->entry.off[s]) == -1) {
+			goto cleanup;
+		}
+		cur->entry.len[s] = member->len;
+		cur->entry.present |= (1 << s);
+	}
+	if(packdb_writesync(db, &set, 0, 0) == -1) {
+		goto cleanup;
+	}
+	snprintf(fdb, PATH_MAX, "%s" PM_EXT_DB, db->path);
+	if(unlink(fdb) == -1 && errno != ENOENT) {
+		/* the pack would look stale next to it, and be converted back */
+		_pacman_log(PM_LOG_WARNING, _("could not remove %s (%s)"), fdb, strerror(errno));
+		snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+		unlink(path);
+		goto cleanup;
+	}
+	_pacman_log(PM_LOG_DEBUG, _("patched packed database of %s: %u entries"), db->treename, set.count);
+	ret = 0;
+
+cleanup:
+	free(skip);
+	free(set.entries);
+	free(set.blobs.data);
+	return(ret);
+}
+
+/* maps the pack of a sync db, if it is up to date with the archive */
+pmpackdb_t *_pacman_packdb_opensync(pmdb_t *db)
+{
+	pmpackdb_t *pack;
+	char path[PATH_MAX], fdb[PATH_MAX];
+
+	FREEPACKDB(db->pack);
+	if((pack = _pacman_zalloc(sizeof(pmpackdb_t))) == NULL) {
+		return(NULL);
+	}
+	snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+	snprintf(fdb, PATH_MAX, "%s" PM_EXT_DB, db->path);
+	if(packdb_map(path, pack) == -1) {
+		free(pack);
+		return(NULL);
+	}
+	if(!packdb_fresh(fdb, pack)) {
+		_pacman_log(PM_LOG_DEBUG, _("packed database %s is out of date"), path);
+		_pacman_packdb_free(pack);
+		return(NULL);
+	}
+	db->pack = pack;
+	return(pack);
+}
+
+/* converts a sync db which has no usable pack, the first time it is needed
+ * Returns 0 if the pack is usable afterwards, -1 if the archive is to be
+ * read instead.
+ */
+int _pacman_packdb_convert(pmdb_t *db)
+{
+	char dir[PATH_MAX], *ptr;
+
+	if(_pacman_packdb_usable(db)) {
+		return(0);
+	}
+	if(db->pack) {
+		/* we already tried */
+		return(-1);
+	}
+	STRNCPY(dir, db->path, PATH_MAX);
+	if((ptr = strrchr(dir, '/')) != NULL) {
+		*ptr = '\0';
+	}
+	if(access(dir, W_OK) == 0 && _pacman_packdb_sync(db) == 0 && _pacman_packdb_opensync(db) != NULL) {
+		return(0);
+	}
+	/* remember the failure until the db is reopened */
+	if((db->pack = _pacman_zalloc(sizeof(pmpackdb_t))) != NULL) {
+		db->pack->stale = 1;
+	}
+	return(-1);
+}
+
+/* vim: set ts=2 sw=2 noet: */
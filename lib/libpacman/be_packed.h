@@ -0,0 +1,98 @@
+/*
+ *  be_packed.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_BE_PACKED_H
+#define _PACMAN_BE_PACKED_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "db.h"
+
+#define PM_EXT_PACKDB ".pack"
+#define PM_PACKDB_MAGIC "PMPACK02"
+
+/* Sections of a packed entry, in the order they are stored */
+#define PM_PACKDB_DESC    0
+#define PM_PACKDB_DEPENDS 1
+#define PM_PACKDB_FILES   2
+#define PM_PACKDB_INSTALL 3
+#define PM_PACKDB_NSECT   4
+
+/* On-disk layout: header, entry table (sorted by package name), the blobs
+ * the entries point to and a NUL byte.  Every offset is relative to the
+ * start of the file, so the whole thing can be used straight from the
+ * mapping.
+ */
+typedef struct __pmpackhdr_t {
+	char magic[8];
+	uint32_t count;
+	uint32_t reserved;
+	int64_t mtime;     /* st_mtime of the directory layout the pack */
+	int64_t mtimensec; /* was generated from */
+} pmpackhdr_t;
+
+typedef struct __pmpackentry_t {
+	uint32_t name;
+	uint32_t version;
+	uint32_t present; /* bitmask of the sections which exist */
+	uint32_t off[PM_PACKDB_NSECT];
+	uint32_t len[PM_PACKDB_NSECT];
+} pmpackentry_t;
+
+typedef struct __pmpackdb_t {
+	char *map;
+	size_t size;
+	const pmpackentry_t *entries;
+	unsigned int count;
+	unsigned int pos; /* iterator used by _pacman_db_scan() */
+	int stale;        /* the directory layout changed since we mapped */
+	pmlist_t *dirty;  /* "name-version" entries touched since then */
+} pmpackdb_t;
+
+/* a member of a sync entry, as read from an archive */
+typedef struct __pmpackmember_t {
+	char *path; /* name-version/file */
+	char *data;
+	size_t len;
+} pmpackmember_t;
+
+#define FREEPACKDB(p) do { if(p) { _pacman_packdb_free(p); p = NULL; } } while(0)
+
+pmpackdb_t *_pacman_packdb_open(pmdb_t *db);
+void _pacman_packdb_free(pmpackdb_t *pack);
+int _pacman_packdb_usable(pmdb_t *db);
+const pmpackentry_t *_pacman_packdb_find(pmpackdb_t *pack, const char *name);
+const pmpackentry_t *_pacman_packdb_next(pmpackdb_t *pack);
+const char *_pacman_packdb_string(pmpackdb_t *pack, uint32_t off);
+const char *_pacman_packdb_section(pmpackdb_t *pack, const pmpackentry_t *entry, int section, size_t *len);
+void _pacman_packdb_invalidate(pmdb_t *db, const char *name, const char *version);
+int _pacman_packdb_commit(pmdb_t *db);
+int _pacman_packdb_import(pmdb_t *db);
+int _pacman_packdb_export(pmdb_t *db);
+int _pacman_packdb_sync(pmdb_t *db);
+int _pacman_packdb_patch(pmdb_t *db, pmlist_t *drop, pmlist_t *members);
+pmpackdb_t *_pacman_packdb_opensync(pmdb_t *db);
+int _pacman_packdb_convert(pmdb_t *db);
+
+#endif /* _PACMAN_BE_PACKED_H */
+
+/* vim: set ts=2 sw=2 noet: */
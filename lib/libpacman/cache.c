@@ -40,14 +40,328 @@
 #include "handle.h"
 #include "error.h"
 #include "cache.h"
+#include "parallel.h"
+#include "be_changes.h"
+#include "be_packed.h"
+#include "strpool.h"
+#include "provide.h"
+
+/* The name index of a package cache: for each name, the element of the
+ * cache holding the first package of that name, which is the one
+ * _pacman_pkg_isin() would find.  It is kept up to date by the functions
+ * adding entries to or removing entries from the cache.
+ */
+typedef struct __pmpkghash_t {
+	pmlist_t **slots; /* open addressing, linear probing */
+	size_t size, count;
+} pmpkghash_t;
+
+#define PKGHASH_NAME(lp) (((pmpkg_t *)(lp)->data)->name)
+#define FREEPKGHASH(p) do { if(p) { free((p)->slots); FREE(p); } } while(0)
+
+/* the slot of name: the one holding it, or the empty one it would go to */
+static size_t _pacman_pkghash_slot(pmpkghash_t *hash, const char *name)
+{
+	size_t i = _pacman_strpool_hash(name, strlen(name)) & (hash->size-1);
+
+	while(hash->slots[i] && strcmp(PKGHASH_NAME(hash->slots[i]), name)) {
+		i = (i+1) & (hash->size-1);
+	}
+	return(i);
+}
+
+static int _pacman_pkghash_resize(pmpkghash_t *hash, size_t size)
+{
+	pmlist_t **slots = hash->slots;
+	size_t oldsize = hash->size, i;
+
+	if((hash->slots = _pacman_zalloc(size*sizeof(pmlist_t *))) == NULL) {
+		hash->slots = slots;
+		return(-1);
+	}
+	hash->size = size;
+	for(i = 0; i < oldsize; i++) {
+		if(slots[i]) {
+			hash->slots[_pacman_pkghash_slot(hash, PKGHASH_NAME(slots[i]))] = slots[i];
+		}
+	}
+	free(slots);
+	return(0);
+}
+
+/* indexes lp, an element of the cache, if it is the first one of its name */
+static int _pacman_pkghash_link(pmpkghash_t *hash, pmlist_t *lp)
+{
+	size_t i;
+
+	if(hash == NULL) {
+		return(0);
+	}
+	i = _pacman_pkghash_slot(hash, PKGHASH_NAME(lp));
+	if(hash->slots[i] == NULL) {
+		hash->slots[i] = lp;
+		/* keep it at most half full */
+		if(++hash->count*2 > hash->size) {
+			return(_pacman_pkghash_resize(hash, hash->size*2));
+		}
+	} else if(lp->prev == NULL || strcmp(PKGHASH_NAME(lp->prev), PKGHASH_NAME(lp))) {
+		/* the cache is sorted by name: it came before the indexed one */
+		hash->slots[i] = lp;
+	}
+	return(0);
+}
+
+/* forgets lp, an element of the cache about to be removed from it */
+static void _pacman_pkghash_unlink(pmpkghash_t *hash, pmlist_t *lp)
+{
+	size_t i, j;
+
+	if(hash == NULL) {
+		return;
+	}
+	i = _pacman_pkghash_slot(hash, PKGHASH_NAME(lp));
+	if(hash->slots[i] != lp) {
+		/* not the first one of its name */
+		return;
+	}
+	if(lp->next && !strcmp(PKGHASH_NAME(lp->next), PKGHASH_NAME(lp))) {
+		hash->slots[i] = lp->next;
+		return;
+	}
+	/* move back the entries of the run which probed past the freed slot */
+	hash->slots[i] = NULL;
+	hash->count--;
+	for(j = (i+1) & (hash->size-1); hash->slots[j]; j = (j+1) & (hash->size-1)) {
+		size_t k = _pacman_strpool_hash(PKGHASH_NAME(hash->slots[j]), strlen(PKGHASH_NAME(hash->slots[j]))) & (hash->size-1);
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+		hash->slots[i] = hash->slots[j];
+		hash->slots[j] = NULL;
+		i = j;
+	}
+}
+
+/* the name index of cache, NULL on error */
+static pmpkghash_t *_pacman_pkghash_new(pmlist_t *cache)
+{
+	pmpkghash_t *hash = _pacman_zalloc(sizeof(pmpkghash_t));
+	pmlist_t *lp;
+
+	if(hash == NULL) {
+		return(NULL);
+	}
+	hash->size = 64;
+	while(hash->size < (size_t)_pacman_list_count(cache)*2) {
+		hash->size *= 2;
+	}
+	if((hash->slots = _pacman_zalloc(hash->size*sizeof(pmlist_t *))) == NULL) {
+		FREE(hash);
+		return(NULL);
+	}
+	for(lp = cache; lp; lp = lp->next) {
+		if(_pacman_pkghash_link(hash, lp) == -1) {
+			FREEPKGHASH(hash);
+			return(NULL);
+		}
+	}
+	return(hash);
+}
+
+/* the element of the cache of db holding the first package called name */
+static pmlist_t *_pacman_db_find_pkgcache(pmdb_t *db, const char *name)
+{
+	pmlist_t *lp;
+
+	if(db->pkghash) {
+		return(db->pkghash->slots[_pacman_pkghash_slot(db->pkghash, name)]);
+	}
+	for(lp = db->pkgcache; lp; lp = lp->next) {
+		if(!strcmp(PKGHASH_NAME(lp), name)) {
+			return(lp);
+		}
+	}
+	return(NULL);
+}
+
+/* adds pkg to the cache of db, and to its index */
+static void _pacman_db_insert_pkgcache(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmlist_t *lp = _pacman_db_find_pkgcache(db, pkg->name);
+
+	db->pkgcache = _pacman_list_add_sorted(db->pkgcache, pkg, _pacman_pkg_cmp);
+	_pacman_db_add_provider(db, pkg);
+	if(db->pkghash == NULL) {
+		return;
+	}
+	/* _pacman_list_add_sorted() puts it before the ones of the same name */
+	if(lp) {
+		lp = lp->prev;
+	} else {
+		for(lp = db->pkgcache; lp->data != pkg; lp = lp->next);
+	}
+	if(_pacman_pkghash_link(db->pkghash, lp) == -1) {
+		/* fall back to walking the cache */
+		FREEPKGHASH(db->pkghash);
+	}
+}
+
+/* removes lp, an element of the cache of db, from it and from its index */
+static void _pacman_db_unlink_pkgcache(pmdb_t *db, pmlist_t *lp)
+{
+	_pacman_db_remove_provider(db, lp->data);
+	_pacman_pkghash_unlink(db->pkghash, lp);
+	db->pkgcache = _pacman_list_remove_item(db->pkgcache, lp);
+}
+
+typedef struct __pmcacheload_t {
+	pmdb_t *db;
+	pmpkg_t **pkgs;
+	unsigned int inforeq;
+} pmcacheload_t;
+
+static void _pacman_db_load_worker(void *data, unsigned int idx)
+{
+	pmcacheload_t *load = data;
+	pmpkg_t *pkg = load->pkgs[idx];
+
+	if(_pacman_db_read(load->db, load->inforeq, pkg) == -1) {
+		/* leave it to be read on demand, like the serial loader does
+		 * (a NULL slot tells the loader it ran out of memory) */
+		load->pkgs[idx] = _pacman_pkg_new(pkg->name, pkg->version);
+		FREEPKG(pkg);
+	}
+}
+
+/* by name, and in reverse scan order for equal names, which is the order
+ * _pacman_list_add_sorted() gives */
+static int _pacman_db_load_cmp(const void *p1, const void *p2)
+{
+	pmpkg_t *pkg1 = *(pmpkg_t *const *)p1, *pkg2 = *(pmpkg_t *const *)p2;
+	int ret = _pacman_pkg_cmp(pkg1, pkg2);
+
+	if(ret == 0) {
+		unsigned long idx1 = (unsigned long)pkg1->data, idx2 = (unsigned long)pkg2->data;
+		ret = (idx1 < idx2) - (idx1 > idx2);
+	}
+	return(ret);
+}
+
+/* Links the count entries of pkgs, given in scan order, into a package
+ * cache: sorted by name, with the entries of a name in reverse scan order,
+ * like inserting them one by one with _pacman_list_add_sorted() would do.
+ * The sort is skipped when the scan gave them in order already, which is
+ * the common case for the archives and the packs of the sync dbs.
+ */
+static pmlist_t *_pacman_db_link_pkgcache(pmdb_t *db, pmpkg_t **pkgs, unsigned int count)
+{
+	pmlist_t *cache = NULL;
+	unsigned int i;
+
+	for(i = 1; i < count && _pacman_pkg_cmp(pkgs[i-1], pkgs[i]) < 0; i++);
+	if(i < count) {
+		for(i = 0; i < count; i++) {
+			/* remember the scan order, for the sort */
+			pkgs[i]->data = (void *)(unsigned long)i;
+		}
+		qsort(pkgs, count, sizeof(pmpkg_t *), _pacman_db_load_cmp);
+	}
+	for(i = 0; i < count; i++) {
+		pkgs[i]->origin = PKG_FROM_CACHE;
+		pkgs[i]->data = db;
+		cache = _pacman_list_add(cache, pkgs[i]);
+	}
+	return(cache);
+}
+
+/* the entries of db, from where it was rewound to, in scan order, in *pkgs
+ * Returns their number, or -1 (with nothing left in *pkgs) if memory ran out.
+ */
+static int _pacman_db_scan_pkgs(pmdb_t *db, unsigned int inforeq, pmpkg_t ***pkgs)
+{
+	pmpkg_t *info;
+	unsigned int count = 0, alloc = 0, i;
+
+	*pkgs = NULL;
+	while((info = _pacman_db_scan(db, NULL, inforeq)) != NULL) {
+		if(count == alloc) {
+			pmpkg_t **newpkgs;
+			alloc = alloc ? alloc*2 : 256;
+			if((newpkgs = realloc(*pkgs, alloc*sizeof(pmpkg_t *))) == NULL) {
+				FREEPKG(info);
+				for(i = 0; i < count; i++) {
+					FREEPKG((*pkgs)[i]);
+				}
+				FREE(*pkgs);
+				RET_ERR(PM_ERR_MEMORY, -1);
+			}
+			*pkgs = newpkgs;
+		}
+		(*pkgs)[count++] = info;
+	}
+	return(count);
+}
+
+/* Loads the local package cache reading the entries on several threads.
+ * The result is the same as the one of the serial loader, except that the
+ * description and the dependencies are already there.
+ */
+static int _pacman_db_load_pkgcache_parallel(pmdb_t *db, unsigned int threads)
+{
+	pmcacheload_t load;
+	int count, i;
+
+	load.db = db;
+	load.inforeq = INFRQ_DESC | INFRQ_DEPENDS;
+
+	_pacman_db_rewind(db);
+	if((count = _pacman_db_scan_pkgs(db, INFRQ_NONE, &load.pkgs)) == -1) {
+		return(-1);
+	}
+
+	_pacman_parallel_for(threads, count, _pacman_db_load_worker, &load);
+	for(i = 0; i < count && load.pkgs[i] != NULL; i++);
+	if(i < count) {
+		for(i = 0; i < count; i++) {
+			FREEPKG(load.pkgs[i]);
+		}
+		free(load.pkgs);
+		RET_ERR(PM_ERR_MEMORY, -1);
+	}
+
+	db->pkgcache = _pacman_db_link_pkgcache(db, load.pkgs, count);
+	free(load.pkgs);
+	db->pkghash = _pacman_pkghash_new(db->pkgcache);
+	return(0);
+}
+
+/* the entries of db, sorted by name */
+static pmlist_t *_pacman_db_scan_pkgcache(pmdb_t *db, unsigned int inforeq)
+{
+	pmlist_t *cache;
+	pmpkg_t **pkgs;
+	int count;
+
+	_pacman_db_rewind(db);
+	if(db != handle->db_local && _pacman_packdb_usable(db)) {
+		/* the sync entries can be completed on demand straight from the
+		 * pack, by _pacman_pkg_getinfo(), like the local ones */
+		inforeq = INFRQ_NONE;
+	}
+	if((count = _pacman_db_scan_pkgs(db, inforeq, &pkgs)) == -1) {
+		return(NULL);
+	}
+	cache = _pacman_db_link_pkgcache(db, pkgs, count);
+	free(pkgs);
+	return(cache);
+}
 
 /* Returns a new package cache from db.
  * It frees the cache if it already exists.
  */
 int _pacman_db_load_pkgcache(pmdb_t *db)
 {
-	pmpkg_t *info;
-	unsigned int inforeq = 0;
+	unsigned int inforeq = 0, threads;
 
 	if(db == NULL) {
 		return(-1);
@@ -55,25 +369,110 @@ int _pacman_db_load_pkgcache(pmdb_t *db)
 
 	_pacman_db_free_pkgcache(db);
 
+	if (db == handle->db_local) {
+		/* what changes from now on gets picked up by _pacman_db_refresh_pkgcache() */
+		_pacman_dbchanges_stamp(db);
+	}
+
 	if (db != handle->db_local)
 		inforeq = INFRQ_DESC | INFRQ_DEPENDS;
+	else if ((threads = _pacman_parallel_threads()) > 1) {
+		_pacman_log(PM_LOG_DEBUG, _("loading package cache (%u threads) for repository '%s'"),
+		                        threads, db->treename);
+		return(_pacman_db_load_pkgcache_parallel(db, threads));
+	}
 	_pacman_log(PM_LOG_DEBUG, _("loading package cache (infolevel=%#x) for repository '%s'"),
 	                        inforeq, db->treename);
 
-	_pacman_db_rewind(db);
-	while((info = _pacman_db_scan(db, NULL, inforeq)) != NULL) {
-		info->origin = PKG_FROM_CACHE;
-		info->data = db;
-		/* add to the collective */
-		db->pkgcache = _pacman_list_add_sorted(db->pkgcache, info, _pacman_pkg_cmp);
+	db->pkgcache = _pacman_db_scan_pkgcache(db, inforeq);
+	db->pkghash = _pacman_pkghash_new(db->pkgcache);
+
+	return(0);
+}
+
+/* a sync db to be loaded by one of the workers */
+typedef struct __pmsyncload_t {
+	pmdb_t *db;
+	off_t size;
+	pmlist_t *cache;
+	pmpkghash_t *hash;
+} pmsyncload_t;
+
+static void _pacman_db_load_sync_worker(void *data, unsigned int idx)
+{
+	pmsyncload_t *load = (pmsyncload_t *)data+idx;
+
+	load->cache = _pacman_db_scan_pkgcache(load->db, INFRQ_DESC | INFRQ_DEPENDS);
+	load->hash = _pacman_pkghash_new(load->cache);
+}
+
+/* the biggest archives first */
+static int _pacman_db_load_sync_cmp(const void *p1, const void *p2)
+{
+	const pmsyncload_t *load1 = p1, *load2 = p2;
+
+	return((load1->size < load2->size) - (load1->size > load2->size));
+}
+
+/* Loads the package caches of the sync dbs of the list which have none yet,
+ * one db per worker, the biggest ones first.  Each worker builds a list of
+ * its own; they are handed to the dbs once all of them are done, so the
+ * callers never see a cache being built.
+ */
+int _pacman_db_load_pkgcaches(pmlist_t *dbs)
+{
+	pmsyncload_t *loads;
+	pmlist_t *i;
+	unsigned int threads = _pacman_parallel_threads(), count = 0, n;
+
+	if(threads < 2) {
+		/* they get loaded on demand */
+		return(0);
+	}
+	if((loads = _pacman_malloc((_pacman_list_count(dbs)+1)*sizeof(pmsyncload_t))) == NULL) {
+		return(-1);
 	}
+	for(i = dbs; i; i = i->next) {
+		pmdb_t *db = i->data;
+		char path[PATH_MAX];
+		struct stat buf;
 
+		if(db == handle->db_local || db->pkgcache != NULL) {
+			continue;
+		}
+		snprintf(path, PATH_MAX, "%s" PM_EXT_DB, db->path);
+		if(stat(path, &buf) == -1) {
+			/* patched by a delta, only the pack is left */
+			snprintf(path, PATH_MAX, "%s" PM_EXT_PACKDB, db->path);
+		}
+		loads[count].db = db;
+		loads[count].size = stat(path, &buf) == 0 ? buf.st_size : 0;
+		loads[count].cache = NULL;
+		loads[count].hash = NULL;
+		count++;
+	}
+	if(count > 1) {
+		qsort(loads, count, sizeof(pmsyncload_t), _pacman_db_load_sync_cmp);
+		_pacman_log(PM_LOG_DEBUG, _("loading the package caches of %u repositories (%u threads)"), count, threads);
+		_pacman_parallel_for(threads, count, _pacman_db_load_sync_worker, loads);
+		for(n = 0; n < count; n++) {
+			loads[n].db->pkgcache = loads[n].cache;
+			loads[n].db->pkghash = loads[n].hash;
+		}
+	}
+	free(loads);
 	return(0);
 }
 
 void _pacman_db_free_pkgcache(pmdb_t *db)
 {
-	if(db == NULL || db->pkgcache == NULL) {
+	if(db == NULL) {
+		return;
+	}
+	FREE(db->changes);
+	FREEPKGHASH(db->pkghash);
+	_pacman_db_free_provcache(db);
+	if(db->pkgcache == NULL) {
 		return;
 	}
 
@@ -87,6 +486,106 @@ void _pacman_db_free_pkgcache(pmdb_t *db)
 	}
 }
 
+/* reloads the entries (name-version) of dirnames in the package cache of db:
+ * the ones there are retired, then the ones still in the db are put back,
+ * to be read again on demand */
+static void _pacman_db_reload_pkgcache(pmdb_t *db, pmlist_t *dirnames)
+{
+	pmlist_t *i;
+
+	for(i = dirnames; i; i = i->next) {
+		char name[PKG_NAME_LEN], version[PKG_VERSION_LEN], path[PATH_MAX];
+		const pmpackentry_t *entry;
+		struct stat buf;
+		pmpkg_t *pkg;
+		pmlist_t *lp, *next;
+		int exists;
+
+		if(_pacman_pkg_splitname(i->data, name, version, 0) == -1 ||
+			(pkg = _pacman_pkg_new(name, version)) == NULL) {
+			continue;
+		}
+		/* the entries of a name are next to each other */
+		for(lp = _pacman_db_find_pkgcache(db, name); lp && !strcmp(PKGHASH_NAME(lp), name); lp = next) {
+			pmpkg_t *data = lp->data;
+			next = lp->next;
+			if(!strcmp(data->version, version)) {
+				_pacman_db_unlink_pkgcache(db, lp);
+				db->retired = _pacman_list_add(db->retired, data);
+			}
+		}
+		if(db == handle->db_local) {
+			snprintf(path, PATH_MAX, "%s/%s", db->path, (char *)i->data);
+			exists = (stat(path, &buf) == 0 && S_ISDIR(buf.st_mode));
+		} else {
+			exists = (entry = _pacman_packdb_find(db->pack, name)) != NULL &&
+				!strcmp(_pacman_packdb_string(db->pack, entry->version), version);
+		}
+		if(exists) {
+			pkg->origin = PKG_FROM_CACHE;
+			pkg->data = db;
+			_pacman_db_insert_pkgcache(db, pkg);
+		} else {
+			FREEPKG(pkg);
+		}
+	}
+	if(db->grpcache) {
+		_pacman_db_free_grpcache(db);
+	}
+}
+
+/* Brings the package cache of the local db up to date with what other
+ * processes changed since it was loaded: only the entries they added,
+ * modified or removed are reloaded, the others stay as they are.
+ * The entries replaced are kept until the db is unregistered, as the
+ * frontend may still hold them.  This is only called when a transaction
+ * starts or ends, and by pacman_db_refresh().
+ */
+int _pacman_db_refresh_pkgcache(pmdb_t *db)
+{
+	pmlist_t *dirnames;
+	int ret;
+
+	if(db == NULL || db != handle->db_local || db->pkgcache == NULL) {
+		return(0);
+	}
+
+	if((ret = _pacman_dbchanges_poll(db, &dirnames)) == 0) {
+		return(0);
+	}
+	if(ret == -1) {
+		_pacman_log(PM_LOG_DEBUG, _("repository '%s' changed, reloading its package cache"), db->treename);
+		db->retired = _pacman_list_join(db->retired, db->pkgcache);
+		db->pkgcache = NULL;
+		return(_pacman_db_load_pkgcache(db));
+	}
+
+	_pacman_log(PM_LOG_DEBUG, _("reloading %d changed entries of the '%s' package cache"),
+	                        _pacman_list_count(dirnames), db->treename);
+	_pacman_db_reload_pkgcache(db, dirnames);
+	FREELIST(dirnames);
+	return(0);
+}
+
+/* Patches the package cache of a sync db after a delta patched its pack
+ * (which has to be reopened first): dirnames are the entries the delta
+ * removed, added or changed.  Like for the local db, the entries replaced are
+ * kept until the db is unregistered.
+ */
+void _pacman_db_patch_pkgcache(pmdb_t *db, pmlist_t *dirnames)
+{
+	if(db == NULL || db->pkgcache == NULL) {
+		return;
+	}
+	if(!_pacman_packdb_usable(db)) {
+		_pacman_db_free_pkgcache(db);
+		return;
+	}
+	_pacman_log(PM_LOG_DEBUG, _("reloading %d changed entries of the '%s' package cache"),
+	                        _pacman_list_count(dirnames), db->treename);
+	_pacman_db_reload_pkgcache(db, dirnames);
+}
+
 pmlist_t *_pacman_db_get_pkgcache(pmdb_t *db)
 {
 	if(db == NULL) {
@@ -113,7 +612,7 @@ int _pacman_db_add_pkgincache(pmdb_t *db, pmpkg_t *pkg)
 		return(-1);
 	}
 	_pacman_log(PM_LOG_DEBUG, _("adding entry '%s' in '%s' cache"), newpkg->name, db->treename);
-	db->pkgcache = _pacman_list_add_sorted(db->pkgcache, newpkg, _pacman_pkg_cmp);
+	_pacman_db_insert_pkgcache(db, newpkg);
 
 	_pacman_db_free_grpcache(db);
 
@@ -122,17 +621,19 @@ int _pacman_db_add_pkgincache(pmdb_t *db, pmpkg_t *pkg)
 
 int _pacman_db_remove_pkgfromcache(pmdb_t *db, pmpkg_t *pkg)
 {
+	pmlist_t *lp;
 	pmpkg_t *data;
 
 	if(db == NULL || pkg == NULL) {
 		return(-1);
 	}
 
-	db->pkgcache = _pacman_list_remove(db->pkgcache, pkg, _pacman_pkg_cmp, (void **)&data);
-	if(data == NULL) {
+	if((lp = _pacman_db_find_pkgcache(db, pkg->name)) == NULL) {
 		/* package not found */
 		return(-1);
 	}
+	data = lp->data;
+	_pacman_db_unlink_pkgcache(db, lp);
 
 	_pacman_log(PM_LOG_DEBUG, _("removing entry '%s' from '%s' cache"), pkg->name, db->treename);
 	FREEPKG(data);
@@ -144,18 +645,38 @@ int _pacman_db_remove_pkgfromcache(pmdb_t *db, pmpkg_t *pkg)
 
 pmpkg_t *_pacman_db_get_pkgfromcache(pmdb_t *db, const char *target)
 {
-	if(db == NULL) {
+	pmlist_t *lp;
+
+	if(db == NULL || target == NULL) {
 		return(NULL);
 	}
 
-	return(_pacman_pkg_isin(target, _pacman_db_get_pkgcache(db)));
+	if(_pacman_db_get_pkgcache(db) == NULL) {
+		return(NULL);
+	}
+	lp = _pacman_db_find_pkgcache(db, target);
+
+	return(lp ? lp->data : NULL);
+}
+
+/* by name */
+static int _pacman_db_grp_cmp(const void *p1, const void *p2)
+{
+	return(_pacman_grp_cmp(*(pmgrp_t *const *)p1, *(pmgrp_t *const *)p2));
 }
 
 /* Returns a new group cache from db.
+ * The groups are gathered in a single pass over the package cache, through
+ * a hash of the groups met so far; as the package cache is sorted, the
+ * packages of each group come in order, and only the groups need a sort.
  */
 int _pacman_db_load_grpcache(pmdb_t *db)
 {
 	pmlist_t *lp;
+	/* the groups met so far: by name in slots (open addressing, linear
+	 * probing), in the order they were met in grps */
+	pmgrp_t **slots, **grps = NULL;
+	unsigned int count = 0, max = 0, size = 64, k;
 
 	if(db == NULL) {
 		return(-1);
@@ -167,6 +688,9 @@ int _pacman_db_load_grpcache(pmdb_t *db)
 
 	_pacman_log(PM_LOG_DEBUG, _("loading group cache for repository '%s'"), db->treename);
 
+	if((slots = _pacman_zalloc(size*sizeof(pmgrp_t *))) == NULL) {
+		return(-1);
+	}
 	for(lp = db->pkgcache; lp; lp = lp->next) {
 		pmlist_t *i;
 		pmpkg_t *pkg = lp->data;
@@ -176,29 +700,70 @@ int _pacman_db_load_grpcache(pmdb_t *db)
 		}
 
 		for(i = pkg->groups; i; i = i->next) {
-			if(!_pacman_list_is_strin(i->data, db->grpcache)) {
-				pmgrp_t *grp = _pacman_grp_new();
-
-				STRNCPY(grp->name, (char *)i->data, GRP_NAME_LEN);
-				grp->packages = _pacman_list_add_sorted(grp->packages, pkg->name, _pacman_grp_cmp);
-				db->grpcache = _pacman_list_add_sorted(db->grpcache, grp, _pacman_grp_cmp);
-			} else {
-				pmlist_t *j;
+			const char *name = i->data;
+			pmgrp_t *grp;
 
-				for(j = db->grpcache; j; j = j->next) {
-					pmgrp_t *grp = j->data;
-
-					if(strcmp(grp->name, i->data) == 0) {
-						if(!_pacman_list_is_strin(pkg->name, grp->packages)) {
-							grp->packages = _pacman_list_add_sorted(grp->packages, (char *)pkg->name, _pacman_grp_cmp);
+			k = _pacman_strpool_hash(name, strlen(name)) & (size-1);
+			while((grp = slots[k]) && strcmp(grp->name, name)) {
+				k = (k+1) & (size-1);
+			}
+			if(grp == NULL) {
+				if(count == max) {
+					pmgrp_t **newgrps;
+					max = max ? max*2 : 64;
+					if((newgrps = realloc(grps, max*sizeof(pmgrp_t *))) == NULL) {
+						goto error;
+					}
+					grps = newgrps;
+				}
+				if((grp = _pacman_grp_new()) == NULL) {
+					goto error;
+				}
+				STRNCPY(grp->name, name, GRP_NAME_LEN);
+				slots[k] = grp;
+				grps[count++] = grp;
+				/* keep it at most half full */
+				if(count*2 > size) {
+					pmgrp_t **newslots = _pacman_zalloc(size*2*sizeof(pmgrp_t *));
+					if(newslots == NULL) {
+						goto error;
+					}
+					size *= 2;
+					for(k = 0; k < count; k++) {
+						unsigned int j = _pacman_strpool_hash(grps[k]->name, strlen(grps[k]->name)) & (size-1);
+						while(newslots[j]) {
+							j = (j+1) & (size-1);
 						}
+						newslots[j] = grps[k];
 					}
+					free(slots);
+					slots = newslots;
 				}
 			}
+			/* the packages come sorted: a name already there is the last one */
+			if(grp->packages == NULL || strcmp(grp->packages->last->data, pkg->name)) {
+				grp->packages = _pacman_list_add(grp->packages, (char *)pkg->name);
+			}
 		}
 	}
+	free(slots);
+
+	qsort(grps, count, sizeof(pmgrp_t *), _pacman_db_grp_cmp);
+	for(k = 0; k < count; k++) {
+		db->grpcache = _pacman_list_add(db->grpcache, grps[k]);
+	}
+	free(grps);
 
 	return(0);
+
+error:
+	for(k = 0; k < count; k++) {
+		FREELISTPTR(grps[k]->packages);
+		FREEGRP(grps[k]);
+	}
+	free(grps);
+	free(slots);
+	RET_ERR(PM_ERR_MEMORY, -1);
 }
 
 void _pacman_db_free_grpcache(pmdb_t *db)
@@ -28,9 +28,12 @@
 
 /* packages */
 int _pacman_db_load_pkgcache(pmdb_t *db);
+int _pacman_db_load_pkgcaches(pmlist_t *dbs);
 void _pacman_db_free_pkgcache(pmdb_t *db);
 int _pacman_db_add_pkgincache(pmdb_t *db, pmpkg_t *pkg);
 int _pacman_db_remove_pkgfromcache(pmdb_t *db, pmpkg_t *pkg);
+int _pacman_db_refresh_pkgcache(pmdb_t *db);
+void _pacman_db_patch_pkgcache(pmdb_t *db, pmlist_t *dirnames);
 pmlist_t *_pacman_db_get_pkgcache(pmdb_t *db);
 pmpkg_t *_pacman_db_get_pkgfromcache(pmdb_t *db, const char *target);
 /* groups */
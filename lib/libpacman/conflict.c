@@ -216,34 +216,37 @@ pmlist_t *_pacman_checkconflicts(pmtrans_t *trans, pmdb_t *db, pmlist_t *package
 
 /* Returns a pmlist_t* of file conflicts.
  *  Hooray for set-intersects!
- *  Pre-condition: both lists are sorted!
+ *  File lists are always sorted.
  */
-static pmlist_t *chk_fileconflicts(pmlist_t *filesA, pmlist_t *filesB)
+static pmlist_t *chk_fileconflicts(pmfilelist_t *filesA, pmfilelist_t *filesB)
 {
 	pmlist_t *ret = NULL;
-	pmlist_t *pA = filesA, *pB = filesB;
+	pmfileiter_t iA, iB;
+	const char *strA, *strB;
 
-	while(pA && pB) {
-		const char *strA = pA->data;
-		const char *strB = pB->data;
+	_pacman_filelist_iter(filesA, &iA);
+	_pacman_filelist_iter(filesB, &iB);
+	strA = _pacman_filelist_next(&iA);
+	strB = _pacman_filelist_next(&iB);
+	while(strA && strB) {
 		/* skip directories, we don't care about dir conflicts */
 		if(strA[strlen(strA)-1] == '/') {
-			pA = pA->next;
+			strA = _pacman_filelist_next(&iA);
 		} else if(strB[strlen(strB)-1] == '/') {
-			pB = pB->next;
+			strB = _pacman_filelist_next(&iB);
 		} else {
 			int cmp = strcmp(strA, strB);
 			if(cmp < 0) {
 				/* item only in filesA, ignore it */
-				pA = pA->next;
+				strA = _pacman_filelist_next(&iA);
 			} else if(cmp > 0) {
 				/* item only in filesB, ignore it */
-				pB = pB->next;
+				strB = _pacman_filelist_next(&iB);
 			} else {
 				/* item in both, record it */
 				ret = _pacman_list_add(ret, strdup(strA));
-				pA = pA->next;
-				pB = pB->next;
+				strA = _pacman_filelist_next(&iA);
+				strB = _pacman_filelist_next(&iB);
 			}
 	  }
 	}
@@ -254,6 +257,7 @@ static pmlist_t *chk_fileconflicts(pmlist_t *filesA, pmlist_t *filesB)
 pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pmlist_t **skip_list)
 {
 	pmlist_t *i, *j, *k;
+	pmfileiter_t iter;
 	char *filestr = NULL;
 	char path[PATH_MAX+1];
 	struct stat buf;
@@ -277,7 +281,7 @@ pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pm
 		for(j = i; j; j = j->next) {
 			pmpkg_t *p2 = (pmpkg_t*)j->data;
 			if(strcmp(p1->name, p2->name)) {
-				pmlist_t *ret = chk_fileconflicts(p1->files, p2->files);
+				pmlist_t *ret = chk_fileconflicts(p1->filelist, p2->filelist);
 				for(k = ret; k; k = k->next) {
 						pmconflict_t *conflict = _pacman_malloc(sizeof(pmconflict_t));
 						if(conflict == NULL) {
@@ -296,8 +300,8 @@ pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pm
 		/* CHECK 2: check every target against the filesystem */
 		p = (pmpkg_t*)i->data;
 		dbpkg = NULL;
-		for(j = p->files; j; j = j->next) {
-			filestr = (char*)j->data;
+		_pacman_filelist_iter(p->filelist, &iter);
+		while((filestr = (char *)_pacman_filelist_next(&iter))) {
 			snprintf(path, PATH_MAX, "%s%s", root, filestr);
 			/* is this target a file or directory? */
 			if(path[strlen(path)-1] == '/') {
@@ -318,7 +322,7 @@ pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pm
 						_pacman_log(PM_LOG_DEBUG, _("loading FILES info for '%s'"), dbpkg->name);
 						_pacman_db_read(db, INFRQ_FILES, dbpkg);
 					}
-					if(dbpkg && _pacman_list_is_strin(j->data, dbpkg->files)) {
+					if(dbpkg && _pacman_filelist_contains(dbpkg->filelist, filestr)) {
 						ok = 1;
 					}
 					/* Check if the conflicting file has been moved to another package/target */
@@ -335,7 +339,7 @@ pmlist_t *_pacman_db_find_conflicts(pmdb_t *db, pmtrans_t *trans, char *root, pm
 									_pacman_db_read(db, INFRQ_FILES, dbpkg2);
 								}
 								/* If it used to exist in there, but doesn't anymore */
-								if(dbpkg2 && !_pacman_list_is_strin(filestr, p2->files) && _pacman_list_is_strin(filestr, dbpkg2->files)) {
+								if(dbpkg2 && !_pacman_filelist_contains(p2->filelist, filestr) && _pacman_filelist_contains(dbpkg2->filelist, filestr)) {
 									ok = 1;
 									/* Add to the "skip list" of files that we shouldn't remove during an upgrade.
 									 *
@@ -68,8 +68,17 @@ pmdb_t *_pacman_db_new(char *root, char* dbpath, const char *treename)
 	STRNCPY(db->treename, treename, PATH_MAX);
 
 	db->pkgcache = NULL;
+	db->retired = NULL;
+	db->pkghash = NULL;
+	db->provcache = NULL;
 	db->grpcache = NULL;
 	db->servers = NULL;
+	db->combined = 0;
+	db->pack = NULL;
+	db->index = NULL;
+	db->journal = NULL;
+	db->changes = NULL;
+	db->files = NULL;
 
 	return(db);
 }
@@ -79,6 +88,7 @@ void _pacman_db_free(void *data)
 	pmdb_t *db = data;
 
 	FREELISTSERVERS(db->servers);
+	FREELISTPKGS(db->retired);
 	free(db->path);
 	free(db);
 
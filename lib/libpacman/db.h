@@ -37,15 +37,32 @@
 
 #define DB_O_CREATE 0x01
 
+/* combined record of a local entry (CombinedDB): a header line giving the
+ * length of the two sections, then the content of desc and depends */
+#define PM_DB_META "meta"
+#define PM_DB_META_MAGIC "%META%"
+/* created next to the local directory before its first combined record:
+ * without it (and without CombinedDB) entries are not probed for one */
+#define PM_EXT_META ".meta"
+
 /* Database */
 typedef struct __pmdb_t {
 	char *path;
 	char treename[PATH_MAX];
 	void *handle;
 	pmlist_t *pkgcache;
+	pmlist_t *retired; /* entries a refresh dropped from pkgcache, the frontend may still use them */
+	struct __pmpkghash_t *pkghash; /* name -> first entry of pkgcache */
+	struct __pmprovcache_t *provcache; /* provision -> entries of pkgcache */
 	pmlist_t *grpcache;
 	pmlist_t *servers;
 	char lastupdate[16];
+	unsigned short combined; /* entries of the local db may have a combined record */
+	struct __pmpackdb_t *pack; /* packed copy of the local db, if any */
+	struct __pmdbindex_t *index; /* name -> directory index of the local db */
+	struct __pmjournal_t *journal; /* write-ahead journal of the local db */
+	struct __pmdbchanges_t *changes; /* generation the package cache was loaded at */
+	struct __pmfilesdb_t *files; /* path -> package index of a sync db */
 } pmdb_t;
 
 pmdb_t *_pacman_db_new(char *root, char *dbpath, const char *treename);
@@ -62,6 +79,8 @@ pmpkg_t *_pacman_db_scan(pmdb_t *db, const char *target, unsigned int inforeq);
 int _pacman_db_read(pmdb_t *db, unsigned int inforeq, pmpkg_t *info);
 int _pacman_db_write(pmdb_t *db, pmpkg_t *info, unsigned int inforeq);
 int _pacman_db_remove(pmdb_t *db, pmpkg_t *info);
+int _pacman_db_meta_split(const char *data, size_t len, size_t *desclen, size_t *deplen);
+struct __pmfilelist_t *_pacman_db_parse_filelist(const char *data, size_t len);
 int _pacman_db_getlastupdate(pmdb_t *db, char *ts);
 int _pacman_db_setlastupdate(pmdb_t *db, char *ts);
 pmdb_t *_pacman_db_register(const char *treename, pacman_cb_db_register callback);
@@ -269,8 +269,10 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
 			}
 
 			for(j = _pacman_pkg_getinfo(tp, PM_PKG_DEPENDS); j; j = j->next) {
+				const char *pooled;
 				/* split into name/version pairs */
 				_pacman_splitdep((char *)j->data, &depend);
+				pooled = _pacman_strpool_key(handle->strpool, depend.name);
 				found = 0;
 				/* check database for literal packages */
 				for(k = _pacman_db_get_pkgcache(db); k && !found; k = k->next) {
@@ -353,9 +355,9 @@ pmlist_t *_pacman_checkdeps(pmtrans_t *trans, pmdb_t *db, unsigned char op, pmli
  				for(k = packages; k && !found; k = k->next) {
  					pmpkg_t *p = (pmpkg_t *)k->data;
  					/* see if the package names match OR if p provides depend.name */
- 					if(!strcmp(p->name, depend.name) || _pacman_list_is_strin(depend.name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
-						if(depend.mod == PM_DEP_MOD_ANY ||
-								_pacman_list_is_strin(depend.name, _pacman_pkg_getinfo(p, PM_PKG_PROVIDES))) {
+ 					int provides = _pacman_pkg_provides(p, depend.name, pooled);
+					if(!strcmp(p->name, depend.name) || provides) {
+						if(depend.mod == PM_DEP_MOD_ANY || provides) {
 							/* depend accepts any version or p provides depend (provides - by
 							 * definition - is for all versions) */
 							found = 1;
@@ -686,7 +688,7 @@ int _pacman_depcmp(pmpkg_t *pkg, pmdepend_t *dep)
 	const char *mod = "~=";
 
 	if(strcmp(pkg->name, dep->name) == 0
-	    	|| _pacman_list_is_strin(dep->name, _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES))) {
+	    	|| _pacman_pkg_provides(pkg, dep->name, _pacman_strpool_key(handle->strpool, dep->name))) {
 			if(dep->mod == PM_DEP_MOD_ANY) {
 				equal = 1;
 			} else {
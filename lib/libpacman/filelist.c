@@ -0,0 +1,307 @@
+/*
+ *  filelist.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The file list of a package is kept sorted and front-coded in a single
+ * block: each path is stored as the number of bytes it shares with the
+ * previous one (a varint) followed by the rest of it, NUL-terminated.  Every
+ * FILELIST_RESTART-th path is stored whole, so that a path can be looked up
+ * with a binary search over those, then a short scan.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "error.h"
+#include "util.h"
+#include "filelist.h"
+
+void _pacman_filebuilder_init(pmfilebuilder_t *builder)
+{
+	memset(builder, 0, sizeof(pmfilebuilder_t));
+	builder->sorted = 1;
+}
+
+void _pacman_filebuilder_free(pmfilebuilder_t *builder)
+{
+	FREE(builder->buf);
+	FREE(builder->offsets);
+	_pacman_filebuilder_init(builder);
+}
+
+int _pacman_filebuilder_add(pmfilebuilder_t *builder, const char *path, size_t len)
+{
+	if(len >= PATH_MAX) {
+		len = PATH_MAX-1;
+	}
+	if(builder->len+len+1 > builder->size) {
+		size_t size = builder->size ? builder->size*2 : 4096;
+		char *buf;
+		while(size < builder->len+len+1) {
+			size *= 2;
+		}
+		if((buf = realloc(builder->buf, size)) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		builder->buf = buf;
+		builder->size = size;
+	}
+	if(builder->count == builder->max) {
+		unsigned int max = builder->max ? builder->max*2 : 64;
+		size_t *offsets = realloc(builder->offsets, max*sizeof(size_t));
+		if(offsets == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		builder->offsets = offsets;
+		builder->max = max;
+	}
+	memcpy(builder->buf+builder->len, path, len);
+	builder->buf[builder->len+len] = '\0';
+	if(builder->count && builder->sorted &&
+		strcmp(builder->buf+builder->offsets[builder->count-1], builder->buf+builder->len) > 0) {
+		builder->sorted = 0;
+	}
+	builder->offsets[builder->count++] = builder->len;
+	builder->len += len+1;
+	return(0);
+}
+
+static int filelist_strcmp(const void *p1, const void *p2)
+{
+	return(strcmp(*(const char **)p1, *(const char **)p2));
+}
+
+/* paths are shorter than PATH_MAX, so the shared length takes two bytes at
+ * most */
+static char *filelist_putshared(char *ptr, size_t shared)
+{
+	if(shared >= 0x80) {
+		*ptr++ = (char)(0x80 | (shared & 0x7f));
+		shared >>= 7;
+	}
+	*ptr++ = (char)shared;
+	return(ptr);
+}
+
+static const char *filelist_getshared(const char *ptr, size_t *shared)
+{
+	*shared = (unsigned char)*ptr++;
+	if(*shared & 0x80) {
+		*shared = (*shared & 0x7f) | ((size_t)(unsigned char)*ptr++ << 7);
+	}
+	return(ptr);
+}
+
+/* front-codes the collected paths, and resets the builder
+ * Returns NULL if there were no paths (or on error).
+ */
+pmfilelist_t *_pacman_filebuilder_finish(pmfilebuilder_t *builder)
+{
+	pmfilelist_t *list = NULL;
+	const char **paths = NULL, *prev = "";
+	unsigned int i;
+	char *ptr;
+
+	if(builder->count == 0) {
+		_pacman_filebuilder_free(builder);
+		return(NULL);
+	}
+	if((paths = _pacman_malloc(builder->count*sizeof(char *))) == NULL ||
+		(list = _pacman_zalloc(sizeof(pmfilelist_t))) == NULL ||
+		(list->restarts = _pacman_malloc(((builder->count-1)/FILELIST_RESTART+1)*sizeof(unsigned int))) == NULL ||
+		(list->data = _pacman_malloc(builder->len+2*builder->count)) == NULL) {
+		FREE(paths);
+		FREEFILELIST(list);
+		_pacman_filebuilder_free(builder);
+		return(NULL);
+	}
+	for(i = 0; i < builder->count; i++) {
+		paths[i] = builder->buf+builder->offsets[i];
+	}
+	if(!builder->sorted) {
+		qsort(paths, builder->count, sizeof(char *), filelist_strcmp);
+	}
+
+	ptr = list->data;
+	for(i = 0; i < builder->count; i++) {
+		size_t shared = 0, len;
+		if(i % FILELIST_RESTART == 0) {
+			list->restarts[i/FILELIST_RESTART] = ptr-list->data;
+		} else {
+			while(prev[shared] && prev[shared] == paths[i][shared]) {
+				shared++;
+			}
+		}
+		prev = paths[i];
+		ptr = filelist_putshared(ptr, shared);
+		len = strlen(paths[i]+shared)+1;
+		memcpy(ptr, paths[i]+shared, len);
+		ptr += len;
+	}
+	list->count = builder->count;
+	list->len = ptr-list->data;
+	if((ptr = realloc(list->data, list->len)) != NULL) {
+		list->data = ptr;
+	}
+	FREE(paths);
+	_pacman_filebuilder_free(builder);
+	return(list);
+}
+
+pmfilelist_t *_pacman_filelist_new(pmlist_t *paths)
+{
+	pmfilebuilder_t builder;
+	pmlist_t *i;
+
+	_pacman_filebuilder_init(&builder);
+	for(i = paths; i; i = i->next) {
+		if(_pacman_filebuilder_add(&builder, i->data, strlen(i->data)) == -1) {
+			_pacman_filebuilder_free(&builder);
+			return(NULL);
+		}
+	}
+	return(_pacman_filebuilder_finish(&builder));
+}
+
+pmfilelist_t *_pacman_filelist_dup(const pmfilelist_t *list)
+{
+	pmfilelist_t *newlist;
+	size_t nrestarts;
+
+	if(list == NULL || (newlist = _pacman_zalloc(sizeof(pmfilelist_t))) == NULL) {
+		return(NULL);
+	}
+	nrestarts = (list->count-1)/FILELIST_RESTART+1;
+	if((newlist->data = _pacman_malloc(list->len)) == NULL ||
+		(newlist->restarts = _pacman_malloc(nrestarts*sizeof(unsigned int))) == NULL) {
+		_pacman_filelist_free(newlist);
+		return(NULL);
+	}
+	memcpy(newlist->data, list->data, list->len);
+	memcpy(newlist->restarts, list->restarts, nrestarts*sizeof(unsigned int));
+	newlist->len = list->len;
+	newlist->count = list->count;
+	return(newlist);
+}
+
+void _pacman_filelist_free(pmfilelist_t *list)
+{
+	if(list) {
+		FREE(list->data);
+		FREE(list->restarts);
+		free(list);
+	}
+}
+
+void _pacman_filelist_iter(const pmfilelist_t *list, pmfileiter_t *iter)
+{
+	iter->list = list;
+	iter->pos = 0;
+	iter->idx = 0;
+	iter->shared = 0;
+	iter->path[0] = '\0';
+}
+
+/* the next path of the list, valid until the following call
+ * Returns NULL at the end of the list.
+ */
+const char *_pacman_filelist_next(pmfileiter_t *iter)
+{
+	const pmfilelist_t *list = iter->list;
+	const char *ptr;
+	size_t shared, len;
+
+	if(list == NULL || iter->idx >= list->count) {
+		return(NULL);
+	}
+	ptr = filelist_getshared(list->data+iter->pos, &shared);
+	len = strlen(ptr);
+	iter->pos = ptr+len+1-list->data;
+	iter->idx++;
+	if(shared == 0) {
+		/* stored whole, it may share a prefix with the previous one anyway */
+		while(iter->path[shared] && iter->path[shared] == ptr[shared]) {
+			shared++;
+		}
+		ptr += shared;
+		len -= shared;
+	}
+	memcpy(iter->path+shared, ptr, len+1);
+	iter->shared = shared;
+	return(iter->path);
+}
+
+int _pacman_filelist_contains(const pmfilelist_t *list, const char *path)
+{
+	pmfileiter_t iter;
+	unsigned int lo = 0, hi, i;
+	const char *str;
+
+	if(list == NULL) {
+		return(0);
+	}
+	/* the last path stored whole not greater than the one we look for */
+	hi = (list->count-1)/FILELIST_RESTART+1;
+	while(hi-lo > 1) {
+		unsigned int mid = (lo+hi)/2;
+		/* the shared length of those is a single 0 byte */
+		if(strcmp(list->data+list->restarts[mid]+1, path) <= 0) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	_pacman_filelist_iter(list, &iter);
+	iter.pos = list->restarts[lo];
+	iter.idx = lo*FILELIST_RESTART;
+	for(i = 0; i < FILELIST_RESTART && (str = _pacman_filelist_next(&iter)); i++) {
+		int cmp = strcmp(str, path);
+		if(cmp == 0) {
+			return(1);
+		} else if(cmp > 0) {
+			break;
+		}
+	}
+	return(0);
+}
+
+/* the paths as a list of strings */
+pmlist_t *_pacman_filelist_expand(const pmfilelist_t *list)
+{
+	pmfileiter_t iter;
+	pmlist_t *ret = NULL;
+	const char *str;
+
+	_pacman_filelist_iter(list, &iter);
+	while((str = _pacman_filelist_next(&iter))) {
+		ret = _pacman_list_add(ret, strdup(str));
+	}
+	return(ret);
+}
+
+unsigned int _pacman_filelist_count(const pmfilelist_t *list)
+{
+	return(list ? list->count : 0);
+}
+
+/* vim: set ts=2 sw=2 noet: */
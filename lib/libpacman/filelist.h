@@ -0,0 +1,73 @@
+/*
+ *  filelist.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_FILELIST_H
+#define _PACMAN_FILELIST_H
+
+#include <limits.h>
+
+#include "list.h"
+
+/* every FILELIST_RESTART-th path is stored whole */
+#define FILELIST_RESTART 16
+
+/* a sorted list of paths, front-coded */
+typedef struct __pmfilelist_t {
+	char *data;
+	size_t len;
+	unsigned int count;
+	unsigned int *restarts; /* offset of each path stored whole */
+} pmfilelist_t;
+
+/* paths collected before they get front-coded */
+typedef struct __pmfilebuilder_t {
+	char *buf;
+	size_t len, size;
+	size_t *offsets;
+	unsigned int count, max;
+	int sorted;
+} pmfilebuilder_t;
+
+typedef struct __pmfileiter_t {
+	const pmfilelist_t *list;
+	size_t pos;
+	unsigned int idx;
+	size_t shared; /* bytes the current path shares with the previous one */
+	char path[PATH_MAX];
+} pmfileiter_t;
+
+#define FREEFILELIST(p) do { if(p) { _pacman_filelist_free(p); p = NULL; } } while(0)
+
+void _pacman_filebuilder_init(pmfilebuilder_t *builder);
+int _pacman_filebuilder_add(pmfilebuilder_t *builder, const char *path, size_t len);
+void _pacman_filebuilder_free(pmfilebuilder_t *builder);
+pmfilelist_t *_pacman_filebuilder_finish(pmfilebuilder_t *builder);
+pmfilelist_t *_pacman_filelist_new(pmlist_t *paths);
+pmfilelist_t *_pacman_filelist_dup(const pmfilelist_t *list);
+void _pacman_filelist_free(pmfilelist_t *list);
+void _pacman_filelist_iter(const pmfilelist_t *list, pmfileiter_t *iter);
+const char *_pacman_filelist_next(pmfileiter_t *iter);
+int _pacman_filelist_contains(const pmfilelist_t *list, const char *path);
+pmlist_t *_pacman_filelist_expand(const pmfilelist_t *list);
+unsigned int _pacman_filelist_count(const pmfilelist_t *list);
+
+#endif /* _PACMAN_FILELIST_H */
+
+/* vim: set ts=2 sw=2 noet: */
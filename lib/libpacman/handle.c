@@ -53,6 +53,9 @@ pmhandle_t *_pacman_handle_new()
 
 	ph->lckfd = -1;
 	ph->maxtries = 1;
+	ph->threads = 1;
+	/* without it, the package lists own their strings */
+	ph->strpool = _pacman_strpool_new();
 
 #ifndef CYGWIN
 	/* see if we're root or not */
@@ -117,6 +120,8 @@ int _pacman_handle_free(pmhandle_t *ph)
 	FREELIST(ph->ignorepkg);
 	FREELIST(ph->holdpkg);
 	FREELIST(ph->needles);
+	_pacman_strpool_stats(ph->strpool);
+	FREESTRPOOL(ph->strpool);
 	free(ph);
 
 	return(0);
@@ -338,6 +343,33 @@ int _pacman_handle_set_option(pmhandle_t *ph, unsigned char val, unsigned long d
 			ph->maxtries = (unsigned short)data;
 			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_MAXTRIES set to '%d'"), ph->maxtries);
 		break;
+		case PM_OPT_PACKEDDB:
+			ph->packeddb = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_PACKEDDB set to '%d'"), ph->packeddb);
+		break;
+		case PM_OPT_THREADS:
+			ph->threads = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_THREADS set to '%d'"), ph->threads);
+		break;
+		case PM_OPT_COMBINEDDB:
+			ph->combineddb = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_COMBINEDDB set to '%d'"), ph->combineddb);
+		break;
+		case PM_OPT_DBTESTCB:
+			ph->testcb = (pacman_cb_db_test)data;
+		break;
+		case PM_OPT_COMPACTFILES:
+			ph->compactfiles = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_COMPACTFILES set to '%d'"), ph->compactfiles);
+		break;
+		case PM_OPT_DELTADB:
+			ph->deltadb = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_DELTADB set to '%d'"), ph->deltadb);
+		break;
+		case PM_OPT_FILESDB:
+			ph->filesdb = (unsigned short)data;
+			_pacman_log(PM_LOG_FLOW2, _("PM_OPT_FILESDB set to '%d'"), ph->filesdb);
+		break;
 		default:
 			RET_ERR(PM_ERR_WRONG_ARGS, -1);
 	}
@@ -386,6 +418,13 @@ int _pacman_handle_get_option(pmhandle_t *ph, unsigned char val, long *data)
 		case PM_OPT_NOPASSIVEFTP: *data = ph->nopassiveftp; break;
 		case PM_OPT_CHOMP: *data = ph->chomp; break;
 		case PM_OPT_MAXTRIES: *data = ph->maxtries; break;
+		case PM_OPT_PACKEDDB: *data = ph->packeddb; break;
+		case PM_OPT_THREADS: *data = ph->threads; break;
+		case PM_OPT_COMBINEDDB: *data = ph->combineddb; break;
+		case PM_OPT_DBTESTCB: *data = (long)ph->testcb; break;
+		case PM_OPT_COMPACTFILES: *data = ph->compactfiles; break;
+		case PM_OPT_DELTADB: *data = ph->deltadb; break;
+		case PM_OPT_FILESDB: *data = ph->filesdb; break;
 		default:
 			RET_ERR(PM_ERR_WRONG_ARGS, -1);
 		break;
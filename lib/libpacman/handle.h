@@ -32,6 +32,7 @@ typedef struct __pmhandle_t pmhandle_t;
 #include "list.h"
 #include "db.h"
 #include "trans.h"
+#include "strpool.h"
 
 typedef enum __pmaccess_t {
 	PM_ACCESS_RO,
@@ -43,6 +44,7 @@ struct __pmhandle_t {
 	uid_t uid;
 	pmdb_t *db_local;
 	pmlist_t *dbs_sync; /* List of (pmdb_t *) */
+	pmstrpool_t *strpool; /* the strings the package lists of the dbs share */
 	FILE *logfd;
 	int lckfd;
 	pmtrans_t *trans;
@@ -66,6 +68,13 @@ struct __pmhandle_t {
 	unsigned short nopassiveftp;
 	unsigned short chomp; /* if eye-candy features should be enabled or not */
 	unsigned short maxtries; /* for downloading */
+	unsigned short packeddb; /* read the local db from a single packed file */
+	unsigned short threads; /* for loading the databases, 0 means one per cpu */
+	unsigned short combineddb; /* write desc and depends to a single file */
+	unsigned short compactfiles; /* write front-coded file lists */
+	unsigned short deltadb; /* try to update sync dbs using a delta */
+	unsigned short filesdb; /* fetch the files database of the sync dbs, too */
+	pacman_cb_db_test testcb; /* progress of _pacman_db_test() */
 	pmlist_t *needles; /* for searching */
 	char *language;
 	int *dlremain;
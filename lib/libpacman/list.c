@@ -133,6 +133,56 @@ pmlist_t *_pacman_list_add_sorted(pmlist_t *list, void *data, _pacman_fn_cmp fn)
 	return(list);
 }
 
+/* Unlink item, an element of list, and free it (not its data).
+ * Return the new list (without the removed element).
+ */
+pmlist_t *_pacman_list_remove_item(pmlist_t *list, pmlist_t *item)
+{
+	if(item->next) {
+		item->next->prev = item->prev;
+	}
+	if(item->prev) {
+		item->prev->next = item->next;
+	}
+	if(item == list) {
+		/* The item found is the first in the chain */
+		if(list->next) {
+			list->next->last = list->last;
+		}
+		list = list->next;
+	} else if(item == list->last) {
+		/* The item found is the last in the chain */
+		list->last = item->prev;
+	}
+
+	item->data = NULL;
+	free(item);
+
+	return(list);
+}
+
+/* Append the items of list2 to list1, taking them over
+ */
+pmlist_t *_pacman_list_join(pmlist_t *list1, pmlist_t *list2)
+{
+	pmlist_t *lp;
+
+	if(list1 == NULL) {
+		return(list2);
+	}
+	if(list2 == NULL) {
+		return(list1);
+	}
+
+	lp = _pacman_list_last(list1);
+	lp->next = list2;
+	list2->prev = lp;
+	list1->last = list2->last;
+	list2->last = NULL;
+
+	return(list1);
+}
+
 /* Remove an item in a list. Use the given comparison function to find the
  * item.
  * If the item is found, 'data' is pointing to the removed element.
@@ -159,28 +209,10 @@ pmlist_t *_pacman_list_remove(pmlist_t *haystack, void *needle, _pacman_fn_cmp f
 
 	if(i) {
 		/* we found a matching item */
-		if(i->next) {
-			i->next->prev = i->prev;
-		}
-		if(i->prev) {
-			i->prev->next = i->next;
-		}
-		if(i == haystack) {
-			/* The item found is the first in the chain */
-			if(haystack->next) {
-				haystack->next->last = haystack->last;
-			}
-			haystack = haystack->next;
-		} else if(i == haystack->last) {
-			/* The item found is the last in the chain */
-			haystack->last = i->prev;
-		}
-
 		if(data) {
 			*data = i->data;
 		}
-		i->data = NULL;
-		free(i);
+		haystack = _pacman_list_remove_item(haystack, i);
 	}
 
 	return(haystack);
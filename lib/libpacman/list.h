@@ -41,6 +41,8 @@ pmlist_t *_pacman_list_new(void);
 void _pacman_list_free(pmlist_t *list, _pacman_fn_free fn);
 pmlist_t *_pacman_list_add(pmlist_t *list, void *data);
 pmlist_t *_pacman_list_add_sorted(pmlist_t *list, void *data, _pacman_fn_cmp fn);
+pmlist_t *_pacman_list_remove_item(pmlist_t *list, pmlist_t *item);
+pmlist_t *_pacman_list_join(pmlist_t *list1, pmlist_t *list2);
 pmlist_t *_pacman_list_remove(pmlist_t *haystack, void *needle, _pacman_fn_cmp fn, void **data);
 int _pacman_list_count(pmlist_t *list);
 int _pacman_list_is_in(void *needle, pmlist_t *haystack);
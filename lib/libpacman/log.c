@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <time.h>
+#include <pthread.h>
 /* pacman-g2 */
 #include "pacman.h"
 #include "log.h"
@@ -30,6 +31,8 @@
 /* Internal library log mechanism */
 pacman_cb_log pm_logcb     = NULL;
 unsigned char pm_logmask = 0;
+/* the database loaders may log from several threads */
+static pthread_mutex_t pm_loglock = PTHREAD_MUTEX_INITIALIZER;
 
 void _pacman_log(unsigned char flag, const char *fmt, ...)
 {
@@ -45,8 +48,10 @@ void _pacman_log(unsigned char flag, const char *fmt, ...)
 		vsnprintf(str, LOG_STR_LEN, fmt, args);
 		va_end(args);
 
+		pthread_mutex_lock(&pm_loglock);
 		pm_logcb(flag, str);
 		pacman_logaction(str);
+		pthread_mutex_unlock(&pm_loglock);
 	}
 }
 
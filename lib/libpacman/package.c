@@ -41,6 +41,7 @@
 #include "cache.h"
 #include "package.h"
 #include "pacman.h"
+#include "readahead.h"
 
 pmpkg_t *_pacman_pkg_new(const char *name, const char *version)
 {
@@ -79,6 +80,7 @@ pmpkg_t *_pacman_pkg_new(const char *name, const char *version)
 	pkg->reason         = PM_PKG_REASON_EXPLICIT;
 	pkg->requiredby     = NULL;
 	pkg->conflicts      = NULL;
+	pkg->filelist       = NULL;
 	pkg->files          = NULL;
 	pkg->backup         = NULL;
 	pkg->depends        = NULL;
@@ -90,6 +92,7 @@ pmpkg_t *_pacman_pkg_new(const char *name, const char *version)
 	pkg->origin         = 0;
 	pkg->data           = NULL;
 	pkg->infolevel      = 0;
+	pkg->interned       = 0;
 
 	return(pkg);
 }
@@ -123,7 +126,8 @@ pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg)
 	newpkg->desc_localized = _pacman_list_strdup(pkg->desc_localized);
 	newpkg->requiredby = _pacman_list_strdup(pkg->requiredby);
 	newpkg->conflicts  = _pacman_list_strdup(pkg->conflicts);
-	newpkg->files      = _pacman_list_strdup(pkg->files);
+	newpkg->filelist   = _pacman_filelist_dup(pkg->filelist);
+	newpkg->files      = NULL;
 	newpkg->backup     = _pacman_list_strdup(pkg->backup);
 	newpkg->depends    = _pacman_list_strdup(pkg->depends);
 	newpkg->removes    = _pacman_list_strdup(pkg->removes);
@@ -134,6 +138,7 @@ pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg)
 	newpkg->origin     = pkg->origin;
 	newpkg->data = (newpkg->origin == PKG_FROM_FILE) ? strdup(pkg->data) : pkg->data;
 	newpkg->infolevel  = pkg->infolevel;
+	newpkg->interned   = 0;
 
 	return(newpkg);
 }
@@ -146,8 +151,18 @@ void _pacman_pkg_free(void *data)
 		return;
 	}
 
+	if(pkg->interned) {
+		/* the strings belong to the handle's pool */
+		FREELISTPTR(pkg->license);
+		FREELISTPTR(pkg->depends);
+		FREELISTPTR(pkg->conflicts);
+		FREELISTPTR(pkg->groups);
+		FREELISTPTR(pkg->provides);
+		FREELISTPTR(pkg->replaces);
+	}
 	FREELIST(pkg->license);
 	FREELIST(pkg->desc_localized);
+	FREEFILELIST(pkg->filelist);
 	FREELIST(pkg->files);
 	FREELIST(pkg->backup);
 	FREELIST(pkg->depends);
@@ -165,6 +180,26 @@ void _pacman_pkg_free(void *data)
 	return;
 }
 
+/* Tells whether pkg provides name
+ * pooled is the copy of name in the handle's pool (_pacman_strpool_key()),
+ * so that the provisions of a package read from a database are compared by
+ * pointer.
+ */
+int _pacman_pkg_provides(pmpkg_t *pkg, const char *name, const char *pooled)
+{
+	pmlist_t *i = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES);
+
+	if(pkg->interned && pooled) {
+		for(; i; i = i->next) {
+			if(i->data == pooled) {
+				return(1);
+			}
+		}
+		return(0);
+	}
+	return(_pacman_list_is_strin((char *)name, i));
+}
+
 /* Helper function for comparing packages
  */
 int _pacman_pkg_cmp(const void *p1, const void *p2)
@@ -285,13 +320,7 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 		RET_ERR(PM_ERR_WRONG_ARGS, NULL);
 	}
 
-	if ((archive = archive_read_new ()) == NULL)
-		RET_ERR(PM_ERR_LIBARCHIVE_ERROR, NULL);
-
-	archive_read_support_compression_all (archive);
-	archive_read_support_format_all (archive);
-
-	if ((ret = archive_read_open_file (archive, pkgfile, PM_DEFAULT_BYTES_PER_BLOCK)) != ARCHIVE_OK)
+	if ((archive = _pacman_archive_open (pkgfile)) == NULL)
 		RET_ERR(PM_ERR_PKG_OPEN, NULL);
 
 	info = _pacman_pkg_new(NULL, NULL);
@@ -419,6 +448,10 @@ pmpkg_t *_pacman_pkg_load(const char *pkgfile)
 		goto error;
 	}
 
+	/* keep the file list front-coded, like the ones of the db */
+	info->filelist = _pacman_filelist_new(info->files);
+	FREELIST(info->files);
+
 	/* internal */
 	info->origin = PKG_FROM_FILE;
 	info->data = strdup(pkgfile);
@@ -587,7 +620,12 @@ void *_pacman_pkg_getinfo(pmpkg_t *pkg, unsigned char parm)
 		case PM_PKG_REQUIREDBY:  data = pkg->requiredby; break;
 		case PM_PKG_PROVIDES:    data = pkg->provides; break;
 		case PM_PKG_CONFLICTS:   data = pkg->conflicts; break;
-		case PM_PKG_FILES:       data = pkg->files; break;
+		case PM_PKG_FILES:
+			if(pkg->files == NULL) {
+				pkg->files = _pacman_filelist_expand(pkg->filelist);
+			}
+			data = pkg->files;
+		break;
 		case PM_PKG_BACKUP:      data = pkg->backup; break;
 		case PM_PKG_SCRIPLET:    data = (void *)(long)pkg->scriptlet; break;
 		case PM_PKG_DATA:        data = pkg->data; break;
@@ -604,6 +642,7 @@ pmlist_t *_pacman_pkg_getowners(char *filename)
 	struct stat buf;
 	int gotcha = 0;
 	char rpath[PATH_MAX];
+	size_t rootlen = strlen(handle->root);
 	pmlist_t *lp, *ret = NULL;
 
 	if(stat(filename, &buf) == -1 || realpath(filename, rpath) == NULL) {
@@ -617,25 +656,26 @@ pmlist_t *_pacman_pkg_getowners(char *filename)
 		rpath[strlen(rpath)] = '/';
 	}
 
-	for(lp = _pacman_db_get_pkgcache(handle->db_local); lp; lp = lp->next) {
-		pmpkg_t *info;
-		pmlist_t *i;
-
-		info = lp->data;
+	/* the paths of the db are relative to the root */
+	if(strncmp(rpath, handle->root, rootlen)) {
+		RET_ERR(PM_ERR_NO_OWNER, NULL);
+	}
 
-		for(i = _pacman_pkg_getinfo(info, PM_PKG_FILES); i; i = i->next) {
-			char path[PATH_MAX];
+	for(lp = _pacman_db_get_pkgcache(handle->db_local); lp; lp = lp->next) {
+		pmpkg_t *info = lp->data;
 
-			snprintf(path, PATH_MAX, "%s%s", handle->root, (char *)i->data);
-			if(!strcmp(path, rpath)) {
-				ret = _pacman_list_add(ret, info);
-				if(rpath[strlen(rpath)-1] != '/') {
-					/* we are searching for a file and multiple packages won't contain
-					 * the same file */
-					return(ret);
-				}
-				gotcha = 1;
+		if(!(info->infolevel & INFRQ_FILES)) {
+			_pacman_log(PM_LOG_DEBUG, _("loading FILES info for '%s'"), info->name);
+			_pacman_db_read(info->data, INFRQ_FILES, info);
+		}
+		if(_pacman_filelist_contains(info->filelist, rpath+rootlen)) {
+			ret = _pacman_list_add(ret, info);
+			if(rpath[strlen(rpath)-1] != '/') {
+				/* we are searching for a file and multiple packages won't contain
+				 * the same file */
+				return(ret);
 			}
+			gotcha = 1;
 		}
 	}
 	if(!gotcha) {
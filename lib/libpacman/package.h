@@ -29,6 +29,7 @@
 #include <time.h>
 #endif
 #include "list.h"
+#include "filelist.h"
 
 enum {
 	PKG_FROM_CACHE = 1,
@@ -70,7 +71,8 @@ typedef struct __pmpkg_t {
 	pmlist_t *license;
 	pmlist_t *replaces;
 	pmlist_t *groups;
-	pmlist_t *files;
+	pmfilelist_t *filelist;
+	pmlist_t *files; /* filelist as a list, made on demand */
 	pmlist_t *backup;
 	pmlist_t *depends;
 	pmlist_t *removes;
@@ -81,6 +83,7 @@ typedef struct __pmpkg_t {
 	unsigned char origin;
 	void *data;
 	unsigned char infolevel;
+	unsigned char interned; /* the strings of the ILIST lists are pooled */
 } pmpkg_t;
 
 #define FREEPKG(p) \
@@ -96,6 +99,7 @@ do { \
 pmpkg_t* _pacman_pkg_new(const char *name, const char *version);
 pmpkg_t *_pacman_pkg_dup(pmpkg_t *pkg);
 void _pacman_pkg_free(void *data);
+int _pacman_pkg_provides(pmpkg_t *pkg, const char *name, const char *pooled);
 int _pacman_pkg_cmp(const void *p1, const void *p2);
 pmpkg_t *_pacman_pkg_load(const char *pkgfile);
 pmpkg_t *_pacman_pkg_isin(const char *needle, pmlist_t *haystack);
@@ -35,6 +35,7 @@
 #include <limits.h> /* PATH_MAX */
 #include <stdarg.h>
 #include <libintl.h>
+#include <pthread.h>
 /* pacman-g2 */
 #include "config.h"
 #include "log.h"
@@ -48,6 +49,13 @@
 #include "group.h"
 #include "util.h"
 #include "db.h"
+#include "be_packed.h"
+#include "be_index.h"
+#include "be_journal.h"
+#include "be_delta.h"
+#include "be_filesdb.h"
+#include "be_changes.h"
+#include "parallel.h"
 #include "cache.h"
 #include "conflict.h"
 #include "backup.h"
@@ -307,44 +315,41 @@ int pacman_db_setserver(pmdb_t *db, char *url)
 	return(0);
 }
 
-/** Update a package database
- * @param force if true, then forces the update, otherwise update only in case
- * the database isn't up to date
- * @param db pointer to the package database to update
- * @return 0 on success, -1 on error (pm_errno is set accordingly), 1 if up
- * to date
+/* converts the archive of a sync db, and reopens it to use the result */
+static void _pacman_db_rebuild_pack(pmdb_t *db)
+{
+	_pacman_packdb_sync(db);
+	_pacman_db_close(db);
+	_pacman_db_open(db);
+}
+
+/* downloads the current version of a sync db, the caller holds the lock
+ * It only touches the files of db (and sets *error instead of pm_errno), so
+ * the downloads of several dbs can run at the same time.
+ * Returns 0 if it got downloaded, 2 if a delta patched its pack (*changed
+ * lists the entries it touched then), 1 if it was up to date, -1 on error.
  */
-int pacman_db_update(int force, PM_DB *db)
+static int _pacman_db_fetch(pmdb_t *db, int force, char *newmtime, pmlist_t **changed, int *error)
 {
-	char path[PATH_MAX], dirpath[PATH_MAX], lckpath[PATH_MAX];
+	char path[PATH_MAX];
 	pmlist_t *files = NULL;
-	char newmtime[16] = "";
 	char lastupdate[16] = "";
-	int ret, updated=0, status=0;
-
-	/* Sanity checks */
-	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, -1));
-	ASSERT(db != NULL && db != handle->db_local, RET_ERR(PM_ERR_WRONG_ARGS, -1));
-	/* Do not update a database if a transaction is on-going */
-	ASSERT(handle->trans == NULL, RET_ERR(PM_ERR_TRANS_NOT_NULL, -1));
-
-	/* lock db */
-	snprintf(lckpath, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
-	handle->lckfd = _pacman_lckmk(lckpath);
-	if(handle->lckfd == -1) {
-		RET_ERR(PM_ERR_HANDLE_LOCK, -1);
-	}
-
-	if(!_pacman_list_is_in(db, handle->dbs_sync)) {
-		RET_ERR(PM_ERR_DB_NOT_FOUND, -1);
-	}
+	struct stat buf;
+	int ret;
 
+	*error = 0;
+	*changed = NULL;
 	if(!force) {
 		/* get the lastupdate time */
 		_pacman_db_getlastupdate(db, lastupdate);
 		if(strlen(lastupdate) == 0) {
 			_pacman_log(PM_LOG_DEBUG, _("failed to get lastupdate time for %s (no big deal)\n"), db->treename);
 		}
+		snprintf(path, PATH_MAX, "%s" PM_EXT_DB, db->path);
+		if(strlen(lastupdate) && !_pacman_packdb_usable(db) && stat(path, &buf) == -1) {
+			/* the patched pack got lost: there is no copy to bring up to date */
+			lastupdate[0] = '\0';
+		}
 	}
 
 	/* build a one-element list */
@@ -353,22 +358,52 @@ int pacman_db_update(int force, PM_DB *db)
 
 	snprintf(path, PATH_MAX, "%s%s", handle->root, handle->dbpath);
 
-	ret = _pacman_downloadfiles_forreal(db->servers, path, files, lastupdate, newmtime, 0);
-	FREELIST(files);
-	if(ret != 0) {
-		if(ret == -1) {
-			_pacman_log(PM_LOG_DEBUG, _("failed to sync db: %s [%d]\n"),  pacman_strerror(ret), ret);
-			pm_errno = PM_ERR_DB_SYNC;
+	ret = -1;
+	if(handle->deltadb && strlen(lastupdate)) {
+		if((ret = _pacman_db_fetchdelta(db, path, lastupdate, newmtime, changed)) == 0) {
+			ret = 2;
 		}
-		status = 1;
-		goto rmlck;
-	} else {
+	}
+	if(ret == -1) {
+		ret = _pacman_downloadfiles_r(db->servers, path, files, lastupdate, newmtime, 0, error);
+	}
+	FREELIST(files);
+	if(ret == -1 && *error == 0) {
+		*error = PM_ERR_DB_SYNC;
+	}
+	return(ret);
+}
+
+/* switches a sync db to what _pacman_db_fetch() got: the package cache, the
+ * pack and the files database are rebuilt, or patched after a delta
+ * They share the string pool and pm_errno, so only one db at a time gets
+ * there.  changed is freed.
+ */
+static int _pacman_db_switch(pmdb_t *db, int ret, int force, const char *newmtime, pmlist_t *changed)
+{
+	char dirpath[PATH_MAX];
+
+	if(ret == 1 && !_pacman_packdb_usable(db)) {
+		/* up to date, but it has no usable pack yet */
+		_pacman_db_rebuild_pack(db);
+	}
+	if(ret == -1) {
+		_pacman_log(PM_LOG_DEBUG, _("failed to sync db: %s [%d]\n"),  pacman_strerror(ret), ret);
+		return(-1);
+	} else if(ret == 2) {
+		/* only the entries the delta touched change */
+		_pacman_log(PM_LOG_DEBUG, _("sync: new mtime for %s: %s\n"), db->treename, newmtime);
+		_pacman_db_setlastupdate(db, newmtime);
+		_pacman_db_close(db);
+		_pacman_db_open(db);
+		_pacman_db_patch_pkgcache(db, changed);
+		FREELIST(changed);
+		ret = 0;
+	} else if(ret == 0) {
 		if(strlen(newmtime)) {
 			_pacman_log(PM_LOG_DEBUG, _("sync: new mtime for %s: %s\n"), db->treename, newmtime);
-			updated = 1;
 		}
 		snprintf(dirpath, PATH_MAX, "%s%s/%s", handle->root, handle->dbpath, db->treename);
-		snprintf(path, PATH_MAX, "%s%s/%s" PM_EXT_DB, handle->root, handle->dbpath, db->treename);
 
 		/* remove the old dir */
 		_pacman_rmrf(dirpath);
@@ -376,17 +411,167 @@ int pacman_db_update(int force, PM_DB *db)
 		/* Cache needs to be rebuild */
 		_pacman_db_free_pkgcache(db);
 
-		if(updated) {
+		if(strlen(newmtime)) {
 			_pacman_db_setlastupdate(db, newmtime);
 		}
+		_pacman_db_rebuild_pack(db);
+	}
+	if(handle->filesdb && _pacman_filesdb_update(db, force) == -1) {
+		_pacman_log(PM_LOG_WARNING, _("failed to update the files database of %s\n"), db->treename);
+	}
+	return(ret);
+}
+
+/** Update a package database
+ * @param force if true, then forces the update, otherwise update only in case
+ * the database isn't up to date
+ * @param db pointer to the package database to update
+ * @return 0 on success, -1 on error (pm_errno is set accordingly), 1 if up
+ * to date
+ */
+int pacman_db_update(int force, PM_DB *db)
+{
+	char lckpath[PATH_MAX], newmtime[16] = "";
+	pmlist_t *changed;
+	int ret, error;
+
+	/* Sanity checks */
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, -1));
+	ASSERT(db != NULL && db != handle->db_local, RET_ERR(PM_ERR_WRONG_ARGS, -1));
+	/* Do not update a database if a transaction is on-going */
+	ASSERT(handle->trans == NULL, RET_ERR(PM_ERR_TRANS_NOT_NULL, -1));
+	ASSERT(_pacman_list_is_in(db, handle->dbs_sync), RET_ERR(PM_ERR_DB_NOT_FOUND, -1));
+
+	/* lock db */
+	snprintf(lckpath, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
+	handle->lckfd = _pacman_lckmk(lckpath);
+	if(handle->lckfd == -1) {
+		RET_ERR(PM_ERR_HANDLE_LOCK, -1);
+	}
+
+	ret = _pacman_db_fetch(db, force, newmtime, &changed, &error);
+	ret = _pacman_db_switch(db, ret, force, newmtime, changed);
+	if(ret == -1) {
+		pm_errno = PM_ERR_DB_SYNC;
 	}
 
-rmlck:
 	if(_pacman_lckrm(lckpath)) {
-		_pacman_log(PM_LOG_WARNING, _("could not remove lock file %s"), path);
-		pacman_logaction(_("warning: could not remove lock file %s"), path);
+		_pacman_log(PM_LOG_WARNING, _("could not remove lock file %s"), lckpath);
+		pacman_logaction(_("warning: could not remove lock file %s"), lckpath);
 	}
-	return status;
+	return(ret);
+}
+
+typedef struct __pmdbupdate_t {
+	pmdb_t **dbs;
+	int force;
+	int progress; /* the progress bar follows the downloads */
+	int failed;
+	pacman_cb_db_update cb;
+	pthread_mutex_t lock; /* serializes the callbacks, the rebuilds and pm_errno */
+} pmdbupdate_t;
+
+static void _pacman_db_update_one(void *data, unsigned int idx)
+{
+	pmdbupdate_t *update = data;
+	pmdb_t *db = update->dbs[idx];
+	char newmtime[16] = "";
+	pmlist_t *changed;
+	int ret, error;
+
+	if(update->cb) {
+		pthread_mutex_lock(&update->lock);
+		update->cb(db, PM_DB_UPDATE_START, update->progress);
+		pthread_mutex_unlock(&update->lock);
+	}
+	ret = _pacman_db_fetch(db, update->force, newmtime, &changed, &error);
+	pthread_mutex_lock(&update->lock);
+	ret = _pacman_db_switch(db, ret, update->force, newmtime, changed);
+	if(ret == -1) {
+		update->failed++;
+		/* what the callback finds in pm_errno is the error of this db */
+		pm_errno = error;
+	}
+	if(update->cb) {
+		update->cb(db, PM_DB_UPDATE_DONE, ret);
+	}
+	pthread_mutex_unlock(&update->lock);
+}
+
+/** Update all the sync databases
+ * They are fetched concurrently, one thread per database (unless Threads is
+ * 1, or an XferCommand is set), under a single lock.  The callback, if any,
+ * is called (never by two threads at the same time) with PM_DB_UPDATE_START
+ * when a database starts updating, and 1 if the download progress bar
+ * follows it (not when several run at once), then with PM_DB_UPDATE_DONE and
+ * what pacman_db_update() would have returned for it once it is done; if
+ * that is -1, pm_errno holds why this database failed during the callback.
+ * Only the downloads run concurrently: the rebuilds which follow them (the
+ * package cache, the pack and the files database) are done one at a time.
+ * @param force if true, then forces the update, otherwise update only the
+ * databases which aren't up to date
+ * @param callback the per-database status callback, or NULL
+ * @return the number of databases which failed to update (pm_errno is set to
+ * PM_ERR_DB_SYNC if there are any), -1 on error
+ */
+int pacman_db_update_all(int force, pacman_cb_db_update callback)
+{
+	char lckpath[PATH_MAX];
+	pmdbupdate_t update;
+	unsigned int count, threads;
+	pmdlprogress_t progress;
+	pmlist_t *i;
+
+	/* Sanity checks */
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, -1));
+	/* Do not update a database if a transaction is on-going */
+	ASSERT(handle->trans == NULL, RET_ERR(PM_ERR_TRANS_NOT_NULL, -1));
+
+	if((count = _pacman_list_count(handle->dbs_sync)) == 0) {
+		return(0);
+	}
+	memset(&update, 0, sizeof(update));
+	if((update.dbs = _pacman_malloc(count*sizeof(pmdb_t *))) == NULL) {
+		return(-1);
+	}
+	count = 0;
+	for(i = handle->dbs_sync; i; i = i->next) {
+		update.dbs[count++] = i->data;
+	}
+	update.force = force;
+	update.cb = callback;
+	pthread_mutex_init(&update.lock, NULL);
+
+	/* lock db */
+	snprintf(lckpath, PATH_MAX, "%s/%s", handle->root, PM_LOCK);
+	handle->lckfd = _pacman_lckmk(lckpath);
+	if(handle->lckfd == -1) {
+		pthread_mutex_destroy(&update.lock);
+		free(update.dbs);
+		RET_ERR(PM_ERR_HANDLE_LOCK, -1);
+	}
+
+	/* the transfers wait on the network, not on the cpu */
+	threads = (handle->threads == 1 || handle->xfercommand) ? 1 : count;
+	update.progress = (threads == 1);
+	if(threads > 1) {
+		_pacman_dlprogress_detach(&progress);
+	}
+	_pacman_parallel_for(threads, count, _pacman_db_update_one, &update);
+	if(threads > 1) {
+		_pacman_dlprogress_attach(&progress);
+	}
+
+	if(_pacman_lckrm(lckpath)) {
+		_pacman_log(PM_LOG_WARNING, _("could not remove lock file %s"), lckpath);
+		pacman_logaction(_("warning: could not remove lock file %s"), lckpath);
+	}
+	pthread_mutex_destroy(&update.lock);
+	free(update.dbs);
+	if(update.failed) {
+		pm_errno = PM_ERR_DB_SYNC;
+	}
+	return(update.failed);
 }
 
 /** Get a package entry from a package database
@@ -418,6 +603,38 @@ pmlist_t *pacman_db_getpkgcache(pmdb_t *db)
 	return(_pacman_db_get_pkgcache(db));
 }
 
+/** Load the package caches of all the sync databases
+ * They are loaded concurrently (if Threads allows), instead of one after
+ * the other as they get asked for.
+ * @return 0 on success, -1 on error (pm_errno is set accordingly)
+ */
+int pacman_db_preload(void)
+{
+	/* Sanity checks */
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, -1));
+
+	return(_pacman_db_load_pkgcaches(handle->dbs_sync));
+}
+
+/** Bring the package cache of a database up to date with what other
+ * processes changed since it was loaded.
+ * The packages it replaces stay valid until the database is unregistered.
+ * @param db pointer to the package database
+ * @return 0 on success, -1 on error (pm_errno is set accordingly)
+ */
+int pacman_db_refresh(pmdb_t *db)
+{
+	/* Sanity checks */
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, -1));
+	ASSERT(db != NULL, RET_ERR(PM_ERR_DB_NULL, -1));
+
+	if(handle->trans != NULL) {
+		/* a running transaction holds the lock, nobody else can change the db */
+		return(0);
+	}
+	return(_pacman_db_refresh_pkgcache(db));
+}
+
 /** Get the list of packages that a package provides
  * @param db pointer to the package database to get the package from
  * @param name name of the package
@@ -433,6 +650,24 @@ pmlist_t *pacman_db_whatprovides(pmdb_t *db, char *name)
 	return(_pacman_db_whatprovides(db, name));
 }
 
+/** Get the packages of a sync database which ship a file
+ * It needs the files database of the repository, see PM_OPT_FILESDB.
+ * @param db pointer to the package database to search in
+ * @param path path of the file, relative to the root
+ * @return the list of the owners, as "name version" strings to be freed with
+ * pacman_list_free(), on success, NULL on error (pm_errno is set accordingly,
+ * to PM_ERR_NO_OWNER if the db has no such file)
+ */
+pmlist_t *pacman_db_getowners(pmdb_t *db, const char *path)
+{
+	/* Sanity checks */
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, NULL));
+	ASSERT(db != NULL && db != handle->db_local, RET_ERR(PM_ERR_WRONG_ARGS, NULL));
+	ASSERT(path != NULL && strlen(path) != 0, RET_ERR(PM_ERR_WRONG_ARGS, NULL));
+
+	return(_pacman_filesdb_owners(db, path));
+}
+
 /** Get a group entry from a package database
  * @param db pointer to the package database to get the group from
  * @param name of the group
@@ -620,15 +855,21 @@ int pacman_sync_cleancache(int full)
 }
 
 /** Tests a database
+ * The entries are checked on the configured number of threads (see
+ * PM_OPT_THREADS), and the PM_OPT_DBTESTCB callback, if any, gets the name
+ * of each entry checked, the percentage done, the number of entries and
+ * the number of entries done.
  * @param db pointer to the package database to search in
- * @return the list of problems found on success, NULL on error
+ * @return the list of problems found, NULL if there are none (pm_errno is
+ * 0 then) or on error (pm_errno is set accordingly)
  */
 pmlist_t *pacman_db_test(pmdb_t *db)
 {
 	/* Sanity checks */
-	ASSERT(handle != NULL, return(NULL));
-	ASSERT(db != NULL, return(NULL));
+	ASSERT(handle != NULL, RET_ERR(PM_ERR_HANDLE_NULL, NULL));
+	ASSERT(db != NULL, RET_ERR(PM_ERR_DB_NULL, NULL));
 
+	pm_errno = 0;
 	return(_pacman_db_test(db));
 }
 
@@ -709,6 +950,13 @@ int pacman_trans_init(unsigned char type, unsigned int flags, pacman_trans_cb_ev
 		RET_ERR(PM_ERR_HANDLE_LOCK, -1);
 	}
 
+	/* finish what an interrupted transaction left in the journal, the
+	 * refresh picks up the entries it changes */
+	_pacman_journal_replay(handle->db_local);
+	/* no one can change the db while we hold the lock, catch up with what
+	 * others did before */
+	_pacman_db_refresh_pkgcache(handle->db_local);
+
 	handle->trans = _pacman_trans_new();
 	if(handle->trans == NULL) {
 		RET_ERR(PM_ERR_MEMORY, -1);
@@ -828,10 +1076,19 @@ int pacman_trans_release()
 
 	FREETRANS(handle->trans);
 
+	/* regenerate the packed local db, if the transaction modified it */
+	_pacman_packdb_commit(handle->db_local);
+
 	t = time(NULL);
 	strftime(lastupdate, 15, "%Y%m%d%H%M%S", localtime(&t));
 	_pacman_db_setlastupdate(handle->db_local, lastupdate);
 
+	/* the package cache followed what we changed, the next refresh only has
+	 * to look at what others change from now on */
+	if(handle->db_local && handle->db_local->changes) {
+		_pacman_dbchanges_stamp(handle->db_local);
+	}
+
 	/* unlock db */
 	if(handle->lckfd != -1) {
 		close(handle->lckfd);
@@ -1145,6 +1402,16 @@ int pacman_parse_config(char *file, pacman_cb_db_register callback, const char *
 					_pacman_log(PM_LOG_DEBUG, _("config: usesyslog\n"));
 				} else if(!strcmp(key, "ILOVECANDY")) {
 					pacman_set_option(PM_OPT_CHOMP, (long)1);
+				} else if(!strcmp(key, "PACKEDDB")) {
+					pacman_set_option(PM_OPT_PACKEDDB, (long)1);
+				} else if(!strcmp(key, "COMBINEDDB")) {
+					pacman_set_option(PM_OPT_COMBINEDDB, (long)1);
+				} else if(!strcmp(key, "COMPACTFILES")) {
+					pacman_set_option(PM_OPT_COMPACTFILES, (long)1);
+				} else if(!strcmp(key, "DELTADB")) {
+					pacman_set_option(PM_OPT_DELTADB, (long)1);
+				} else if(!strcmp(key, "FILESDB")) {
+					pacman_set_option(PM_OPT_FILESDB, (long)1);
 				} else {
 					RET_ERR(PM_ERR_CONF_BAD_SYNTAX, -1);
 				}
@@ -1288,6 +1555,11 @@ int pacman_parse_config(char *file, pacman_cb_db_register callback, const char *
 							/* pm_errno is set by pacman_set_option */
 							return(-1);
 						}
+					} else if (!strcmp(key, "THREADS")) {
+						if(pacman_set_option(PM_OPT_THREADS, (long)atoi(ptr)) == -1) {
+							/* pm_errno is set by pacman_set_option */
+							return(-1);
+						}
 					} else {
 						RET_ERR(PM_ERR_CONF_BAD_SYNTAX, -1);
 					}
@@ -124,7 +124,14 @@ enum {
 	PM_OPT_OLDDELAY,
 	PM_OPT_DLREMAIN,
 	PM_OPT_DLHOWMANY,
-	PM_OPT_HOOKSDIR
+	PM_OPT_HOOKSDIR,
+	PM_OPT_PACKEDDB,
+	PM_OPT_THREADS,
+	PM_OPT_COMBINEDDB,
+	PM_OPT_DBTESTCB,
+	PM_OPT_COMPACTFILES,
+	PM_OPT_DELTADB,
+	PM_OPT_FILESDB
 };
 
 int pacman_set_option(unsigned char parm, unsigned long data);
@@ -151,13 +158,29 @@ int pacman_db_setserver(PM_DB *db, char *url);
 
 int pacman_db_update(int level, PM_DB *db);
 
+/* Database update events */
+enum {
+	PM_DB_UPDATE_START = 1,
+	PM_DB_UPDATE_DONE
+};
+/* Database update callback */
+typedef void (*pacman_cb_db_update)(PM_DB *, unsigned char, int);
+
+int pacman_db_update_all(int level, pacman_cb_db_update callback);
+
 PM_PKG *pacman_db_readpkg(PM_DB *db, const char *name);
 PM_LIST *pacman_db_getpkgcache(PM_DB *db);
+int pacman_db_preload(void);
+int pacman_db_refresh(PM_DB *db);
 PM_LIST *pacman_db_whatprovides(PM_DB *db, char *name);
+PM_LIST *pacman_db_getowners(PM_DB *db, const char *path);
 
 PM_GRP *pacman_db_readgrp(PM_DB *db, char *name);
 PM_LIST *pacman_db_getgrpcache(PM_DB *db);
 PM_LIST *pacman_db_search(PM_DB *db);
+/* Database test progress callback */
+typedef void (*pacman_cb_db_test)(const char *, int, int, int);
+
 PM_LIST *pacman_db_test(PM_DB *db);
 
 /*
@@ -0,0 +1,113 @@
+/*
+ *  parallel.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* A minimal worker pool: _pacman_parallel_for() calls fn(data, i) for each
+ * i in [0, count), spread over the given number of threads (the caller
+ * being one of them), and returns once all the items are done.  The items
+ * are handed out one by one, so slow ones (a cold directory, a big file)
+ * don't hold back the others.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "handle.h"
+#include "parallel.h"
+
+typedef struct __pmworkqueue_t {
+	pthread_mutex_t lock;
+	unsigned int next;
+	unsigned int count;
+	_pacman_fn_work fn;
+	void *data;
+} pmworkqueue_t;
+
+static void *parallel_worker(void *arg)
+{
+	pmworkqueue_t *queue = arg;
+
+	for(;;) {
+		unsigned int idx;
+
+		pthread_mutex_lock(&queue->lock);
+		idx = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+		if(idx >= queue->count) {
+			break;
+		}
+		queue->fn(queue->data, idx);
+	}
+	return(NULL);
+}
+
+/* the number of threads to use, as configured (0 means one per cpu) */
+unsigned int _pacman_parallel_threads(void)
+{
+	long cpus;
+
+	if(handle == NULL || handle->threads > 0) {
+		return(handle ? handle->threads : 1);
+	}
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return(cpus > 0 ? (unsigned int)cpus : 1);
+}
+
+int _pacman_parallel_for(unsigned int threads, unsigned int count, _pacman_fn_work fn, void *data)
+{
+	pmworkqueue_t queue;
+	pthread_t *workers = NULL;
+	unsigned int i, started = 0;
+
+	if(threads > count) {
+		threads = count;
+	}
+	queue.next = 0;
+	queue.count = count;
+	queue.fn = fn;
+	queue.data = data;
+	pthread_mutex_init(&queue.lock, NULL);
+
+	if(threads > 1 && (workers = _pacman_malloc((threads-1)*sizeof(pthread_t))) != NULL) {
+		for(i = 0; i < threads-1; i++) {
+			if(pthread_create(&workers[started], NULL, parallel_worker, &queue) != 0) {
+				/* go on with the ones we have */
+				break;
+			}
+			started++;
+		}
+	}
+	parallel_worker(&queue);
+	for(i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	pthread_mutex_destroy(&queue.lock);
+
+	_pacman_log(PM_LOG_DEBUG, _("processed %u item(s) using %u thread(s)"), count, started+1);
+	return(0);
+}
+
+/* vim: set ts=2 sw=2 noet: */
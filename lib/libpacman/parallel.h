@@ -0,0 +1,32 @@
+/*
+ *  parallel.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_PARALLEL_H
+#define _PACMAN_PARALLEL_H
+
+/* called for each item, from one of the workers */
+typedef void (*_pacman_fn_work)(void *data, unsigned int idx);
+
+unsigned int _pacman_parallel_threads(void);
+int _pacman_parallel_for(unsigned int threads, unsigned int count, _pacman_fn_work fn, void *data);
+
+#endif /* _PACMAN_PARALLEL_H */
+
+/* vim: set ts=2 sw=2 noet: */
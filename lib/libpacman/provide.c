@@ -27,23 +27,207 @@
 #include "cache.h"
 #include "list.h"
 #include "db.h"
+#include "package.h"
+#include "handle.h"
+#include "util.h"
+#include "strpool.h"
 #include "provide.h"
 
+/* The provides index of a db: for each name provided by the entries of its
+ * package cache, the entries providing it, in the order of the cache (their
+ * versions are the ones dependencies get checked against).  The names are
+ * the pooled copies, so they are compared by pointer.  It is built by the
+ * first _pacman_db_whatprovides() on the db, as that reads the provisions of
+ * all the entries anyway, and kept up to date as entries join or leave the
+ * cache, until the cache is freed.
+ */
+typedef struct __pmprovider_t {
+	const char *name;
+	pmlist_t *pkgs;
+} pmprovider_t;
+
+typedef struct __pmprovcache_t {
+	pmprovider_t *slots; /* open addressing, linear probing */
+	size_t size, count;
+} pmprovcache_t;
+
+/* the slot of pooled: the one holding it, or the empty one it would go to */
+static pmprovider_t *_pacman_provcache_slot(pmprovcache_t *cache, const char *pooled)
+{
+	size_t i = _pacman_strpool_hash(pooled, strlen(pooled)) & (cache->size-1);
+
+	while(cache->slots[i].name && cache->slots[i].name != pooled) {
+		i = (i+1) & (cache->size-1);
+	}
+	return(cache->slots+i);
+}
+
+static int _pacman_provcache_grow(pmprovcache_t *cache)
+{
+	pmprovider_t *slots = cache->slots;
+	size_t size = cache->size, i;
+
+	if((cache->slots = _pacman_zalloc(size*2*sizeof(pmprovider_t))) == NULL) {
+		cache->slots = slots;
+		return(-1);
+	}
+	cache->size = size*2;
+	for(i = 0; i < size; i++) {
+		if(slots[i].name) {
+			*_pacman_provcache_slot(cache, slots[i].name) = slots[i];
+		}
+	}
+	free(slots);
+	return(0);
+}
+
+static int _pacman_provcache_ptrcmp(const void *p1, const void *p2)
+{
+	return(p1 != p2);
+}
+
+/* the pooled copy of the provision i of pkg */
+static const char *_pacman_provcache_key(pmpkg_t *pkg, pmlist_t *i)
+{
+	return(pkg->interned ? i->data : _pacman_strpool_key(handle->strpool, i->data));
+}
+
+/* Records that pkg provides its provisions.
+ * With sorted, pkg may go anywhere in the lists (it was just added to the
+ * package cache); otherwise it comes after the packages already there.
+ */
+static int _pacman_provcache_add(pmprovcache_t *cache, pmpkg_t *pkg, int sorted)
+{
+	pmlist_t *i;
+
+	for(i = _pacman_pkg_getinfo(pkg, PM_PKG_PROVIDES); i; i = i->next) {
+		const char *pooled = _pacman_provcache_key(pkg, i);
+		pmprovider_t *slot;
+
+		if(pooled == NULL) {
+			return(-1);
+		}
+		slot = _pacman_provcache_slot(cache, pooled);
+		if(slot->name == NULL) {
+			slot->name = pooled;
+			cache->count++;
+		}
+		if(sorted) {
+			if(!_pacman_list_is_in(pkg, slot->pkgs)) {
+				slot->pkgs = _pacman_list_add_sorted(slot->pkgs, pkg, _pacman_pkg_cmp);
+			}
+		} else if(slot->pkgs == NULL || slot->pkgs->last->data != pkg) {
+			slot->pkgs = _pacman_list_add(slot->pkgs, pkg);
+		}
+		/* keep it at most half full */
+		if(cache->count*2 > cache->size && _pacman_provcache_grow(cache) == -1) {
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+void _pacman_db_free_provcache(pmdb_t *db)
+{
+	pmprovcache_t *cache = db->provcache;
+	size_t i;
+
+	if(cache == NULL) {
+		return;
+	}
+	for(i = 0; i < cache->size; i++) {
+		FREELISTPTR(cache->slots[i].pkgs);
+	}
+	free(cache->slots);
+	FREE(db->provcache);
+}
+
+static int _pacman_db_load_provcache(pmdb_t *db)
+{
+	pmlist_t *lp;
+
+	if(handle->strpool == NULL) {
+		return(-1);
+	}
+	if((db->provcache = _pacman_zalloc(sizeof(pmprovcache_t))) == NULL) {
+		return(-1);
+	}
+	db->provcache->size = 256;
+	if((db->provcache->slots = _pacman_zalloc(db->provcache->size*sizeof(pmprovider_t))) == NULL) {
+		FREE(db->provcache);
+		return(-1);
+	}
+	for(lp = db->pkgcache; lp; lp = lp->next) {
+		if(_pacman_provcache_add(db->provcache, lp->data, 0) == -1) {
+			_pacman_db_free_provcache(db);
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+/* adds pkg, which just joined the package cache of db, to its provides index */
+void _pacman_db_add_provider(pmdb_t *db, pmpkg_t *pkg)
+{
+	if(db->provcache && _pacman_provcache_add(db->provcache, pkg, 1) == -1) {
+		/* it gets rebuilt by the next lookup */
+		_pacman_db_free_provcache(db);
+	}
+}
+
+/* removes pkg, which is leaving the package cache of db, from its provides
+ * index */
+void _pacman_db_remove_provider(pmdb_t *db, pmpkg_t *pkg)
+{
+	pmlist_t *i;
+
+	if(db->provcache == NULL) {
+		return;
+	}
+	/* not _pacman_pkg_getinfo(): the provisions were read when pkg was
+	 * indexed, and an entry which never was has nothing to remove */
+	for(i = pkg->provides; i; i = i->next) {
+		const char *pooled = _pacman_provcache_key(pkg, i);
+		pmprovider_t *slot;
+
+		if(pooled == NULL) {
+			_pacman_db_free_provcache(db);
+			return;
+		}
+		slot = _pacman_provcache_slot(db->provcache, pooled);
+		if(slot->name) {
+			slot->pkgs = _pacman_list_remove(slot->pkgs, pkg, _pacman_provcache_ptrcmp, NULL);
+		}
+	}
+}
+
 /* return a pmlist_t of packages in "db" that provide "package"
  */
 pmlist_t *_pacman_db_whatprovides(pmdb_t *db, char *package)
 {
 	pmlist_t *pkgs = NULL;
 	pmlist_t *lp;
+	const char *pooled;
 
 	if(db == NULL || package == NULL || strlen(package) == 0) {
 		return(NULL);
 	}
 
-	for(lp = _pacman_db_get_pkgcache(db); lp; lp = lp->next) {
+	pooled = _pacman_strpool_key(handle->strpool, package);
+	lp = _pacman_db_get_pkgcache(db);
+	if(pooled && (db->provcache || _pacman_db_load_provcache(db) == 0)) {
+		pmprovider_t *slot = _pacman_provcache_slot(db->provcache, pooled);
+
+		for(lp = slot->pkgs; lp; lp = lp->next) {
+			pkgs = _pacman_list_add(pkgs, lp->data);
+		}
+		return(pkgs);
+	}
+
+	for(; lp; lp = lp->next) {
 		pmpkg_t *info = lp->data;
 
-		if(_pacman_list_is_strin(package, _pacman_pkg_getinfo(info, PM_PKG_PROVIDES))) {
+		if(_pacman_pkg_provides(info, package, pooled)) {
 			pkgs = _pacman_list_add(pkgs, info);
 		}
 	}
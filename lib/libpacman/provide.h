@@ -26,6 +26,9 @@
 #include "list.h"
 #include "db.h"
 
+void _pacman_db_free_provcache(pmdb_t *db);
+void _pacman_db_add_provider(pmdb_t *db, pmpkg_t *pkg);
+void _pacman_db_remove_provider(pmdb_t *db, pmpkg_t *pkg);
 pmlist_t *_pacman_db_whatprovides(pmdb_t *db, char *package);
 
 #endif /* _PACMAN_PROVIDE_H */
@@ -0,0 +1,237 @@
+/*
+ *  readahead.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* Archives (packages, sync databases) are read in two stages when more
+ * than one thread is allowed: a thread decompresses the file, with the raw
+ * format of libarchive, into a ring of PM_READAHEAD_BLOCKS blocks, while
+ * the archive handed to the caller only splits the decompressed stream into
+ * members, taking the blocks from the ring.  So the next blocks get
+ * decompressed while the caller is busy with the current member (writing
+ * it to the disk, parsing it).
+ *
+ * The caller sees a plain struct archive; archive_read_finish() stops and
+ * joins the thread, even if the archive was not read until its end.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "util.h"
+#include "parallel.h"
+#include "readahead.h"
+
+typedef struct __pmreadahead_t {
+	struct archive *raw; /* the decompressor, used by the thread only */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	char *blocks[PM_READAHEAD_BLOCKS];
+	size_t lens[PM_READAHEAD_BLOCKS];
+	unsigned int head;   /* blocks filled */
+	unsigned int tail;   /* blocks given back by the reader */
+	int held;            /* the reader still uses the block at tail */
+	int done;            /* no block will come after head */
+	int cancel;          /* the reader is gone */
+	int err;
+	char errstr[256];
+} pmreadahead_t;
+
+static void *readahead_thread(void *arg)
+{
+	pmreadahead_t *ra = arg;
+
+	for(;;) {
+		unsigned int slot;
+		size_t len = 0;
+		ssize_t n = 0;
+
+		pthread_mutex_lock(&ra->lock);
+		while(ra->head-ra->tail == PM_READAHEAD_BLOCKS && !ra->cancel) {
+			pthread_cond_wait(&ra->cond, &ra->lock);
+		}
+		if(ra->cancel) {
+			pthread_mutex_unlock(&ra->lock);
+			break;
+		}
+		slot = ra->head%PM_READAHEAD_BLOCKS;
+		pthread_mutex_unlock(&ra->lock);
+
+		/* the slot is ours until head moves past it */
+		while(len < PM_READAHEAD_BLOCK &&
+			(n = archive_read_data(ra->raw, ra->blocks[slot]+len, PM_READAHEAD_BLOCK-len)) > 0) {
+			len += n;
+		}
+
+		pthread_mutex_lock(&ra->lock);
+		if(len) {
+			ra->lens[slot] = len;
+			ra->head++;
+		}
+		if(n < 0) {
+			ra->err = archive_errno(ra->raw);
+			STRNCPY(ra->errstr, archive_error_string(ra->raw) ? archive_error_string(ra->raw) : "", sizeof(ra->errstr));
+		}
+		if(n <= 0) {
+			ra->done = 1;
+		}
+		pthread_cond_broadcast(&ra->cond);
+		pthread_mutex_unlock(&ra->lock);
+		if(n <= 0) {
+			break;
+		}
+	}
+	return(NULL);
+}
+
+static ssize_t readahead_read(struct archive *a, void *data, const void **buf)
+{
+	pmreadahead_t *ra = data;
+	ssize_t ret;
+
+	pthread_mutex_lock(&ra->lock);
+	if(ra->held) {
+		/* libarchive is done with the block it got last time */
+		ra->tail++;
+		ra->held = 0;
+		pthread_cond_broadcast(&ra->cond);
+	}
+	while(ra->head == ra->tail && !ra->done) {
+		pthread_cond_wait(&ra->cond, &ra->lock);
+	}
+	if(ra->head != ra->tail) {
+		*buf = ra->blocks[ra->tail%PM_READAHEAD_BLOCKS];
+		ret = ra->lens[ra->tail%PM_READAHEAD_BLOCKS];
+		ra->held = 1;
+	} else if(ra->errstr[0] || ra->err) {
+		archive_set_error(a, ra->err, "%s", ra->errstr);
+		ret = -1;
+	} else {
+		ret = 0;
+	}
+	pthread_mutex_unlock(&ra->lock);
+	return(ret);
+}
+
+static void readahead_free(pmreadahead_t *ra)
+{
+	int i;
+
+	if(ra->raw) {
+		archive_read_finish(ra->raw);
+	}
+	for(i = 0; i < PM_READAHEAD_BLOCKS; i++) {
+		free(ra->blocks[i]);
+	}
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->lock);
+	free(ra);
+}
+
+static int readahead_close(struct archive *a, void *data)
+{
+	pmreadahead_t *ra = data;
+
+	pthread_mutex_lock(&ra->lock);
+	ra->cancel = 1;
+	pthread_cond_broadcast(&ra->cond);
+	pthread_mutex_unlock(&ra->lock);
+	pthread_join(ra->thread, NULL);
+	readahead_free(ra);
+	return(ARCHIVE_OK);
+}
+
+/* opens the decompressor, NULL if the file can't be read this way */
+static pmreadahead_t *readahead_new(const char *path)
+{
+	struct archive_entry *ae;
+	pmreadahead_t *ra;
+	int i;
+
+	if((ra = _pacman_zalloc(sizeof(pmreadahead_t))) == NULL) {
+		return(NULL);
+	}
+	pthread_mutex_init(&ra->lock, NULL);
+	pthread_cond_init(&ra->cond, NULL);
+	for(i = 0; i < PM_READAHEAD_BLOCKS; i++) {
+		if((ra->blocks[i] = _pacman_malloc(PM_READAHEAD_BLOCK)) == NULL) {
+			readahead_free(ra);
+			return(NULL);
+		}
+	}
+	if((ra->raw = archive_read_new()) == NULL) {
+		readahead_free(ra);
+		return(NULL);
+	}
+	archive_read_support_compression_all(ra->raw);
+	archive_read_support_format_raw(ra->raw);
+	if(archive_read_open_filename(ra->raw, path, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK ||
+		archive_read_next_header(ra->raw, &ae) != ARCHIVE_OK) {
+		readahead_free(ra);
+		return(NULL);
+	}
+	if(pthread_create(&ra->thread, NULL, readahead_thread, ra) != 0) {
+		readahead_free(ra);
+		return(NULL);
+	}
+	return(ra);
+}
+
+/* Opens an archive for reading, like archive_read_open_filename() with
+ * all the compressions and formats enabled, through a read-ahead thread if
+ * there may be more than one.
+ * Returns NULL if the file could not be opened.
+ */
+struct archive *_pacman_archive_open(const char *path)
+{
+	struct archive *a;
+	pmreadahead_t *ra = NULL;
+
+	if((a = archive_read_new()) == NULL) {
+		return(NULL);
+	}
+	archive_read_support_format_all(a);
+	if(_pacman_parallel_threads() > 1) {
+		ra = readahead_new(path);
+	}
+	if(ra) {
+		/* the data comes decompressed already */
+		if(archive_read_open(a, ra, NULL, readahead_read, readahead_close) != ARCHIVE_OK) {
+			/* this calls readahead_close() */
+			archive_read_finish(a);
+			return(NULL);
+		}
+		return(a);
+	}
+	archive_read_support_compression_all(a);
+	if(archive_read_open_filename(a, path, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK) {
+		archive_read_finish(a);
+		return(NULL);
+	}
+	return(a);
+}
+
+/* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,34 @@
+/*
+ *  readahead.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_READAHEAD_H
+#define _PACMAN_READAHEAD_H
+
+#include "util.h"
+
+/* size and number of the decompressed blocks kept ahead of the reader */
+#define PM_READAHEAD_BLOCK  (256*1024)
+#define PM_READAHEAD_BLOCKS 4
+
+struct archive *_pacman_archive_open(const char *path);
+
+#endif /* _PACMAN_READAHEAD_H */
+
+/* vim: set ts=2 sw=2 noet: */
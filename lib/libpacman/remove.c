@@ -195,7 +195,11 @@ int _pacman_remove_commit(pmtrans_t *trans, pmlist_t **data)
 		}
 
 		if(!(trans->flags & PM_TRANS_FLAG_DBONLY)) {
-			int filenum = _pacman_list_count(info->files);
+			int filenum;
+			if(info->files == NULL) {
+				info->files = _pacman_filelist_expand(info->filelist);
+			}
+			filenum = _pacman_list_count(info->files);
 			_pacman_log(PM_LOG_FLOW1, _("removing files"));
 
 			/* iterate through the list backwards, unlinking files */
@@ -152,6 +152,22 @@ int _pacman_downloadfiles(pmlist_t *servers, const char *localpath, pmlist_t *fi
  */
 int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 	pmlist_t *files, const char *mtime1, char *mtime2, int skip)
+{
+	int error = 0, ret;
+
+	ret = _pacman_downloadfiles_r(servers, localpath, files, mtime1, mtime2, skip, &error);
+	if(error) {
+		pm_errno = error;
+	}
+	return(ret);
+}
+
+/*
+ * Same as _pacman_downloadfiles_forreal(), but the error goes to *errnum
+ * instead of pm_errno, so that several downloads can run at the same time.
+ */
+int _pacman_downloadfiles_r(pmlist_t *servers, const char *localpath,
+	pmlist_t *files, const char *mtime1, char *mtime2, int skip, int *errnum)
 {
 	int fsz;
 	netbuf *control = NULL;
@@ -160,13 +176,13 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 	pmlist_t *complete = NULL;
 	pmlist_t *i;
 	pmserver_t *server;
+	int error = 0;
 	int *remain = handle->dlremain, *howmany = handle->dlhowmany;
 
 	if(files == NULL) {
 		return(0);
 	}
 
-	pm_errno = 0;
 	if(howmany) {
 		*howmany = _pacman_list_count(files);
 	}
@@ -312,7 +328,7 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 				getcwd(cwd, PATH_MAX);
 				if(chdir(localpath)) {
 					_pacman_log(PM_LOG_WARNING, _("could not chdir to %s\n"), localpath);
-					pm_errno = PM_ERR_CONNECT_FAILED;
+					error = PM_ERR_CONNECT_FAILED;
 					goto error;
 				}
 				/* execute the parsed command via /bin/sh -c */
@@ -320,7 +336,7 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 				ret = system(parsedCmd);
 				if(ret == -1) {
 					_pacman_log(PM_LOG_WARNING, _("running XferCommand: fork failed!\n"));
-					pm_errno = PM_ERR_FORK_FAILED;
+					error = PM_ERR_FORK_FAILED;
 					goto error;
 				} else if(ret != 0) {
 					/* download failed */
@@ -352,7 +368,7 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 					pm_dlfnm[ptr-fn] = '\0';
 				}
 				ptr = strstr(fn, PM_EXT_PKG);
-				if(ptr && (ptr-fn) < PM_DLFNM_LEN) {
+				if(pm_dlfnm && ptr && (ptr-fn) < PM_DLFNM_LEN) {
 					pm_dlfnm[ptr-fn] = '\0';
 				}
 				if(pm_dlfnm) {
@@ -418,7 +434,7 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 							/* we leave the partially downloaded file in place so it can be resumed later */
 							if(!strncmp(FtpLastResponse(control), strerror(ETIMEDOUT), 254)) {
 								unlink(output);
-								pm_errno = PM_ERR_RETRIEVE;
+								error = PM_ERR_RETRIEVE;
 								goto error;
 							}
 
@@ -507,7 +523,7 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 						} else {
 							_pacman_log(PM_LOG_WARNING, _("\nfailed downloading %s from %s: %s\n"),
 								src, server->server, FtpLastResponse(control));
-							pm_errno = PM_ERR_RETRIEVE;
+							error = PM_ERR_RETRIEVE;
 							/* we leave the partially downloaded file in place so it can be resumed later */
 							if(!strncmp(FtpLastResponse(control), strerror(ETIMEDOUT), 254)) {
 								unlink(output);
@@ -529,14 +545,31 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 					}
 				} else if(!strcmp(server->protocol, "file")) {
 					char src[PATH_MAX];
+					char fmtime[16] = "";
+					struct tm tm;
 					snprintf(src, PATH_MAX, "%s%s", server->path, fn);
-					_pacman_makepath((char*)localpath);
-					_pacman_log(PM_LOG_DEBUG, _("copying %s to %s/%s\n"), src, localpath, fn);
-					/* local repository, just copy the file */
-					if(_pacman_copyfile(src, output)) {
-						_pacman_log(PM_LOG_WARNING, _("failed copying %s\n"), src);
+					/* the mtime in the form the other protocols give it: YYYYMMDDHHMMSS, UTC
+					 * Only DeltaDB needs it, to know which delta to ask for, so the
+					 * other local repos are still copied every time. */
+					if(handle->deltadb && (mtime1 || mtime2) && !stat(src, &st)) {
+						strftime(fmtime, sizeof(fmtime), "%Y%m%d%H%M%S", gmtime_r(&st.st_mtime, &tm));
+					}
+					if(mtime1 && fmtime[0] && !strcmp(mtime1, fmtime)) {
+						_pacman_log(PM_LOG_DEBUG, _("mtimes are identical, skipping %s\n"), fn);
+						filedone = -1;
+						complete = _pacman_list_add(complete, fn);
 					} else {
-						filedone = 1;
+						_pacman_makepath((char*)localpath);
+						_pacman_log(PM_LOG_DEBUG, _("copying %s to %s/%s\n"), src, localpath, fn);
+						/* local repository, just copy the file */
+						if(_pacman_copyfile(src, output)) {
+							_pacman_log(PM_LOG_WARNING, _("failed copying %s\n"), src);
+						} else {
+							if(mtime2) {
+								strcpy(mtime2, fmtime);
+							}
+							filedone = 1;
+						}
 					}
 				}
 
@@ -590,7 +623,52 @@ int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 
 error:
 	FREELISTPTR(complete);
-	return(pm_errno == 0 ? !done : -1);
+	*errnum = error;
+	return(error == 0 ? !done : -1);
+}
+
+/* The progress bar state belongs to the frontend, and follows a single
+ * download at a time: it is detached from the downloads while several of
+ * them run at the same time, and attached back afterwards.
+ */
+void _pacman_dlprogress_detach(pmdlprogress_t *saved)
+{
+	saved->cb = pm_dlcb;
+	saved->fnm = pm_dlfnm;
+	saved->offset = pm_dloffset;
+	saved->t0 = pm_dlt0;
+	saved->t = pm_dlt;
+	saved->rate = pm_dlrate;
+	saved->xfered1 = pm_dlxfered1;
+	saved->eta_h = pm_dleta_h;
+	saved->eta_m = pm_dleta_m;
+	saved->eta_s = pm_dleta_s;
+	saved->remain = handle->dlremain;
+	saved->howmany = handle->dlhowmany;
+	pm_dlcb = NULL;
+	pm_dlfnm = NULL;
+	pm_dloffset = NULL;
+	pm_dlt0 = pm_dlt = NULL;
+	pm_dlrate = NULL;
+	pm_dlxfered1 = NULL;
+	pm_dleta_h = pm_dleta_m = pm_dleta_s = NULL;
+	handle->dlremain = handle->dlhowmany = NULL;
+}
+
+void _pacman_dlprogress_attach(const pmdlprogress_t *saved)
+{
+	pm_dlcb = saved->cb;
+	pm_dlfnm = saved->fnm;
+	pm_dloffset = saved->offset;
+	pm_dlt0 = saved->t0;
+	pm_dlt = saved->t;
+	pm_dlrate = saved->rate;
+	pm_dlxfered1 = saved->xfered1;
+	pm_dleta_h = saved->eta_h;
+	pm_dleta_m = saved->eta_m;
+	pm_dleta_s = saved->eta_s;
+	handle->dlremain = saved->remain;
+	handle->dlhowmany = saved->howmany;
 }
 
 char *_pacman_fetch_pkgurl(char *target)
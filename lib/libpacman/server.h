@@ -47,6 +47,8 @@ void _pacman_server_free(void *data);
 int _pacman_downloadfiles(pmlist_t *servers, const char *localpath, pmlist_t *files, int skip);
 int _pacman_downloadfiles_forreal(pmlist_t *servers, const char *localpath,
 	pmlist_t *files, const char *mtime1, char *mtime2, int skip);
+int _pacman_downloadfiles_r(pmlist_t *servers, const char *localpath,
+	pmlist_t *files, const char *mtime1, char *mtime2, int skip, int *errnum);
 
 char *_pacman_fetch_pkgurl(char *target);
 
@@ -60,6 +62,21 @@ extern float *pm_dlrate;
 extern int *pm_dlxfered1;
 extern unsigned int *pm_dleta_h, *pm_dleta_m, *pm_dleta_s;
 
+/* the progress bar state, saved while concurrent downloads run without it */
+typedef struct __pmdlprogress_t {
+	FtpCallback cb;
+	char *fnm;
+	int *offset;
+	struct timeval *t0, *t;
+	float *rate;
+	int *xfered1;
+	unsigned int *eta_h, *eta_m, *eta_s;
+	int *remain, *howmany;
+} pmdlprogress_t;
+
+void _pacman_dlprogress_detach(pmdlprogress_t *saved);
+void _pacman_dlprogress_attach(const pmdlprogress_t *saved);
+
 #endif /* _PACMAN_SERVER_H */
 
 /* vim: set ts=2 sw=2 noet: */
@@ -0,0 +1,192 @@
+/*
+ *  strpool.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* The handle keeps a single copy of the strings the package lists of the
+ * databases share over and over: dependency and provision names, groups,
+ * licenses.  They are stored back to back in large blocks, and live as long
+ * as the handle; package lists point into them, so the lists of a package
+ * read from a database (pkg->interned) are freed without their strings, and
+ * two such strings are equal if and only if they are the same pointer.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libintl.h>
+/* pacman-g2 */
+#include "log.h"
+#include "error.h"
+#include "util.h"
+#include "strpool.h"
+
+#define STRPOOL_BLOCK (64*1024)
+
+pmstrpool_t *_pacman_strpool_new(void)
+{
+	pmstrpool_t *pool = _pacman_zalloc(sizeof(pmstrpool_t));
+
+	if(pool == NULL) {
+		return(NULL);
+	}
+	pool->size = 1024;
+	if((pool->slots = _pacman_zalloc(pool->size*sizeof(char *))) == NULL) {
+		free(pool);
+		return(NULL);
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	return(pool);
+}
+
+void _pacman_strpool_free(pmstrpool_t *pool)
+{
+	pmstrblock_t *block, *next;
+
+	if(pool == NULL) {
+		return;
+	}
+	for(block = pool->blocks; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	free(pool->slots);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+/* FNV-1a, also used by the other string keyed tables */
+size_t _pacman_strpool_hash(const char *str, size_t len)
+{
+	size_t hash = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char)str[i])*16777619u;
+	}
+	return(hash);
+}
+
+static int strpool_grow(pmstrpool_t *pool)
+{
+	size_t size = pool->size*2, i;
+	const char **slots = _pacman_zalloc(size*sizeof(char *));
+
+	if(slots == NULL) {
+		return(-1);
+	}
+	for(i = 0; i < pool->size; i++) {
+		if(pool->slots[i]) {
+			size_t j = _pacman_strpool_hash(pool->slots[i], strlen(pool->slots[i])) & (size-1);
+			while(slots[j]) {
+				j = (j+1) & (size-1);
+			}
+			slots[j] = pool->slots[i];
+		}
+	}
+	free(pool->slots);
+	pool->slots = slots;
+	pool->size = size;
+	return(0);
+}
+
+static char *strpool_store(pmstrpool_t *pool, const char *str, size_t len)
+{
+	pmstrblock_t *block = pool->blocks;
+	char *ret;
+
+	if(block == NULL || block->used+len+1 > block->size) {
+		size_t size = len+1 > STRPOOL_BLOCK ? len+1 : STRPOOL_BLOCK;
+		if((block = _pacman_malloc(sizeof(pmstrblock_t)+size)) == NULL) {
+			return(NULL);
+		}
+		block->used = 0;
+		block->size = size;
+		block->next = pool->blocks;
+		pool->blocks = block;
+	}
+	ret = block->data+block->used;
+	memcpy(ret, str, len);
+	ret[len] = '\0';
+	block->used += len+1;
+	pool->bytes += len+1;
+	return(ret);
+}
+
+static const char *strpool_intern(pmstrpool_t *pool, const char *str, size_t len, int ref)
+{
+	const char *ret;
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	i = _pacman_strpool_hash(str, len) & (pool->size-1);
+	while((ret = pool->slots[i])) {
+		if(!strncmp(ret, str, len) && ret[len] == '\0') {
+			if(ref) {
+				pool->refs++;
+				pool->saved += len+1;
+			}
+			pthread_mutex_unlock(&pool->lock);
+			return(ret);
+		}
+		i = (i+1) & (pool->size-1);
+	}
+	if((ret = strpool_store(pool, str, len)) != NULL) {
+		pool->slots[i] = ret;
+		pool->refs += ref;
+		/* keep it at most half full */
+		if(++pool->count*2 > pool->size) {
+			strpool_grow(pool);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return(ret);
+}
+
+/* the pooled copy of the len first bytes of str
+ * Returns NULL on error.
+ */
+const char *_pacman_strpool_intern(pmstrpool_t *pool, const char *str, size_t len)
+{
+	return(strpool_intern(pool, str, len, 1));
+}
+
+/* the pooled copy of str, to compare it with pooled strings by pointer
+ * It is added to the pool if it is not there yet: the packages read later
+ * will use the same copy.  Returns NULL if there is no pool (or on error).
+ */
+const char *_pacman_strpool_key(pmstrpool_t *pool, const char *str)
+{
+	if(pool == NULL || str == NULL) {
+		return(NULL);
+	}
+	return(strpool_intern(pool, str, strlen(str), 0));
+}
+
+void _pacman_strpool_stats(pmstrpool_t *pool)
+{
+	if(pool == NULL || pool->refs == 0) {
+		return;
+	}
+	_pacman_log(PM_LOG_DEBUG, _("string pool: %lu strings (%lu bytes) for %lu references, %lu bytes saved"),
+		(unsigned long)pool->count, (unsigned long)pool->bytes, pool->refs, (unsigned long)pool->saved);
+}
+
+/* vim: set ts=2 sw=2 noet: */
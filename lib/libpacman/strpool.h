@@ -0,0 +1,55 @@
+/*
+ *  strpool.h
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+#ifndef _PACMAN_STRPOOL_H
+#define _PACMAN_STRPOOL_H
+
+#include <pthread.h>
+
+/* a block of interned strings */
+typedef struct __pmstrblock_t {
+	struct __pmstrblock_t *next;
+	size_t used, size;
+	char data[];
+} pmstrblock_t;
+
+typedef struct __pmstrpool_t {
+	pthread_mutex_t lock; /* the caches of several dbs may load at once */
+	const char **slots;   /* open addressing, linear probing */
+	size_t size, count;
+	pmstrblock_t *blocks;
+	/* statistics */
+	size_t bytes;         /* taken by the strings */
+	unsigned long refs;   /* interned, counting the duplicates */
+	size_t saved;         /* duplicate bytes not stored again */
+} pmstrpool_t;
+
+#define FREESTRPOOL(p) do { if(p) { _pacman_strpool_free(p); p = NULL; } } while(0)
+
+pmstrpool_t *_pacman_strpool_new(void);
+void _pacman_strpool_free(pmstrpool_t *pool);
+const char *_pacman_strpool_intern(pmstrpool_t *pool, const char *str, size_t len);
+const char *_pacman_strpool_key(pmstrpool_t *pool, const char *str);
+size_t _pacman_strpool_hash(const char *str, size_t len);
+void _pacman_strpool_stats(pmstrpool_t *pool);
+
+#endif /* _PACMAN_STRPOOL_H */
+
+/* vim: set ts=2 sw=2 noet: */
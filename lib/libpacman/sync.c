@@ -67,6 +67,11 @@ pmsyncpkg_t *_pacman_sync_new(int type, pmpkg_t *spkg, void *data)
 	ps->type = type;
 	ps->pkg = spkg;
 	ps->data = data;
+	/* sync cache entries may come with nothing but a name and a version, but
+	 * the transaction reads the fields of its packages directly */
+	if(spkg->origin == PKG_FROM_CACHE && (~spkg->infolevel & (INFRQ_DESC | INFRQ_DEPENDS))) {
+		_pacman_db_read(spkg->data, ~spkg->infolevel & (INFRQ_DESC | INFRQ_DEPENDS), spkg);
+	}
 
 	return(ps);
 }
@@ -39,6 +39,7 @@
 #include "sync.h"
 #include "cache.h"
 #include "pacman.h"
+#include "be_journal.h"
 
 #include "trans_sysupgrade.h"
 
@@ -108,6 +109,8 @@ int _pacman_trans_init(pmtrans_t *trans, pmtranstype_t type, unsigned int flags,
 		break;
 		case PM_TRANS_TYPE_SYNC:
 			trans->ops = &_pacman_sync_pmtrans_opts;
+			/* every sync db will be looked at, load them all at once */
+			_pacman_db_load_pkgcaches(handle->dbs_sync);
 		break;
 		default:
 			trans->ops = NULL;
@@ -226,10 +229,23 @@ int _pacman_trans_commit(pmtrans_t *trans, pmlist_t **data)
 		return(0);
 	}
 
+	/* the changes of the local db are a single group, applied at the end */
+	if(_pacman_journal_begin(handle->db_local) == -1) {
+		/* pm_errno is set by _pacman_journal_begin() */
+		return(-1);
+	}
+
 	_pacman_trans_set_state(trans, STATE_COMMITING);
 
 	if(trans->ops->commit(trans, data) == -1) {
 		/* pm_errno is set by trans->ops->commit() */
+		/* the db changes of the packages done so far are kept */
+		_pacman_journal_flush(handle->db_local);
+		_pacman_trans_set_state(trans, STATE_PREPARED);
+		return(-1);
+	}
+	if(_pacman_journal_commit(handle->db_local) == -1) {
+		/* pm_errno is set by _pacman_journal_commit() */
 		_pacman_trans_set_state(trans, STATE_PREPARED);
 		return(-1);
 	}
@@ -64,6 +64,7 @@
 #include "util.h"
 #include "error.h"
 #include "pacman.h"
+#include "readahead.h"
 
 #ifdef __sun__
 /* This is a replacement for strsep which is not portable (missing on Solaris).
@@ -287,6 +288,41 @@ static int list_startswith(char *needle, pmlist_t *haystack)
 	return(0);
 }
 
+/* tells if a directory entry is a directory
+ * d_type tells it for free on most filesystems, so stat only if it is not
+ * filled in, or for symlinks (we follow them, like stat() does)
+ */
+int _pacman_dirent_isdir(DIR *dir, struct dirent *ent)
+{
+	struct stat buf;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+	if(ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK) {
+		return(ent->d_type == DT_DIR);
+	}
+#endif
+	if(fstatat(dirfd(dir), ent->d_name, &buf, 0)) {
+		return(0);
+	}
+	return(S_ISDIR(buf.st_mode));
+}
+
+/* returns the next subdirectory of dir, skipping "." and ".." */
+struct dirent *_pacman_readdir_subdir(DIR *dir)
+{
+	struct dirent *ent;
+
+	while((ent = readdir(dir)) != NULL) {
+		if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
+			continue;
+		}
+		if(_pacman_dirent_isdir(dir, ent)) {
+			return(ent);
+		}
+	}
+	return(NULL);
+}
+
 int _pacman_unpack(const char *archive, const char *prefix, const char *fn)
 {
 	register struct archive *_archive;
@@ -295,21 +331,13 @@ int _pacman_unpack(const char *archive, const char *prefix, const char *fn)
 	pmlist_t *cache = NULL, *i;
 	DIR *dirhandle;
 	struct dirent *ent;
-	struct stat buf;
 
 	/* first scan though the old dir to see what package entries do we have */
 	dirhandle = opendir(prefix);
 	if (dirhandle != NULL) {
-		while((ent = readdir(dirhandle)) != NULL) {
+		/* we cache only dirs */
+		while((ent = _pacman_readdir_subdir(dirhandle)) != NULL) {
 			cache_t *c;
-			if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-				continue;
-			}
-			/* we cache only dirs */
-			snprintf(expath, PATH_MAX, "%s/%s", prefix, ent->d_name);
-			if(stat(expath, &buf) || !S_ISDIR(buf.st_mode)) {
-				continue;
-			}
 			c = _pacman_malloc(sizeof(cache_t));
 			if (!c)
 				return(-1);
@@ -317,23 +345,19 @@ int _pacman_unpack(const char *archive, const char *prefix, const char *fn)
 			c->str = strdup(ent->d_name);
 			cache = _pacman_list_add(cache, c);
 		}
+		closedir(dirhandle);
 	}
-	closedir(dirhandle);
 
 	/* now extract the new entries */
-	if ((_archive = archive_read_new ()) == NULL)
-		RET_ERR(PM_ERR_LIBARCHIVE_ERROR, -1);
-
-	archive_read_support_compression_all(_archive);
-	archive_read_support_format_all (_archive);
-
-	if (archive_read_open_file (_archive, archive, PM_DEFAULT_BYTES_PER_BLOCK) != ARCHIVE_OK)
+	if ((_archive = _pacman_archive_open (archive)) == NULL)
 		RET_ERR(PM_ERR_PKG_OPEN, -1);
 
 	while (archive_read_next_header (_archive, &entry) == ARCHIVE_OK) {
 		if (fn && strcmp (fn, archive_entry_pathname (entry))) {
-			if (archive_read_data_skip (_archive) != ARCHIVE_OK)
+			if (archive_read_data_skip (_archive) != ARCHIVE_OK) {
+				archive_read_finish (_archive);
 				return(1);
+			}
 			continue;
 		}
 		if (list_startswith((char*)archive_entry_pathname(entry), cache)) {
@@ -343,7 +367,8 @@ int _pacman_unpack(const char *archive, const char *prefix, const char *fn)
 		archive_entry_set_pathname (entry, expath);
 		if (archive_read_extract (_archive, entry, ARCHIVE_EXTRACT_FLAGS) != ARCHIVE_OK) {
 			fprintf(stderr, _("could not extract %s: %s\n"), archive_entry_pathname (entry), archive_error_string (_archive));
-			 return(1);
+			archive_read_finish (_archive);
+			return(1);
 		}
 
 		if (fn)
@@ -809,35 +834,44 @@ int _pacman_reg_match(char *string, char *pattern)
 	return(!(result));
 }
 
-char *_pacman_archive_fgets(char *line, size_t size, struct archive *a)
+#endif
+
+static int archive_reserve(char **data, size_t len, size_t *size, size_t want)
 {
-	/* for now, just read one char at a time until we get to a
-	 * '\n' char. we can optimize this later with an internal
-	 * buffer. */
-	/* leave room for zero terminator */
-	char *last = line + size - 1;
-	char *i;
-
-	for(i = line; i < last; i++) {
-		int ret = archive_read_data(a, i, 1);
-		/* special check for first read- if null, return null,
-		 * this indicates EOF */
-		if(i == line && (ret <= 0 || *i == '\0')) {
-			return(NULL);
-		}
-		/* check if read value was null or newline */
-		if(ret <= 0 || *i == '\0' || *i == '\n') {
-			last = i + 1;
-			break;
+	if(len+want > *size) {
+		size_t newsize = *size ? *size*2 : want;
+		char *ptr;
+		while(newsize < len+want) {
+			newsize *= 2;
 		}
+		if((ptr = realloc(*data, newsize)) == NULL) {
+			RET_ERR(PM_ERR_MEMORY, -1);
+		}
+		*data = ptr;
+		*size = newsize;
 	}
+	return(0);
+}
 
-	/* always null terminate the buffer */
-	*last = '\0';
+/* Appends the data of the current member of an archive to *data, which has
+ * *size bytes allocated, *len of them used, growing it as needed.  The
+ * buffer is sized from the header, so that a member takes a single
+ * archive_read_data() call (plus the one seeing its end) most of the time.
+ */
+int _pacman_archive_read_entry(struct archive *a, struct archive_entry *ae, char **data, size_t *len, size_t *size)
+{
+	ssize_t n;
 
-	return(line);
+	if(archive_reserve(data, *len, size, archive_entry_size(ae) > 0 ? archive_entry_size(ae)+1 : 4096) == -1) {
+		return(-1);
+	}
+	while((n = archive_read_data(a, *data+*len, *size-*len)) > 0) {
+		*len += n;
+		if(*len == *size && archive_reserve(data, *len, size, 4096) == -1) {
+			return(-1);
+		}
+	}
+	return(n < 0 ? -1 : 0);
 }
 
-#endif
-
 /* vim: set ts=2 sw=2 noet: */
@@ -37,6 +37,7 @@
 #include <archive_entry.h>
 #endif
 #include <libintl.h>
+#include <dirent.h>
 
 #include "error.h"
 
@@ -66,6 +67,8 @@ char *_pacman_strtoupper(char *str);
 char *_pacman_strtrim(char *str);
 int _pacman_lckmk(char *file);
 int _pacman_lckrm(char *file);
+int _pacman_dirent_isdir(DIR *dir, struct dirent *ent);
+struct dirent *_pacman_readdir_subdir(DIR *dir);
 int _pacman_unpack(const char *archive, const char *prefix, const char *fn);
 int _pacman_rmrf(char *path);
 int _pacman_logaction(unsigned char usesyslog, FILE *f, char *fmt, ...);
@@ -82,7 +85,7 @@ int _pacman_reg_match(char *string, char *pattern);
 char* strsep(char** str, const char* delims);
 char* mkdtemp(char *template);
 #endif
-char *_pacman_archive_fgets(char *line, size_t size, struct archive *a);
+int _pacman_archive_read_entry(struct archive *a, struct archive_entry *ae, char **data, size_t *len, size_t *size);
 
 static inline void *_pacman_malloc(size_t size)
 {
@@ -0,0 +1,207 @@
+#! /usr/bin/python
+#
+#  Copyright (c) 2026 by agent <agent@local>
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+#  USA.
+
+# Generates a local (or sync) database with lots of entries and counts the
+# syscalls pacman-g2 makes on it (using strace -c, or the syscount.c preload
+# library where strace is not available), or measures how long it takes (the
+# best of several runs), see HACKING.
+
+import getopt
+import os
+import sys
+import tempfile
+import time
+import shutil
+
+import pmdb
+import pmpkg
+import util
+
+
+def usage(retcode):
+	"""
+	"""
+	print "Usage: %s [options] [-- pacman-g2 arguments]\n" % __file__
+	print "  -p, --pacman=<binary>   pacman-g2 binary to run"
+	print "  -n, --entries=<number>  number of db entries (default: 5000)"
+	print "  -s, --sync              generate a sync db instead (default arguments:"
+	print "                          -Ss nomatch), removing its pack before each run"
+	print "  -P, --provides          make each entry depend on a name provided by the"
+	print "                          previous one, instead of on the previous one"
+	print "  -o, --option=<line>     add a line to the [options] section"
+	print "  -k, --keep              do not remove the generated root"
+	print "  -t, --time=<runs>       measure the time of <runs> runs instead of"
+	print "                          counting the syscalls"
+	print "  -c, --syscount          count the calls with syscount.c even if strace"
+	print "                          is available"
+	sys.exit(retcode)
+
+def mkroot(root, entries, options, sync, provides):
+	"""
+	"""
+	if sync:
+		db = pmdb.pmdb("sync", root)
+	else:
+		db = pmdb.pmdb("local", root)
+	for i in range(entries):
+		pkg = pmpkg.pmpkg("pkg%05d" % i)
+		pkg.desc = "benchmark package %d" % i
+		pkg.groups = ["group%d" % (i % 16)]
+		pkg.url = "http://www.frugalware.org/packages/pkg%05d" % i
+		pkg.license = ["GPL2"]
+		pkg.packager = "Benchmark <bench@frugalware.org>"
+		pkg.provides = ["virtual%d" % (i % 64)]
+		if provides:
+			pkg.provides.append("chain%05d" % i)
+		pkg.files = ["usr/", "usr/share/", "usr/share/pkg%05d/" % i, "usr/share/pkg%05d/data" % i]
+		if i and provides:
+			pkg.depends = ["chain%05d" % (i - 1)]
+		elif i:
+			pkg.depends = ["pkg%05d" % (i - 1)]
+		if i + 1 < entries:
+			pkg.requiredby = ["pkg%05d" % (i + 1)]
+		db.db_write(pkg)
+	data = ["[options]"]
+	data.extend(options)
+	if sync:
+		db.gensync()
+		shutil.rmtree(db.dbdir)
+		os.makedirs(os.path.join(root, util.PM_DBPATH, "local"))
+		data.extend(["[sync]", "Server = file:///nonexistent"])
+	util.mkfile(os.path.join(root, util.PACCONF), "\n".join(data))
+	os.makedirs(os.path.join(root, util.TMPDIR))
+
+def which(program):
+	"""
+	"""
+	for i in os.environ.get("PATH", "").split(os.pathsep):
+		path = os.path.join(i, program)
+		if os.access(path, os.X_OK):
+			return path
+	return None
+
+def mksyscount(root):
+	"""Builds the preload library counting the calls into root
+	"""
+	source = os.path.join(os.path.dirname(os.path.abspath(__file__)), "syscount.c")
+	library = os.path.join(root, "syscount.so")
+	if os.system("cc -shared -fPIC -o %s %s -ldl" % (library, source)) != 0:
+		return None
+	return library
+
+def syscalls(output):
+	"""Parses the summary of strace -c or the output of syscount.c
+	"""
+	ret = {}
+	for line in open(output).readlines():
+		fields = line.split()
+		if len(fields) == 2 and fields[0].isdigit():
+			ret[fields[1]] = int(fields[0])
+		elif len(fields) >= 5 and fields[0][0].isdigit():
+			ret[fields[-1]] = int(fields[3])
+	return ret
+
+
+if __name__ == "__main__":
+	pacman = "pacman-g2"
+	entries = 5000
+	options = []
+	keep = 0
+	runs = 0
+	sync = 0
+	provides = 0
+	syscount = 0
+
+	try:
+		opts, args = getopt.getopt(sys.argv[1:], "chkn:o:p:Pst:",
+		                           ["help", "keep", "entries=", "option=", "pacman=", "provides", "sync", "syscount", "time="])
+	except getopt.GetoptError:
+		usage(1)
+
+	for (cmd, param) in opts:
+		if cmd == "-p" or cmd == "--pacman":
+			pacman = os.path.abspath(param)
+		elif cmd == "-n" or cmd == "--entries":
+			entries = int(param)
+		elif cmd == "-o" or cmd == "--option":
+			options.append(param)
+		elif cmd == "-k" or cmd == "--keep":
+			keep = 1
+		elif cmd == "-s" or cmd == "--sync":
+			sync = 1
+		elif cmd == "-P" or cmd == "--provides":
+			provides = 1
+		elif cmd == "-t" or cmd == "--time":
+			runs = int(param)
+		elif cmd == "-c" or cmd == "--syscount":
+			syscount = 1
+		elif cmd == "-h" or cmd == "--help":
+			usage(0)
+	if not args:
+		if sync:
+			args = ["-Ss", "nomatch"]
+		else:
+			args = ["-Q"]
+
+	root = tempfile.mkdtemp(prefix="dbbench.")
+	mkroot(root, entries, options, sync, provides)
+	output = os.path.join(root, "syscalls.log")
+	cmd = "%s --config=%s --root=%s %s >/dev/null" \
+	      % (pacman, os.path.join(root, util.PACCONF), root, " ".join(args))
+	pack = os.path.join(root, util.PM_DBPATH, "sync.pack")
+	if runs:
+		best = None
+		for i in range(runs):
+			if sync and os.path.exists(pack):
+				# read the archive every time, not the pack of the previous run
+				os.unlink(pack)
+			start = time.time()
+			retcode = os.system(cmd)
+			elapsed = time.time() - start
+			if retcode != 0:
+				break
+			if best is None or elapsed < best:
+				best = elapsed
+	elif not syscount and which("strace"):
+		cmd = "strace -f -c -o %s %s" % (output, cmd)
+		retcode = os.system(cmd)
+	else:
+		library = mksyscount(root)
+		if library is None:
+			util.err("failed to build syscount.c")
+			retcode = 1
+		else:
+			cmd = "SYSCOUNT_OUTPUT=%s LD_PRELOAD=%s %s" % (output, library, cmd)
+			retcode = os.system(cmd)
+	if retcode == 0:
+		print "%d entries, pacman-g2 %s" % (entries, " ".join(args))
+		if runs:
+			print "best of %d runs: %.3fs" % (runs, best)
+		else:
+			calls = syscalls(output)
+			for name in sorted(calls.keys()):
+				print "%-16s %8d" % (name, calls[name])
+	else:
+		util.err("'%s' failed" % cmd)
+
+	if keep:
+		print "root kept in %s" % root
+	else:
+		shutil.rmtree(root)
+	sys.exit(retcode != 0)
@@ -21,6 +21,7 @@
 import os
 import tempfile
 import shutil
+import StringIO
 
 import pmpkg
 from util import *
@@ -85,6 +86,7 @@ class pmdb:
 	def __init__(self, treename, root):
 		self.treename = treename
 		self.pkgs = []
+		self.combined = 0
 		self.dbdir = os.path.join(root, PM_DBPATH, treename)
 		if self.treename != "local":
 			self.dbfile = os.path.join(root, PM_DBPATH, treename + ".fdb")
@@ -121,9 +123,22 @@ class pmdb:
 		[pkgname, pkgver, pkgrel] = dbentry.rsplit("-", 2)
 		pkg = pmpkg.pmpkg(pkgname, pkgver + "-" + pkgrel)
 
+		# meta: the combined record of desc and depends (CombinedDB)
+		meta = os.path.join(path, "meta")
+		if os.path.isfile(meta):
+			fd = file(meta, "r")
+			[magic, desclen, deplen] = fd.readline().split()
+			desc = fd.read(int(desclen))
+			depends = fd.read(int(deplen))
+			fd.close()
+
 		# desc
-		filename = os.path.join(path, "desc")
-		fd = file(filename, "r")
+		if os.path.isfile(meta):
+			filename = meta
+			fd = StringIO.StringIO(desc)
+		else:
+			filename = os.path.join(path, "desc")
+			fd = file(filename, "r")
 		while 1:
 			line = fd.readline()
 			if not line:
@@ -176,6 +191,15 @@ class pmdb:
 					line = fd.readline().strip("\n")
 					if line and line[-1] != "/":
 						pkg.files.append(line)
+			if line == "%CFILES%":
+				prev = ""
+				while line:
+					line = fd.readline().strip("\n")
+					if line:
+						[shared, rest] = line.split(" ", 1)
+						prev = prev[:int(shared)] + rest
+						if prev[-1] != "/":
+							pkg.files.append(prev)
 			if line == "%BACKUP%":
 				pkg.backup = _getsection(fd)
 		fd.close()
@@ -183,8 +207,12 @@ class pmdb:
 		pkg.mtime["files"] = getmtime(filename)
 
 		# depends
-		filename = os.path.join(path, "depends")
-		fd = file(filename, "r")
+		if os.path.isfile(meta):
+			filename = meta
+			fd = StringIO.StringIO(depends)
+		else:
+			filename = os.path.join(path, "depends")
+			fd = file(filename, "r")
 		while 1:
 			line = fd.readline()
 			if not line:
@@ -271,10 +299,12 @@ class pmdb:
 				data.append(_mksection("STICK", ""))
 		if data:
 			data.append("")
-		filename = os.path.join(path, "desc")
-		mkfile(filename, "\n".join(data))
-		pkg.checksum["desc"] = getsha1sum(filename)
-		pkg.mtime["desc"] = getmtime(filename)
+		desc = "\n".join(data)
+		if not self.combined:
+			filename = os.path.join(path, "desc")
+			mkfile(filename, desc)
+			pkg.checksum["desc"] = getsha1sum(filename)
+			pkg.mtime["desc"] = getmtime(filename)
 
 		# files
 		# for local entries, fields are: files, backup
@@ -307,10 +337,22 @@ class pmdb:
 			data.append(_mksection("PROVIDES", pkg.provides))
 		if data:
 			data.append("")
-		filename = os.path.join(path, "depends")
-		mkfile(filename, "\n".join(data))
-		pkg.checksum["depends"] = getsha1sum(filename)
-		pkg.mtime["depends"] = getmtime(filename)
+		depends = "\n".join(data)
+		if not self.combined:
+			filename = os.path.join(path, "depends")
+			mkfile(filename, depends)
+			pkg.checksum["depends"] = getsha1sum(filename)
+			pkg.mtime["depends"] = getmtime(filename)
+		else:
+			# meta, for local entries only: both in a single file, and the
+			# marker telling pacman-g2 to look for it
+			filename = os.path.join(path, "meta")
+			fd = file(filename, "w")
+			fd.write("%%META%% %d %d\n%s%s" % (len(desc), len(depends), desc, depends))
+			fd.close()
+			pkg.checksum["desc"] = pkg.checksum["depends"] = getsha1sum(filename)
+			pkg.mtime["desc"] = pkg.mtime["depends"] = getmtime(filename)
+			mkfile(self.dbdir + ".meta")
 
 		# install
 		if self.treename == "local":
@@ -338,6 +380,25 @@ class pmdb:
 
 		os.chdir(curdir)
 
+	def genfilesdb(self, serverpath):
+		"""Generate the files database of the packages, in serverpath.
+		"""
+
+		tmpdir = tempfile.mkdtemp()
+		for pkg in self.pkgs:
+			path = os.path.join(tmpdir, pkg.dbname())
+			os.mkdir(path)
+			data = []
+			if pkg.files:
+				data.append(_mksection("FILES", _mkfilelist(pkg.files)))
+			mkfile(os.path.join(path, "files"), "\n".join(data))
+		filesdb = os.path.join(serverpath, self.treename + ".files.fdb")
+		curdir = os.getcwd()
+		os.chdir(tmpdir)
+		os.system("tar zcf %s *" % filesdb)
+		os.chdir(curdir)
+		shutil.rmtree(tmpdir)
+
 	def ispkgmodified(self, pkg):
 		"""
 		"""
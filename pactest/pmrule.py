@@ -120,6 +120,26 @@ class pmrule:
 						success = 0
 				else:
 					success = -1
+		elif kind == "PACK":
+			# what the next run reads from the packed local database: only
+			# a pack stamped like the directory layout is used
+			dbdir = os.path.join(root, PM_DBPATH, "local")
+			pack = readpack(dbdir + ".pack")
+			if not pack:
+				success = 0
+			else:
+				[mtime, mtimensec, entries] = pack
+				st = os.stat(dbdir)
+				if abs(mtime + mtimensec / 1e9 - st.st_mtime) > 1e-6:
+					success = 0
+				elif case == "EXIST":
+					if not key in entries:
+						success = 0
+				elif case == "VERSION":
+					if entries.get(key) != value:
+						success = 0
+				else:
+					success = -1
 		elif kind == "LINK":
 			filename = os.path.join(root, key)
 			if case == "EXIST":
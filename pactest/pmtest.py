@@ -19,6 +19,8 @@
 
 
 import os
+import sys
+import glob
 import shutil
 import time
 
@@ -48,6 +50,14 @@ class pmtest:
 			self.db[treename] = pmdb.pmdb(treename, self.root)
 		self.db[treename].pkgs.append(pkg)
 
+	def addpkg2serverdb(self, treename, pkg):
+		"""The server has moved on since the local copy of the treename sync db
+		was synced: it serves a database of those packages, with a delta.
+		"""
+		if not treename in self.serverdb:
+			self.serverdb[treename] = []
+		self.serverdb[treename].append(pkg)
+
 	def addpkg(self, pkg):
 		"""
 		"""
@@ -73,8 +83,14 @@ class pmtest:
 		self.db = {
 			"local": pmdb.pmdb("local", self.root)
 		}
+		self.serverdb = {}
+		# whether the server also has the deltas to its dbs
+		self.serverdeltas = 1
 		self.localpkgs = []
 		self.filesystem = []
+		# path -> content written as is, or a function of the root
+		# returning it
+		self.rawfiles = {}
 
 		self.description = ""
 		self.option = {
@@ -154,7 +170,12 @@ class pmtest:
 			value.gensync()
 			serverpath = os.path.join(syncdir, value.treename)
 			os.mkdir(serverpath)
-			shutil.copy(value.dbfile, serverpath)
+			if key in self.serverdb:
+				self.genserverdb(value, serverpath)
+			else:
+				shutil.copy(value.dbfile, serverpath)
+			if "FilesDB" in self.option:
+				value.genfilesdb(serverpath)
 
 		# Filesystem
 		vprint("    Populating file system")
@@ -164,6 +185,13 @@ class pmtest:
 		for f in self.filesystem:
 			vprint("\t%s" % f)
 			mkfile(os.path.join(self.root, f), f)
+		for f, data in self.rawfiles.iteritems():
+			vprint("\t%s" % f)
+			if callable(data):
+				data = data(self.root)
+			fd = open(os.path.join(self.root, f), "wb")
+			fd.write(data)
+			fd.close()
 
 		# Done.
 		vprint("    Taking a snapshot of the file system")
@@ -174,6 +202,38 @@ class pmtest:
 				self.files.append(f)
 				vprint("\t%s" % f.name)
 
+	def genserverdb(self, db, serverpath):
+		"""Serves the current database of the db tree, and the deltas to it
+		from the local copy.
+		"""
+		cachedir = os.path.join(self.root, PM_CACHEDIR)
+		newdb = pmdb.pmdb(db.treename, os.path.join(self.root, TMPDIR, "server"))
+		os.makedirs(newdb.dbdir)
+		for pkg in self.serverdb[db.treename]:
+			archive = pkg.filename()
+			vprint("\t%s" % os.path.join(PM_CACHEDIR, archive))
+			pkg.makepkg(cachedir)
+			pkg.sha1sum = getsha1sum(os.path.join(cachedir, archive))
+			pkg.csize = os.stat(os.path.join(cachedir, archive))[stat.ST_SIZE]
+			newdb.db_write(pkg)
+		newdb.gensync()
+
+		# the local copy was synced an hour ago
+		mtime = time.time() - 3600
+		os.utime(db.dbfile, (mtime, mtime))
+		fd = open(os.path.join(self.root, PM_DBPATH, db.treename + ".lastupdate"), "w")
+		fd.write(time.strftime("%Y%m%d%H%M%S", time.gmtime(mtime)))
+		fd.close()
+
+		if not self.serverdeltas:
+			shutil.copy2(newdb.dbfile, serverpath)
+			return
+		gendelta = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "scripts", "gendelta")
+		os.system("%s %s %s %s >/dev/null" % (sys.executable, gendelta, newdb.dbfile, db.dbfile))
+		shutil.copy2(newdb.dbfile, serverpath)
+		for delta in glob.glob(os.path.join(os.path.dirname(newdb.dbfile), "*.fdd")):
+			shutil.move(delta, serverpath)
+
 	def run(self, pacman):
 		"""
 		"""
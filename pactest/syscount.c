@@ -0,0 +1,321 @@
+/*
+ *  syscount.c
+ *
+ *  Copyright (c) 2026 by agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ *  USA.
+ */
+
+/* Counts the calls a program makes to the libc wrappers of the file
+ * syscalls, for dbbench.py when strace is not available:
+ *
+ *   $ cc -shared -fPIC -o syscount.so syscount.c -ldl
+ *   $ SYSCOUNT_OUTPUT=calls.log LD_PRELOAD=./syscount.so pacman-g2 -Q
+ *
+ * Each line of the output is "<calls> <name>", where name is the syscall
+ * strace would report (the stat and open variants are counted under stat,
+ * lstat, fstat, newfstatat and openat, like on x86_64).  Only the calls
+ * going through the exported libc symbols are seen: the ones libc makes
+ * internally are counted as the function the program called instead
+ * (fopen() as an openat), and readdir() is counted per entry returned, as
+ * readdir, since how many getdents64 it takes is up to libc.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum {
+	SC_OPENAT, SC_READ, SC_WRITE, SC_CLOSE, SC_STAT, SC_LSTAT, SC_FSTAT,
+	SC_NEWFSTATAT, SC_READDIR, SC_MMAP, SC_ACCESS, SC_UNLINK, SC_RENAME,
+	SC_MKDIR, SC_FSYNC, SC_MAX
+};
+
+static const char *names[SC_MAX] = {
+	"openat", "read", "write", "close", "stat", "lstat", "fstat",
+	"newfstatat", "readdir", "mmap", "access", "unlink", "rename",
+	"mkdir", "fsync"
+};
+
+static unsigned long counts[SC_MAX];
+static pid_t owner;
+
+#define COUNT(sc) __sync_fetch_and_add(&counts[sc], 1)
+/* the libc function a wrapper calls */
+#define NEXT(ret, name, args) static ret (*next_##name)args; \
+	if(next_##name == NULL) { next_##name = dlsym(RTLD_NEXT, #name); }
+
+__attribute__((constructor)) static void syscount_init(void)
+{
+	owner = getpid();
+}
+
+/* the counts of the process which was started, not of its children */
+__attribute__((destructor)) static void syscount_fini(void)
+{
+	const char *path = getenv("SYSCOUNT_OUTPUT");
+	FILE *fp;
+	int i;
+
+	if(path == NULL || getpid() != owner || (fp = fopen(path, "w")) == NULL) {
+		return;
+	}
+	for(i = 0; i < SC_MAX; i++) {
+		if(counts[i]) {
+			fprintf(fp, "%lu %s\n", counts[i], names[i]);
+		}
+	}
+	fclose(fp);
+}
+
+static mode_t open_mode(int flags, va_list args)
+{
+	return((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE ? va_arg(args, mode_t) : 0);
+}
+
+int open(const char *path, int flags, ...)
+{
+	NEXT(int, open, (const char *, int, ...));
+	va_list args;
+	mode_t mode;
+
+	va_start(args, flags);
+	mode = open_mode(flags, args);
+	va_end(args);
+	COUNT(SC_OPENAT);
+	return(next_open(path, flags, mode));
+}
+
+int open64(const char *path, int flags, ...)
+{
+	NEXT(int, open64, (const char *, int, ...));
+	va_list args;
+	mode_t mode;
+
+	va_start(args, flags);
+	mode = open_mode(flags, args);
+	va_end(args);
+	COUNT(SC_OPENAT);
+	return(next_open64(path, flags, mode));
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+	NEXT(int, openat, (int, const char *, int, ...));
+	va_list args;
+	mode_t mode;
+
+	va_start(args, flags);
+	mode = open_mode(flags, args);
+	va_end(args);
+	COUNT(SC_OPENAT);
+	return(next_openat(dirfd, path, flags, mode));
+}
+
+int openat64(int dirfd, const char *path, int flags, ...)
+{
+	NEXT(int, openat64, (int, const char *, int, ...));
+	va_list args;
+	mode_t mode;
+
+	va_start(args, flags);
+	mode = open_mode(flags, args);
+	va_end(args);
+	COUNT(SC_OPENAT);
+	return(next_openat64(dirfd, path, flags, mode));
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+	NEXT(FILE *, fopen, (const char *, const char *));
+	COUNT(SC_OPENAT);
+	return(next_fopen(path, mode));
+}
+
+FILE *fopen64(const char *path, const char *mode)
+{
+	NEXT(FILE *, fopen64, (const char *, const char *));
+	COUNT(SC_OPENAT);
+	return(next_fopen64(path, mode));
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+	NEXT(ssize_t, read, (int, void *, size_t));
+	COUNT(SC_READ);
+	return(next_read(fd, buf, count));
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	NEXT(ssize_t, write, (int, const void *, size_t));
+	COUNT(SC_WRITE);
+	return(next_write(fd, buf, count));
+}
+
+int close(int fd)
+{
+	NEXT(int, close, (int));
+	COUNT(SC_CLOSE);
+	return(next_close(fd));
+}
+
+/* glibc >= 2.33 exports the stat family, older ones the __xstat one */
+#define STAT(name, type, sc) \
+int name(const char *path, struct type *buf) \
+{ \
+	NEXT(int, name, (const char *, struct type *)); \
+	COUNT(sc); \
+	return(next_##name(path, buf)); \
+}
+#define XSTAT(name, type, sc) \
+int name(int ver, const char *path, struct type *buf) \
+{ \
+	NEXT(int, name, (int, const char *, struct type *)); \
+	COUNT(sc); \
+	return(next_##name(ver, path, buf)); \
+}
+
+STAT(stat, stat, SC_STAT)
+STAT(stat64, stat64, SC_STAT)
+STAT(lstat, stat, SC_LSTAT)
+STAT(lstat64, stat64, SC_LSTAT)
+XSTAT(__xstat, stat, SC_STAT)
+XSTAT(__xstat64, stat64, SC_STAT)
+XSTAT(__lxstat, stat, SC_LSTAT)
+XSTAT(__lxstat64, stat64, SC_LSTAT)
+
+int fstat(int fd, struct stat *buf)
+{
+	NEXT(int, fstat, (int, struct stat *));
+	COUNT(SC_FSTAT);
+	return(next_fstat(fd, buf));
+}
+
+int fstat64(int fd, struct stat64 *buf)
+{
+	NEXT(int, fstat64, (int, struct stat64 *));
+	COUNT(SC_FSTAT);
+	return(next_fstat64(fd, buf));
+}
+
+int __fxstat(int ver, int fd, struct stat *buf)
+{
+	NEXT(int, __fxstat, (int, int, struct stat *));
+	COUNT(SC_FSTAT);
+	return(next___fxstat(ver, fd, buf));
+}
+
+int __fxstat64(int ver, int fd, struct stat64 *buf)
+{
+	NEXT(int, __fxstat64, (int, int, struct stat64 *));
+	COUNT(SC_FSTAT);
+	return(next___fxstat64(ver, fd, buf));
+}
+
+int fstatat(int dirfd, const char *path, struct stat *buf, int flags)
+{
+	NEXT(int, fstatat, (int, const char *, struct stat *, int));
+	COUNT(SC_NEWFSTATAT);
+	return(next_fstatat(dirfd, path, buf, flags));
+}
+
+int fstatat64(int dirfd, const char *path, struct stat64 *buf, int flags)
+{
+	NEXT(int, fstatat64, (int, const char *, struct stat64 *, int));
+	COUNT(SC_NEWFSTATAT);
+	return(next_fstatat64(dirfd, path, buf, flags));
+}
+
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *buf, int flags)
+{
+	NEXT(int, __fxstatat, (int, int, const char *, struct stat *, int));
+	COUNT(SC_NEWFSTATAT);
+	return(next___fxstatat(ver, dirfd, path, buf, flags));
+}
+
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *buf, int flags)
+{
+	NEXT(int, __fxstatat64, (int, int, const char *, struct stat64 *, int));
+	COUNT(SC_NEWFSTATAT);
+	return(next___fxstatat64(ver, dirfd, path, buf, flags));
+}
+
+struct dirent *readdir(DIR *dir)
+{
+	NEXT(struct dirent *, readdir, (DIR *));
+	COUNT(SC_READDIR);
+	return(next_readdir(dir));
+}
+
+struct dirent64 *readdir64(DIR *dir)
+{
+	NEXT(struct dirent64 *, readdir64, (DIR *));
+	COUNT(SC_READDIR);
+	return(next_readdir64(dir));
+}
+
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+	NEXT(void *, mmap, (void *, size_t, int, int, int, off_t));
+	COUNT(SC_MMAP);
+	return(next_mmap(addr, len, prot, flags, fd, off));
+}
+
+int access(const char *path, int mode)
+{
+	NEXT(int, access, (const char *, int));
+	COUNT(SC_ACCESS);
+	return(next_access(path, mode));
+}
+
+int unlink(const char *path)
+{
+	NEXT(int, unlink, (const char *));
+	COUNT(SC_UNLINK);
+	return(next_unlink(path));
+}
+
+int rename(const char *from, const char *to)
+{
+	NEXT(int, rename, (const char *, const char *));
+	COUNT(SC_RENAME);
+	return(next_rename(from, to));
+}
+
+int mkdir(const char *path, mode_t mode)
+{
+	NEXT(int, mkdir, (const char *, mode_t));
+	COUNT(SC_MKDIR);
+	return(next_mkdir(path, mode));
+}
+
+int fsync(int fd)
+{
+	NEXT(int, fsync, (int));
+	COUNT(SC_FSYNC);
+	return(next_fsync(fd));
+}
+
+/* vim: set ts=2 sw=2 noet: */
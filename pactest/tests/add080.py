@@ -0,0 +1,16 @@
+self.description = "Install a package, decompressed by a read-ahead thread"
+
+p = pmpkg("dummy")
+p.files = ["bin/dummy",
+           "usr/man/man1/dummy.1",
+           "usr/share/dummy/data"]
+self.addpkg(p)
+
+self.option["threads"] = ["2"]
+
+self.args = "-A %s" % p.filename()
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_EXIST=dummy")
+for f in p.files:
+	self.addrule("FILE_EXIST=%s" % f)
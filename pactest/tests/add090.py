@@ -0,0 +1,19 @@
+self.description = "Install a package with a packed local database"
+
+lp = pmpkg("dummy")
+lp.files = ["bin/dummy"]
+self.addpkg2db("local", lp)
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg(p)
+
+self.option["PackedDB"] = None
+
+self.args = "-A %s" % p.filename()
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_EXIST=foobar")
+self.addrule("PACK_EXIST=foobar")
+self.addrule("PACK_VERSION=foobar|%s" % p.version)
+self.addrule("PACK_EXIST=dummy")
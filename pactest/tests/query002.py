@@ -0,0 +1,45 @@
+self.description = "Test a local db with inconsistent dependency information"
+
+lp1 = pmpkg("pkg1")
+lp1.depends = ["pkg2"]
+self.addpkg2db("local", lp1)
+
+lp2 = pmpkg("pkg2")
+self.addpkg2db("local", lp2)
+
+lp3 = pmpkg("pkg3")
+lp3.requiredby = ["pkg4"]
+self.addpkg2db("local", lp3)
+
+lp5 = pmpkg("pkg5")
+lp5.depends = ["virtual"]
+self.addpkg2db("local", lp5)
+
+lp6 = pmpkg("pkg6")
+lp6.provides = ["virtual"]
+lp6.requiredby = ["pkg5"]
+lp6.files = ["bin/pkg6"]
+self.addpkg2db("local", lp6)
+
+lp7 = pmpkg("pkg7")
+lp7.depends = ["pkg8", "pkg9"]
+lp7.provides = ["virtual7", "other7"]
+lp7.groups = ["base", "devel"]
+self.addpkg2db("local", lp7)
+
+for name in "pkg8", "pkg9":
+	lp = pmpkg(name)
+	lp.requiredby = ["pkg7"]
+	self.addpkg2db("local", lp)
+
+self.option["threads"] = ["4"]
+
+self.args = "-Qt"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=pkg1-1.0-1: depends on pkg2, which does not have it in its REQUIREDBY")
+self.addrule("PACMAN_OUTPUT=pkg3-1.0-1: required by pkg4, which is not installed")
+self.addrule("!PACMAN_OUTPUT=pkg5")
+self.addrule("!PACMAN_OUTPUT=pkg6")
+self.addrule("!PACMAN_OUTPUT=pkg7")
+self.addrule("!PACMAN_OUTPUT=unexpected line")
@@ -0,0 +1,23 @@
+self.description = "Query a package with a corrupt packed local database"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+def corrupt_pack(root):
+	import struct
+	# stamped like the directory layout, so that it gets used
+	os.utime(os.path.join(root, PM_DBPATH, "local"), (1000000000, 1000000000))
+	hdr = struct.pack("=8sIIqq", "PMPACK02", 1, 0, 1000000000, 0)
+	# name, version, present, off[4], len[4]: all past the end of the file
+	entry = struct.pack("=11I", 0x7fffffff, 0x7fffffff, 1, 0x7fffffff, 0, 0, 0, 64, 0, 0, 0)
+	return hdr + entry + "\0"
+
+self.rawfiles["var/lib/pacman-g2/local.pack"] = corrupt_pack
+
+self.option["PackedDB"] = None
+
+self.args = "-Q foobar"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=foobar")
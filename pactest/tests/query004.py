@@ -0,0 +1,27 @@
+self.description = "Query a package after a crash, with a committed journal"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+def journal_record(op, path, data):
+	# FNV-1a of the path and the data
+	h = 2166136261
+	for c in path + data:
+		h = ((h ^ ord(c)) * 16777619) & 0xffffffff
+	return "%c %d %08x %s\n%s" % (op, len(data), h, path, data)
+
+# the upgrade to foobar-2.0-1 was committed, but not applied in place
+journal = journal_record("R", "foobar-1.0-1", "")
+journal += journal_record("W", "foobar-2.0-1/desc", "%NAME%\nfoobar\n\n%VERSION%\n2.0-1\n\n")
+journal += journal_record("W", "foobar-2.0-1/files", "%FILES%\nbin/foobar\n\n")
+journal += journal_record("W", "foobar-2.0-1/depends", "")
+journal += journal_record("C", ".", "")
+self.rawfiles["var/lib/pacman-g2/local.journal"] = journal
+
+self.args = "-Q foobar"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=2.0-1")
+self.addrule("PKG_VERSION=foobar|2.0-1")
+self.addrule("!FILE_EXIST=var/lib/pacman-g2/local.journal")
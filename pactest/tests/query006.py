@@ -0,0 +1,28 @@
+self.description = "Query a package after a crash, with a committed journal reinstalling it"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+def journal_record(op, path, data):
+	# FNV-1a of the path and the data
+	h = 2166136261
+	for c in path + data:
+		h = ((h ^ ord(c)) * 16777619) & 0xffffffff
+	return "%c %d %08x %s\n%s" % (op, len(data), h, path, data)
+
+# the entry is removed first, then written again: the order is kept
+journal = journal_record("R", "foobar-1.0-1", "")
+journal += journal_record("W", "foobar-1.0-1/desc", "%NAME%\nfoobar\n\n%VERSION%\n1.0-1\n\n")
+journal += journal_record("W", "foobar-1.0-1/files", "%FILES%\nbin/foobar2\n\n")
+journal += journal_record("W", "foobar-1.0-1/depends", "")
+journal += journal_record("C", ".", "")
+self.rawfiles["var/lib/pacman-g2/local.journal"] = journal
+
+self.args = "-Q foobar"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_VERSION=foobar|1.0-1")
+self.addrule("PKG_FILES=foobar|bin/foobar2")
+self.addrule("!PKG_FILES=foobar|bin/foobar")
+self.addrule("!FILE_EXIST=var/lib/pacman-g2/local.journal")
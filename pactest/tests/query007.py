@@ -0,0 +1,22 @@
+self.description = "Query a package with an out of date packed local database"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+def stale_pack(root):
+	# an entry removed since, stamped with an older state of the directory
+	ghost = ("ghost", "1.0-1", {"desc": "%NAME%\nghost\n\n%VERSION%\n1.0-1\n\n"})
+	return mkpack([ghost], 1000000000)
+
+self.rawfiles["var/lib/pacman-g2/local.pack"] = stale_pack
+
+self.option["PackedDB"] = None
+
+self.args = "-Q"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=foobar")
+self.addrule("!PACMAN_OUTPUT=ghost")
+self.addrule("PACK_EXIST=foobar")
+self.addrule("!PACK_EXIST=ghost")
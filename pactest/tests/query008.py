@@ -0,0 +1,24 @@
+self.description = "Query a package with a packed local database, its directory layout lost"
+
+p = pmpkg("foobar")
+p.files = ["bin/foobar"]
+self.addpkg2db("local", p)
+
+def lost_layout(root):
+	dbdir = os.path.join(root, PM_DBPATH, "local")
+	entries = readdbentries(dbdir)
+	for entry in os.listdir(dbdir):
+		shutil.rmtree(os.path.join(dbdir, entry))
+	return mkpack(entries, 1000000000)
+
+self.rawfiles["var/lib/pacman-g2/local.pack"] = lost_layout
+
+self.option["PackedDB"] = None
+
+self.args = "-Q foobar"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=foobar")
+self.addrule("PKG_EXIST=foobar")
+self.addrule("PKG_FILES=foobar|bin/foobar")
+self.addrule("PACK_EXIST=foobar")
@@ -0,0 +1,18 @@
+self.description = "Remove a package with a packed local database"
+
+p1 = pmpkg("dummy")
+p1.files = ["bin/dummy"]
+p2 = pmpkg("foobar")
+p2.files = ["bin/foobar"]
+for p in p1, p2:
+	self.addpkg2db("local", p)
+
+self.option["PackedDB"] = None
+
+self.args = "-R dummy"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("!PKG_EXIST=dummy")
+self.addrule("!FILE_EXIST=bin/dummy")
+self.addrule("PACK_EXIST=foobar")
+self.addrule("!PACK_EXIST=dummy")
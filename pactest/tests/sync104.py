@@ -0,0 +1,24 @@
+self.description = "Sysupgrade loading the local db on several threads"
+
+sp1 = pmpkg("pkg1", "1.0-2")
+sp1.depends = ["pkg2"]
+self.addpkg2db("sync", sp1)
+
+lp1 = pmpkg("pkg1")
+lp1.depends = ["pkg2"]
+self.addpkg2db("local", lp1)
+
+for i in range(2, 10):
+	lp = pmpkg("pkg%d" % i)
+	if i < 9:
+		lp.depends = ["pkg%d" % (i + 1)]
+	self.addpkg2db("local", lp)
+
+self.option["threads"] = ["4"]
+
+self.args = "-Su"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_VERSION=pkg1|1.0-2")
+self.addrule("PKG_REQUIREDBY=pkg2|pkg1")
+self.addrule("!PKG_MODIFIED=pkg9")
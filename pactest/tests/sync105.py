@@ -0,0 +1,24 @@
+self.description = "Sysupgrade loading several sync dbs on several threads"
+
+for i in range(1, 4):
+	sp = pmpkg("pkg%d" % i, "1.0-2")
+	if i == 1:
+		sp.depends = ["dep3"]
+	self.addpkg2db("sync%d" % i, sp)
+	lp = pmpkg("pkg%d" % i)
+	self.addpkg2db("local", lp)
+
+sp = pmpkg("dep3")
+sp.files = ["bin/dep3"]
+self.addpkg2db("sync3", sp)
+
+self.option["threads"] = ["4"]
+
+self.args = "-Su"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_VERSION=pkg1|1.0-2")
+self.addrule("PKG_VERSION=pkg2|1.0-2")
+self.addrule("PKG_VERSION=pkg3|1.0-2")
+self.addrule("PKG_EXIST=dep3")
+self.addrule("FILE_EXIST=bin/dep3")
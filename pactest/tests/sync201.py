@@ -0,0 +1,20 @@
+self.description = "Synchronize database, then install from its packed copy"
+
+sp1 = pmpkg("spkg1", "1.0-1")
+sp1.depends = ["spkg2"]
+sp1.files = ["bin/spkg1"]
+sp2 = pmpkg("spkg2", "2.0-1")
+sp2.files = ["bin/spkg2"]
+sp3 = pmpkg("spkg3", "3.0-1")
+
+for sp in sp1, sp2, sp3:
+	self.addpkg2db("sync", sp)
+
+self.args = "-Sy spkg1"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/sync.pack")
+self.addrule("PKG_EXIST=spkg1")
+self.addrule("PKG_EXIST=spkg2")
+self.addrule("!PKG_EXIST=spkg3")
+self.addrule("FILE_EXIST=bin/spkg2")
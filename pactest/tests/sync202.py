@@ -0,0 +1,27 @@
+self.description = "Synchronize database using a delta"
+
+sp1 = pmpkg("spkg1", "1.0-1")
+sp2 = pmpkg("spkg2", "1.0-1")
+for sp in sp1, sp2:
+	self.addpkg2db("sync", sp)
+
+lp1 = pmpkg("spkg1", "1.0-1")
+self.addpkg2db("local", lp1)
+
+np1 = pmpkg("spkg1", "1.0-2")
+np3 = pmpkg("spkg3", "1.0-1")
+np3.files = ["bin/spkg3"]
+for sp in np1, np3:
+	self.addpkg2serverdb("sync", sp)
+
+self.option["DeltaDB"] = None
+
+self.args = "--debug=8 -Sy spkg1 spkg3"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=applied delta")
+self.addrule("PKG_VERSION=spkg1|1.0-2")
+self.addrule("PKG_EXIST=spkg3")
+self.addrule("FILE_EXIST=bin/spkg3")
+self.addrule("!FILE_EXIST=var/lib/pacman-g2/sync.fdb")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/sync.pack")
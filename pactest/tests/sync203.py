@@ -0,0 +1,22 @@
+self.description = "Synchronize several databases concurrently"
+
+for i in range(1, 4):
+	sp = pmpkg("pkg%d" % i)
+	sp.files = ["bin/pkg%d" % i]
+	self.addpkg2db("sync%d" % i, sp)
+
+self.option["threads"] = ["4"]
+# their files databases get rebuilt one at a time
+self.option["FilesDB"] = None
+
+self.args = "-Sy pkg1 pkg3"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=sync1 has been updated")
+self.addrule("PACMAN_OUTPUT=sync2 has been updated")
+self.addrule("PACMAN_OUTPUT=sync3 has been updated")
+self.addrule("PKG_EXIST=pkg1")
+self.addrule("PKG_EXIST=pkg3")
+self.addrule("FILE_EXIST=bin/pkg3")
+for i in range(1, 4):
+	self.addrule("FILE_EXIST=var/lib/pacman-g2/sync%d.files" % i)
@@ -0,0 +1,23 @@
+self.description = "Search the owner of a file in the files databases"
+
+sp1 = pmpkg("spkg1")
+sp1.files = ["bin/foo", "usr/lib/libfoo.so"]
+sp2 = pmpkg("spkg2", "2.0-1")
+sp2.files = ["bin/bar", "usr/lib/libbar.so"]
+for sp in sp1, sp2:
+	self.addpkg2db("sync", sp)
+
+sp3 = pmpkg("spkg3")
+sp3.files = ["bin/bar"]
+self.addpkg2db("extra", sp3)
+
+self.option["FilesDB"] = None
+
+self.args = "-Syo /bin/bar usr/lib/libfoo.so"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PACMAN_OUTPUT=sync/spkg2 2.0-1 is an owner of /bin/bar")
+self.addrule("PACMAN_OUTPUT=extra/spkg3 1.0-1 is an owner of /bin/bar")
+self.addrule("PACMAN_OUTPUT=sync/spkg1 1.0-1 is an owner of usr/lib/libfoo.so")
+self.addrule("!PKG_EXIST=spkg1")
+self.addrule("!PKG_EXIST=spkg2")
@@ -0,0 +1,26 @@
+self.description = "Synchronize database, then resolve provides and groups from its pack"
+
+sp1 = pmpkg("spkg1", "1.0-1")
+sp1.depends = ["virtual"]
+sp1.files = ["bin/spkg1"]
+sp2 = pmpkg("spkg2", "2.0-1")
+sp2.provides = ["virtual"]
+sp2.files = ["bin/spkg2"]
+sp3 = pmpkg("spkg3", "3.0-1")
+sp3.groups = ["grp"]
+sp3.files = ["bin/spkg3"]
+sp4 = pmpkg("spkg4", "4.0-1")
+
+for sp in sp1, sp2, sp3, sp4:
+	self.addpkg2db("sync", sp)
+
+self.args = "-Sy spkg1 grp"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/sync.pack")
+self.addrule("PKG_EXIST=spkg1")
+self.addrule("PKG_EXIST=spkg2")
+self.addrule("PKG_EXIST=spkg3")
+self.addrule("!PKG_EXIST=spkg4")
+self.addrule("PKG_DEPENDS=spkg1|virtual")
+self.addrule("FILE_EXIST=bin/spkg3")
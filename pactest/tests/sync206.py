@@ -0,0 +1,20 @@
+self.description = "Install a dependency provided by two sync packages"
+
+sp1 = pmpkg("pkg1")
+sp1.depends = ["virtual"]
+
+sp2 = pmpkg("pkgb")
+sp2.provides = ["virtual"]
+
+sp3 = pmpkg("pkga")
+sp3.provides = ["virtual"]
+
+for p in sp1, sp2, sp3:
+	self.addpkg2db("sync", p)
+
+self.args = "-S pkg1"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_EXIST=pkg1")
+self.addrule("PKG_EXIST=pkga")
+self.addrule("!PKG_EXIST=pkgb")
@@ -0,0 +1,17 @@
+self.description = "Synchronize database using a delta which removes a package"
+
+sp1 = pmpkg("spkg1", "1.0-1")
+sp2 = pmpkg("spkg2", "1.0-1")
+for sp in sp1, sp2:
+	self.addpkg2db("sync", sp)
+
+np1 = pmpkg("spkg1", "1.0-2")
+self.addpkg2serverdb("sync", np1)
+
+self.option["DeltaDB"] = None
+
+self.args = "--debug=8 -Sy spkg2"
+
+self.addrule("PACMAN_RETCODE=1")
+self.addrule("PACMAN_OUTPUT=applied delta")
+self.addrule("!PKG_EXIST=spkg2")
@@ -0,0 +1,10 @@
+self.description = "Synchronize a local repository without DeltaDB"
+
+sp1 = pmpkg("spkg1")
+self.addpkg2db("sync", sp1)
+
+self.args = "-Sy spkg1"
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_EXIST=spkg1")
+self.addrule("!FILE_EXIST=var/lib/pacman-g2/sync.lastupdate")
@@ -0,0 +1,21 @@
+self.description = "Search the owner of a file with a corrupt files database"
+
+sp1 = pmpkg("spkg1")
+sp1.files = ["bin/foo"]
+self.addpkg2db("sync", sp1)
+
+def corrupt_files(root):
+	import struct
+	hdr = struct.pack("=8sII16s", "PMFILE01", 1, 1, "")
+	# dir, base, pkg: past the end of the file
+	entry = struct.pack("=3I", 0x7fffffff, 0x7fffffff, 0)
+	pkg = struct.pack("=2I", 0x7fffffff, 0x7fffffff)
+	return hdr + entry + pkg + "\0"
+
+self.rawfiles["var/lib/pacman-g2/sync.files"] = corrupt_files
+
+self.option["FilesDB"] = None
+
+self.args = "-So /bin/foo"
+
+self.addrule("PACMAN_OUTPUT=not a valid files database")
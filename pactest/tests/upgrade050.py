@@ -0,0 +1,38 @@
+self.description = "Upgrade packages with front-coded file lists"
+
+lp1 = pmpkg("dummy")
+lp1.files = ["bin/dummy",
+             "usr/share/dummy/old",
+             "usr/share/file"]
+
+lp2 = pmpkg("foobar")
+lp2.files = ["bin/foobar"]
+
+for p in lp1, lp2:
+	self.addpkg2db("local", p)
+
+p1 = pmpkg("dummy", "1.0-2")
+p1.files = ["bin/dummy",
+            "usr/share/dummy/new",
+            "usr/share/dummy/data/a",
+            "usr/share/dummy/data/b"]
+
+p2 = pmpkg("foobar", "1.0-2")
+p2.files = ["bin/foobar",
+            "usr/share/file"]
+
+for p in p1, p2:
+	self.addpkg(p)
+
+self.option["CompactFiles"] = None
+
+self.args = "-U %s" % " ".join([p.filename() for p in p1, p2])
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_VERSION=dummy|1.0-2")
+self.addrule("PKG_FILES=dummy|usr/share/dummy/new")
+self.addrule("PKG_FILES=dummy|usr/share/dummy/data/b")
+self.addrule("PKG_FILES=foobar|usr/share/file")
+self.addrule("FILE_EXIST=usr/share/file")
+self.addrule("FILE_EXIST=usr/share/dummy/data/a")
+self.addrule("!FILE_EXIST=usr/share/dummy/old")
@@ -0,0 +1,27 @@
+self.description = "Upgrade a package with combined database records"
+
+lp1 = pmpkg("dummy")
+lp1.files = ["bin/dummy"]
+lp1.requiredby = ["foobar"]
+
+lp2 = pmpkg("foobar")
+lp2.files = ["bin/foobar"]
+lp2.depends = ["dummy"]
+
+for p in lp1, lp2:
+	self.addpkg2db("local", p)
+
+p = pmpkg("dummy", "1.0-2")
+p.files = ["bin/dummy"]
+self.addpkg(p)
+
+self.option["CombinedDB"] = None
+
+self.args = "-U %s" % p.filename()
+
+self.addrule("PACMAN_RETCODE=0")
+self.addrule("PKG_VERSION=dummy|1.0-2")
+self.addrule("PKG_REQUIREDBY=dummy|foobar")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/local/dummy-1.0-2/meta")
+self.addrule("!FILE_EXIST=var/lib/pacman-g2/local/dummy-1.0-2/desc")
+self.addrule("FILE_EXIST=var/lib/pacman-g2/local.meta")
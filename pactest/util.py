@@ -23,6 +23,7 @@ import sys
 import os
 import hashlib
 import stat
+import struct
 
 
 # libpacman
@@ -187,6 +188,10 @@ def mkcfgfile(filename, root, option, db):
 	# Options
 	data = ["[options]"]
 	for key, value in option.iteritems():
+		if value is None:
+			# a directive without value
+			data.append(key)
+			continue
 		data.extend(["%s = %s" % (key, j) for j in value])
 
 	# Repositories
@@ -269,6 +274,78 @@ def getmtime(filename):
 	return st[stat.ST_ATIME], st[stat.ST_MTIME], st[stat.ST_CTIME]
 
 
+#
+# Packed database helpers (PackedDB)
+#
+
+PM_PACKDB_MAGIC = "PMPACK02"
+PM_PACKDB_SECTIONS = ["desc", "depends", "files", "install"]
+
+def readdbentries(dbdir):
+	"""Returns the entries of a database directory, as mkpack() takes them.
+	"""
+	entries = []
+	for entry in sorted(os.listdir(dbdir)):
+		path = os.path.join(dbdir, entry)
+		if not os.path.isdir(path):
+			continue
+		[name, ver, rel] = entry.rsplit("-", 2)
+		sections = {}
+		for s in PM_PACKDB_SECTIONS:
+			if os.path.isfile(os.path.join(path, s)):
+				fd = file(os.path.join(path, s), "r")
+				sections[s] = fd.read()
+				fd.close()
+		entries.append((name, ver + "-" + rel, sections))
+	return entries
+
+def mkpack(entries, mtime, mtimensec = 0):
+	"""Returns a pack of the (name, version, sections) entries, stamped with
+	mtime, laid out like lib/libpacman/be_packed.h says.
+	"""
+	entries = sorted(entries)
+	base = struct.calcsize("=8sIIqq") + len(entries) * struct.calcsize("=11I")
+	table = ""
+	blobs = ""
+	for name, version, sections in entries:
+		offs = [base + len(blobs), base + len(blobs) + len(name) + 1]
+		blobs += name + "\0" + version + "\0"
+		present = 0
+		off = [0] * 4
+		length = [0] * 4
+		for i, s in enumerate(PM_PACKDB_SECTIONS):
+			if s in sections:
+				present |= 1 << i
+				off[i] = base + len(blobs)
+				length[i] = len(sections[s])
+				blobs += sections[s]
+		table += struct.pack("=11I", *(offs + [present] + off + length))
+	hdr = struct.pack("=8sIIqq", PM_PACKDB_MAGIC, len(entries), 0, mtime, mtimensec)
+	return hdr + table + blobs + "\0"
+
+def readpack(filename):
+	"""Returns the stamp and the entries (name -> version) of a pack, None if
+	there is none.
+	"""
+	if not os.path.isfile(filename):
+		return None
+	fd = file(filename, "rb")
+	data = fd.read()
+	fd.close()
+	hdrlen = struct.calcsize("=8sIIqq")
+	entlen = struct.calcsize("=11I")
+	[magic, count, reserved, mtime, mtimensec] = struct.unpack("=8sIIqq", data[:hdrlen])
+	if magic != PM_PACKDB_MAGIC:
+		return None
+	entries = {}
+	for n in range(count):
+		fields = struct.unpack("=11I", data[hdrlen + n*entlen:hdrlen + (n+1)*entlen])
+		name = data[fields[0]:data.index("\0", fields[0])]
+		version = data[fields[1]:data.index("\0", fields[1])]
+		entries[name] = version
+	return mtime, mtimensec, entries
+
+
 #
 # Miscellaneous
 #
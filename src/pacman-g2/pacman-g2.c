@@ -156,6 +156,7 @@ static void usage(int op, char *myname)
 			printf(_("  -e, --dependsonly   install dependencies only\n"));
 			printf(_("  -f, --force         force install, overwrite conflicting files\n"));
 			printf(_("  -g, --groups        view all members of a package group\n"));
+			printf(_("  -o, --owns <file>   query the repository packages that own <file> (see FilesDB)\n"));
 			printf(_("  -p, --print-uris    print out URIs for given packages and their dependencies\n"));
 			printf(_("  -s, --search        search remote repositories for matching strings\n"));
 			printf(_("  -u, --sysupgrade    upgrade all packages that are out of date\n"));
@@ -508,7 +509,7 @@ int main(int argc, char *argv[])
 	if(myuid > 0) {
 		if(config->op != PM_OP_MAIN && config->op != PM_OP_QUERY && config->op != PM_OP_DEPTEST && config->op != PM_OP_PS) {
 			if((config->op == PM_OP_SYNC && !config->op_s_sync && (config->op_s_search
-				 || config->group || config->op_q_list || config->op_q_info
+				 || config->group || config->op_q_list || config->op_q_info || config->op_q_owns
 				 || (config->flags & PM_TRANS_FLAG_PRINTURIS)))
 				 || (config->op == PM_OP_DEPTEST && !config->op_d_resolve)
 				 || (config->root != NULL)) {
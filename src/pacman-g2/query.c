@@ -40,6 +40,29 @@
 extern config_t *config;
 extern PM_DB *db_local;
 extern list_t *pmc_syncs;
+extern unsigned int maxcols;
+
+/* progress bar of --test */
+static void cb_db_test(const char *entry, int percent, int count, int done)
+{
+	static int prevpercent = -1;
+	unsigned int i, hash, progresslen = maxcols - 57;
+
+	if(percent == prevpercent) {
+		return;
+	}
+	prevpercent = percent;
+	hash = percent*progresslen/100;
+	printf("%s (%d/%d) [", _("checking database"), done, count);
+	for(i = 0; i < progresslen; i++) {
+		putchar(i < hash ? '#' : ' ');
+	}
+	printf("] %3d%%\r", percent);
+	if(done == count) {
+		putchar('\n');
+	}
+	fflush(stdout);
+}
 
 int querypkg(list_t *targets)
 {
@@ -71,7 +94,14 @@ int querypkg(list_t *targets)
 	}
 
 	if(config->op_q_test) {
+		if(!config->noprogressbar) {
+			pacman_set_option(PM_OPT_DBTESTCB, (long)cb_db_test);
+		}
 		ret = pacman_db_test(db_local);
+		if(ret == NULL && pm_errno) {
+			ERR(NL, _("failed to check the database (%s)\n"), pacman_strerror(pm_errno));
+			return(1);
+		}
 		if(ret == NULL) {
 			printf(_(":: the database seems to be consistent\n"));
 			return(0);
@@ -55,29 +55,41 @@ extern config_t *config;
 
 extern list_t *pmc_syncs;
 
-static int sync_synctree(int level, list_t *syncs)
-{
-	list_t *i;
-	int success = 0, ret;
+/* the repositories updating concurrently don't get a progress bar */
+static list_t *noprogress;
 
-	for(i = syncs; i; i = i->next) {
-		PM_DB *db = i->data;
+static void cb_db_update(PM_DB *db, unsigned char event, int ret)
+{
+	char *treename = (char *)pacman_db_getinfo(db, PM_DB_TREENAME);
 
-		ret = pacman_db_update((level < 2 ? 0 : 1), db);
-		if(ret == -1) {
-			if(pm_errno == PM_ERR_DB_SYNC) {
-				ERR(NL, _("failed to synchronize %s\n"), (char*)pacman_db_getinfo(db, PM_DB_TREENAME));
-			} else {
-				ERR(NL, _("failed to update %s (%s)\n"), (char*)pacman_db_getinfo(db,
-							PM_DB_TREENAME), pacman_strerror(pm_errno));
+	switch(event) {
+		case PM_DB_UPDATE_START:
+			if(!ret) {
+				noprogress = list_add(noprogress, strdup(treename));
 			}
-			success--;
-		} else if(ret == 1) {
-			MSG(NL, _(" %s is up to date\n"), (char *)pacman_db_getinfo(db, PM_DB_TREENAME));
-		}
+		break;
+		case PM_DB_UPDATE_DONE:
+			if(ret == -1) {
+				ERR(NL, _("failed to synchronize %s (%s)\n"), treename, pacman_strerror(pm_errno));
+			} else if(ret == 1) {
+				MSG(NL, _(" %s is up to date\n"), treename);
+			} else if(list_is_strin(treename, noprogress)) {
+				MSG(NL, _(" %s has been updated\n"), treename);
+			}
+		break;
 	}
+}
 
-	return(success);
+static int sync_synctree(int level)
+{
+	int ret;
+
+	ret = pacman_db_update_all((level < 2 ? 0 : 1), cb_db_update);
+	FREELIST(noprogress);
+	if(ret == -1) {
+		ERR(NL, _("failed to update the databases (%s)\n"), pacman_strerror(pm_errno));
+	}
+	return(ret);
 }
 
 static int sync_search(list_t *syncs, list_t *targets)
@@ -204,6 +216,41 @@ static int sync_info(list_t *syncs, list_t *targets)
 	return(0);
 }
 
+static int sync_owns(list_t *syncs, list_t *targets)
+{
+	list_t *i, *j;
+	int ret = 0;
+
+	for(i = targets; i; i = i->next) {
+		int found = 0;
+
+		for(j = syncs; j; j = j->next) {
+			PM_DB *db = j->data;
+			char *treename = (char *)pacman_db_getinfo(db, PM_DB_TREENAME);
+			PM_LIST *data, *lp;
+
+			if((data = pacman_db_getowners(db, i->data)) == NULL) {
+				if(pm_errno != PM_ERR_NO_OWNER && i == targets) {
+					WARN(NL, _("%s has no files database, run -Sy with FilesDB set\n"), treename);
+				}
+				continue;
+			}
+			for(lp = pacman_list_first(data); lp; lp = pacman_list_next(lp)) {
+				printf(_("%s/%s is an owner of %s\n"), treename,
+						(char *)pacman_list_getdata(lp), (char *)i->data);
+			}
+			pacman_list_free(data);
+			found = 1;
+		}
+		if(!found) {
+			ERR(NL, _("No package owns %s\n"), (char *)i->data);
+			ret = 1;
+		}
+	}
+
+	return(ret);
+}
+
 static int sync_list(list_t *syncs, list_t *targets)
 {
 	list_t *i;
@@ -292,11 +339,16 @@ int syncpkg(list_t *targets)
 		/* grab a fresh package list */
 		MSG(NL, _(":: Synchronizing package databases...\n"));
 		pacman_logaction(_("synchronizing package lists"));
-		if(sync_synctree(config->op_s_sync, pmc_syncs)) {
+		if(sync_synctree(config->op_s_sync)) {
 			return(1);
 		}
 	}
 
+	if(config->op_s_search || config->group || config->op_s_info) {
+		/* these go through every repository */
+		pacman_db_preload();
+	}
+
 	if(config->op_s_search) {
 		return(sync_search(pmc_syncs, targets));
 	}
@@ -313,6 +365,10 @@ int syncpkg(list_t *targets)
 		return(sync_list(pmc_syncs, targets));
 	}
 
+	if(config->op_q_owns) {
+		return(sync_owns(pmc_syncs, targets));
+	}
+
 	/* Step 1: create a new transaction...
 	 */
 	if(pacman_trans_init(PM_TRANS_TYPE_SYNC, config->flags, cb_trans_evt, cb_trans_conv, cb_trans_progress) == -1) {